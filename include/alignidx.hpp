@@ -0,0 +1,86 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/**
+ * FILE: alignidx.hpp
+ * Created: Oct 16, 2026 Fri
+ */
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <filesystem>
+
+class Read;
+
+/*
+ * Index of the reads aligned to each reference part. Written during the alignment into the
+ * KVDB directory as 'alnidx_<index>_<part>.dat' - a sorted array of the read keys.
+ *
+ * The blast and SAM reports print the alignments on the reference part loaded for the pass.
+ * Using the index the passes skip the DB lookups of the reads with no alignments on the part.
+ * A read is keyed by the reads file and the read number same as the read ID (see 'Read::generate_id').
+ *
+ * The index may have extra reads: a read is kept in the index of a part even if its alignments
+ * on that part were later replaced by better alignments on other parts. The reports check
+ * the part of each alignment anyway.
+ */
+class Alignidx {
+public:
+	Alignidx(const std::filesystem::path& dir, unsigned num_threads = 0);
+
+	/* record the read aligned to the part. Called by the processor thread 'id' */
+	void add(unsigned id, const Read& read, uint16_t idx_num, uint16_t part);
+	/* record the read under all the parts it has alignments on */
+	void add(unsigned id, const Read& read);
+	/* merge the reads recorded by all the threads for the part, and write the part's index file */
+	void write(uint16_t idx_num, uint16_t part);
+	/* load the part's index. False if there is no index file i.e. all the reads have to be checked */
+	bool load(uint16_t idx_num, uint16_t part);
+	/* remove the reads not aligned to the loaded part from the block. The reads of a pair are kept together */
+	void filter(std::vector<Read>& reads, bool is_paired) const;
+	/*
+	 * sorted numbers of the reads of the files [readfile_idx, readfile_idx + num_files) in the loaded part's index.
+	 * A pair is listed once if either of its reads is aligned. Used to fetch the reads from the read store
+	 */
+	std::vector<uint64_t> get_reads(std::size_t readfile_idx, unsigned num_files) const;
+
+	static uint64_t key(const Read& read);
+
+private:
+	std::filesystem::path get_path(uint16_t idx_num, uint16_t part);
+
+private:
+	std::filesystem::path dir;
+	std::vector<std::map<uint32_t, std::vector<uint64_t>>> vkeys; // per thread: [index << 16 | part] -> read keys
+	std::vector<uint64_t> keys; // sorted read keys of the loaded part
+};
@@ -37,6 +37,8 @@
 
 #include <map>
 #include <queue>
+#include <string>
+#include <vector>
 #include <algorithm>
 
 #include "traverse_bursttrie.hpp"
@@ -69,6 +71,123 @@ using namespace std;
 typedef pair<uint32_t,uint32_t> uint32pair;
 
 
+/*
+ * counts the k-mer hits on the candidate references of a read using a flat hash table
+ * (open addressing, linear probing). The table is kept between the reads (one counter per thread)
+ * and only its used slots are reset, so that no memory is allocated per read.
+ */
+struct RefHitCounter
+{
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+
+	vector<uint32_t> keys; // reference numbers. EMPTY if the slot is not used
+	vector<uint32_t> hits; // number of k-mer hits on the reference in the same slot
+	vector<uint32_t> slots; // used slots
+	vector<uint32pair> counts; // [reference number : number of k-mer hits on the reference]
+	uint32_t bits = 0; // log2 of the table size
+
+	RefHitCounter() { resize(10); }
+	void clear();
+	void add(uint32_t ref)
+	{
+		if (slots.size() * 2 >= keys.size()) resize(bits + 1);
+		uint32_t mask = (uint32_t)keys.size() - 1;
+		uint32_t i = (ref * 2654435761u) >> (32 - bits);
+		for (; keys[i] != ref; i = (i + 1) & mask)
+		{
+			if (keys[i] == EMPTY)
+			{
+				keys[i] = ref;
+				slots.push_back(i);
+				break;
+			}
+		}
+		++hits[i];
+	}
+	/*
+	 * count the hits per reference. Keeps the references with at least 'min_hits' hits ordered
+	 * by the number of hits descending, and by the reference number ascending for equal number of hits
+	 */
+	void count(uint32_t min_hits);
+
+private:
+	void resize(uint32_t new_bits);
+};
+
+/*
+ * SSW query profiles of the read slices aligned so far. The same slice of a read is usually aligned
+ * on many candidate references and in every search pass, so its profile is built only once.
+ * The profiles are kept for the current read (one cache per thread) on both strands, and are looked up by
+ * the content of the slice and of the scoring matrix. Both are copied into the cache because the profile
+ * refers to them in 'ssw_align', and the Read can be copied or destroyed while the profile is still cached.
+ */
+struct QueryProfileCache
+{
+	struct entry
+	{
+		vector<int8_t> query; // read slice in 0..4 alphabet
+		vector<int8_t> matrix; // scoring matrix
+		s_profile* profile;
+	};
+
+	string read_id; // read the profiles were built for
+	vector<entry> entries;
+
+	~QueryProfileCache() { clear(); }
+	void clear();
+	/* get the profile of the slice [que_start, que_start + que_len) of the read. The read has to be in 0..4 alphabet */
+	const s_profile* get(const Read& read, size_t que_start, size_t que_len);
+	/* get the profile of the query 'query' of the read 'id', in 0..4 alphabet */
+	const s_profile* get(const string& id, const int8_t* query, size_t que_len, const vector<int8_t>& matrix);
+};
+
+/*
+ * The first alignment on each of the next candidate references of a read, scored at once with
+ * the inter-sequence kernel 'ssw_score_batch' (one candidate per SIMD lane).
+ * The first window of k-mer hits on a candidate does not depend on the alignments done on the previous
+ * candidates, so it can be scored ahead. 'compute_lis_alignment' only runs the full alignment (with traceback)
+ * of the first windows that pass the score threshold, and of all the following windows as before.
+ * The k-mer hits of the batch candidates are collected in a single pass over the read's hits.
+ * Only done when the search is expected to try a full batch of candidates, see 'search_depth' in alignment.cpp.
+ * One batch per thread, the buffers are kept between the reads.
+ */
+struct CandidateBatch
+{
+	/* alignment of the first window of k-mer hits on a candidate, see 'compute_lis_alignment' */
+	struct job
+	{
+		bool is_valid = false; // the window has enough hits and a long enough LIS to be aligned
+		bool is_scored = false; // 'score' was computed with the batch
+		uint16_t score = 0; // SW score of the alignment
+		size_t head = 0;
+		size_t tail = 0;
+		size_t align_ref_start = 0;
+		size_t align_que_start = 0;
+		size_t align_length = 0;
+	};
+
+	uint32_t begin = 0; // first candidate of the batch (index into the candidates of the read)
+	uint32_t end = 0; // candidate after the last one of the batch
+	vector<vector<uint32pair>> hits; // [k - begin] k-mer hits on the candidate <ref pos, read pos> sorted by position
+	vector<job> jobs; // [k - begin]
+
+	void clear() { begin = end = 0; }
+	/*
+	 * build the batch starting from the candidate 'k' of 'candidates' <reference number : number of k-mer hits>
+	 * @param max_num  the candidates the search is expected to try. A single candidate if fewer than a full batch
+	 */
+	void fill(uint32_t k, uint32_t max_num, Read& read, Runopts& opts, Index& index, References& refs, Refstats& refstats,
+		const vector<uint32pair>& candidates, QueryProfileCache& profiles);
+
+private:
+	vector<uint32pair> refs_idx; // <reference number : k - begin> sorted
+	vector<int8_t> query; // the read in 0..4 alphabet
+	vector<const int8_t*> batch_refs;
+	vector<int32_t> batch_lens;
+	vector<uint16_t> batch_scores;
+	vector<uint32_t> batch_jobs;
+};
+
 /*! @fn smallest()
     @brief Determine the smallest integer.
     @details The mypair data structure holds two integers,
@@ -52,7 +52,9 @@ const std::string REV = "REV";
 
 enum class BIO_FORMAT : unsigned { FASTQ = 0, FASTA = 1 };
 enum class ZIP_FORMAT : unsigned { GZIP = 0, ZLIB = 1, FLAT = 2, XPRESS = 3 };
-enum class FEED_TYPE : unsigned { SPLIT_READS = 0, LOCKLESS = 1, MAX = LOCKLESS };
+enum class FEED_TYPE : unsigned { SPLIT_READS = 0, LOCKLESS = 1, READB = 2, MAX = READB };
+enum class KVDB_TYPE : unsigned { ROCKSDB = 0, MMAP = 1, MAX = MMAP };
+enum class SPLIT_ZIP : unsigned { FLAT = 0, GZIP_FAST = 1, GZIP = 2, MAX = GZIP }; // compression of the split reads files
 enum class BlastFormat { TABULAR, REGULAR}; // format of the Blast output
 
 /*! @brief Map nucleotides to integers.
@@ -175,6 +177,38 @@ static inline size_t get_memory() {
 }
 #endif
 
+/*
+ * amount of physical memory available for starting new applications, in bytes.
+ * Linux: cat /proc/meminfo | grep 'MemAvailable:'
+ *   'MemAvailable:   12345678 kB'
+ * Returns 0 if the value cannot be determined.
+ */
+#if defined(_WIN32)
+static inline size_t get_available_memory() {
+    MEMORYSTATUSEX msx;
+    msx.dwLength = sizeof(msx);
+    if (!GlobalMemoryStatusEx(&msx))
+        return 0;
+    return msx.ullAvailPhys;
+}
+#else
+static inline size_t get_available_memory() {
+    std::ifstream ifs("/proc/meminfo", std::ios::binary);
+    size_t mem = 0;
+    if (ifs.is_open()) {
+        for (std::string line; std::getline(ifs, line); ) {
+            if (line.find("MemAvailable:") == 0) {
+                auto pos_start = line.find_first_of("0123456789");
+                if (pos_start != std::string::npos)
+                    mem = std::stoull(line.substr(pos_start)) << 10; // kB -> bytes
+                break;
+            }
+        }
+    }
+    return mem;
+}
+#endif
+
 #define INFO(...) \
 	{\
 		std::stringstream ss; \
@@ -36,12 +36,13 @@
 #pragma once
 
 #include <vector>
+#include <string>
 #include <cstdint>
 
+#include "indexdb.hpp"
+
 // forward
 struct Runopts;
-struct kmer;
-struct kmer_origin;
 class Refstats;
 
 /**
@@ -61,14 +62,35 @@ struct Index {
 	//long _gap_extension = 0; /* Smith-Waterman score for gap extension */
 
 	std::vector<kmer> lookup_tbl; /**< reference to L/2-mer look up table */
-	std::vector<kmer_origin> positions_tbl; /**< reference to (L+1)-mer positions table */
+	kmer_positions positions_tbl; /**< (L+1)-mer positions table. Points into 'image' or into the vectors below */
+
+	char* image; // the memory mapped index part file (.mmap_N.dat). The tries and the positions point into it
+	size_t image_size;
+	std::vector<uint64_t> pos_offset; // positions table storage when loaded from the .pos_N.dat file
+	std::vector<seq_pos> pos_arr;
 
 	/*
 	 * Initilize the index.
 	 * If index files do not exist or are empty - build the index.
 	 */
 	Index(Runopts & opts);
+	/*
+	 * empty Index used for holding a single loaded index part.
+	 * Does not test or build the index files. See 'align' resident mode.
+	 */
+	Index();
 	//~Index() {}
+	/*
+	 * map the index part file into memory. If the file is missing or older than the index
+	 * files (index built by a previous version), it is first generated from those files.
+	 */
 	void load(uint32_t idx_num, uint32_t idx_part, std::vector<std::pair<std::string, std::string>>& indexfiles, Refstats & refstats);
 	void unload();
+
+private:
+	bool map_file(const std::string& mmapfile, uint32_t limit);
+	void unmap_file();
+	// the index files .kmer_N.dat, .bursttrie_N.dat, .pos_N.dat are loaded into heap allocated tries (pointers)
+	void load_legacy(uint32_t idx_num, uint32_t idx_part, std::vector<std::pair<std::string, std::string>>& indexfiles, Refstats& refstats);
+	void unload_legacy();
 }; // ~struct Index
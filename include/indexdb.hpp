@@ -65,10 +65,13 @@ int build_index(Runopts &opts);
 struct NodeElement
 {
 	// a pointer to a bucket or another trie node
+	// Tries built in memory (build_index) use pointers. Tries loaded for alignment (Index::load)
+	// are pointer-free and use the offset (in bytes) of the child trie node or bucket relative to this node element
 	union 
 	{
 	   void* bucket;
 	   NodeElement* trie;
+	   int64_t offset;
 	} nodetype;
 
 	// current size (in bytes) of bucket
@@ -88,10 +91,16 @@ struct seq_pos
 	uint32_t seq; // the sequence number (in the original reference files?)
 };
 
-struct kmer_origin
+// the 19-mer positions table in the compressed sparse row layout: the positions of
+// the 19-mer 'id' are arr[offset[id]] .. arr[offset[id + 1] - 1]
+struct kmer_positions
 {
-	seq_pos* arr; // pointer to seq_pos array
-	uint32_t size; // number of 19-mer occurrences
+	uint64_t* offset; // number of unique 19-mers + 1 offsets into 'arr'
+	seq_pos* arr; // positions of all 19-mers
+
+	seq_pos* begin(uint32_t id) const { return arr + offset[id]; }
+	seq_pos* end(uint32_t id) const { return arr + offset[id + 1]; }
+	uint32_t size(uint32_t id) const { return (uint32_t)(offset[id + 1] - offset[id]); }
 };
 
 struct kmer
@@ -101,6 +110,59 @@ struct kmer
 	uint32_t count; // count of 9-mers
 };
 
+// child trie node of a loaded (pointer-free) trie node element
+inline NodeElement* trie_child(NodeElement* node)
+{
+	return reinterpret_cast<NodeElement*>(reinterpret_cast<char*>(node) + node->nodetype.offset);
+}
+
+// bucket of a loaded (pointer-free) trie node element
+inline unsigned char* trie_bucket(NodeElement* node)
+{
+	return reinterpret_cast<unsigned char*>(node) + node->nodetype.offset;
+}
+
+/*
+ * Header of the memory-mappable index part file <name>.mmap_<part>.dat
+ *
+ * The file contains no pointers and is mapped read-only by Index::load:
+ *
+ *   mmap_index_header
+ *   mmap_index_kmer[limit]              9-mer look-up table (file offsets of the tries, 0 if no trie)
+ *   tries                               NodeElement arrays and buckets with self-relative offsets
+ *   uint64_t pos_offset[number_elements + 1]  positions of each 19-mer id in the seq_pos array
+ *   seq_pos[pos_offset[number_elements]]
+ *
+ * All sections are aligned on 8 bytes.
+ */
+const char MMAP_INDEX_MAGIC[8] = { 'S', 'M', 'R', 'I', 'D', 'X', 'M', 'M' };
+const uint32_t MMAP_INDEX_VERSION = 1;
+
+struct mmap_index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t limit; // number of 9-mers in the look-up table
+	uint32_t number_elements; // number of unique 19-mers in the positions table
+	uint32_t node_size; // sizeof(NodeElement) used when the file was written
+	uint64_t kmer_offset; // file offset of the 9-mer look-up table
+	uint64_t trie_offset; // file offset of the tries
+	uint64_t pos_offset; // file offset of the positions table
+	uint64_t file_size;
+};
+
+struct mmap_index_kmer {
+	uint64_t trie_F; // file offset of the forward mini burst trie
+	uint64_t trie_R; // file offset of the reverse mini burst trie
+	uint32_t count; // count of 9-mers
+	uint32_t pad;
+};
+
+/**
+ * write the index part (9-mer look-up table, mini-burst tries and positions table)
+ * into a single pointer-free file that can be memory mapped by Index::load
+ */
+void write_mmap_index(const std::string& outfile, kmer* lookup_table, uint32_t limit, const kmer_positions& positions_tbl, uint32_t number_elements);
+
 // data structure to store information on index parts
 // i.e. index can be partitioned for large reference files
 struct index_parts_stats {
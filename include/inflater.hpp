@@ -0,0 +1,100 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/**
+ * FILE: inflater.hpp
+ * Created: Oct 16, 2026 Fri
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <memory>
+
+#include "izlib.hpp" // RL_OK, RL_END, RL_ERR
+
+/*
+ * Reads lines from a gzipped file. The file is inflated ahead on a background thread
+ * into a ring of large blocks, and the lines are extracted from the blocks with 'memchr'.
+ *
+ * BGZF files (concatenated gzip members with the member size in the header, see SAM spec)
+ * are inflated member by member on multiple threads. Other files (a single or concatenated members)
+ * are inflated on the background thread only.
+ *
+ * Replaces 'Izlib' for reading. The stream passed to 'getline' is read by the background thread
+ * until the end of file, or until 'init' or 'reset_inflate' is called.
+ */
+class Inflater
+{
+public:
+	static const std::size_t BLOCK_SIZE = 1 << 22; // size of an inflated block 4MB
+	static const unsigned NUM_BLOCKS = 4; // number of blocks in the ring
+
+	Inflater();
+	~Inflater();
+	Inflater(Inflater&&) noexcept;
+	Inflater& operator=(Inflater&&) noexcept;
+
+	/*
+	 * prepare for reading a new stream. Stops inflating the previous stream if any
+	 * @param num_threads  number of threads to inflate BGZF members
+	 */
+	void init(unsigned num_threads = 1);
+	/*
+	 * get a line from the compressed stream. The background inflating starts on the first call
+	 * @return  RL_OK | RL_END (the line holds the last line if not terminated with new line) | RL_ERR
+	 */
+	int getline(std::ifstream& ifs, std::string& line);
+	int reset_inflate(); // stop inflating
+
+private:
+	struct Block {
+		std::vector<char> data;
+		std::size_t size = 0;
+		int status = RL_OK; // RL_END marks the end of the stream, RL_ERR the inflating failed
+	};
+	struct Ring; // blocks shared with the background thread
+
+	// the background thread uses the ring only, as the Inflater may be moved
+	static void run(Ring* ring, std::ifstream* ifs, unsigned num_threads);
+	static void run_serial(Ring& ring, std::ifstream& ifs, std::vector<char>& zbuf, std::size_t zlen);
+	static void run_bgzf(Ring& ring, std::ifstream& ifs, std::vector<char>& zbuf, std::size_t zlen, unsigned num_threads);
+	void stop();
+
+private:
+	unsigned num_threads;
+	std::unique_ptr<Ring> ring;
+	std::unique_ptr<std::thread> reader;
+	Block* block; // the block the lines are extracted from. Null if none
+	std::size_t pos; // position of the next line in the block
+};
@@ -50,9 +50,10 @@ class Izlib
 public:
 	Izlib(bool is_compress=false, bool is_init=true);
 
-	void init(bool is_compress = false);
+	void init(bool is_compress = false, int level = Z_DEFAULT_COMPRESSION); // level: deflate compression level
 	int reset_deflate(); // clean up z_stream
 	int finish_deflate(std::ostream& ofs, const int&& dbg=0);
+	bool is_pending() const; // data was passed for deflating since the last init
 	int reset_inflate();
 	/*
     * get a line from the compressed stream
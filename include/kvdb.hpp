@@ -35,19 +35,70 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "common.hpp"
+#include "resultstore.hpp"
 #include "rocksdb/db.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/options.h"
+#include "rocksdb/write_batch.h"
 
 class KeyValueDatabase {
 public:
-	KeyValueDatabase(std::string const &kvdbPath);
-	~KeyValueDatabase() { delete kvdb; }
+	static constexpr std::size_t WRITE_BATCH_SIZE = 1000; // number of puts in a write batch
+	static constexpr std::size_t MULTI_GET_SIZE = 128; // number of keys looked up at once
+
+	KeyValueDatabase(std::string const &kvdbPath, KVDB_TYPE type = KVDB_TYPE::ROCKSDB);
+	~KeyValueDatabase();
 
 	void put(std::string key, std::string val);
 	std::string get(std::string key);
+	/* write all the puts of the batch at once, and clear the batch. No WAL - the results can be rebuilt */
+	void write(rocksdb::WriteBatch& batch);
+	/* get the values of the keys in a single lookup. The value is empty if the key is not found */
+	void multi_get(const std::vector<std::string>& keys, std::vector<std::string>& vals);
+	/* the memory mapped store takes the puts directly - nothing to gain from batching */
+	bool is_batched() const { return !store; }
 	int clear(std::string dbPath);
 private:
-	rocksdb::DB* kvdb;
+	rocksdb::DB* kvdb; // null with KVDB_TYPE::MMAP
 	rocksdb::Options options;
+	rocksdb::WriteOptions batch_options; // WAL disabled
+	std::unique_ptr<Resultstore> store; // KVDB_TYPE::MMAP
+};
+
+/*
+ * Puts of a single thread collected into a write batch. The batch is written 
+ * every 'KeyValueDatabase::WRITE_BATCH_SIZE' puts and when the object is destroyed.
+ */
+class KvdbBatch {
+public:
+	KvdbBatch(KeyValueDatabase& kvdb) : kvdb(kvdb), num_puts(0) {}
+	~KvdbBatch() { flush(); }
+
+	void put(const std::string& key, const std::string& val)
+	{
+		if (!kvdb.is_batched()) {
+			kvdb.put(key, val);
+			return;
+		}
+		batch.Put(key, val);
+		if (++num_puts == KeyValueDatabase::WRITE_BATCH_SIZE)
+			flush();
+	}
+
+	void flush()
+	{
+		if (num_puts > 0) {
+			kvdb.write(batch);
+			num_puts = 0;
+		}
+	}
+private:
+	KeyValueDatabase& kvdb;
+	rocksdb::WriteBatch batch;
+	std::size_t num_puts;
 };
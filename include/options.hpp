@@ -56,6 +56,7 @@ OPT_ALIGNED = "aligned",
 OPT_OTHER = "other",
 OPT_WORKDIR = "workdir",
 OPT_KVDB = "kvdb",
+OPT_KVDB_STORE = "kvdb_store",
 OPT_IDXDIR = "idx-dir",
 OPT_READB = "readb",
 OPT_FASTX = "fastx",
@@ -105,8 +106,10 @@ OPT_DBG_PUT_DB = "dbg_put_db",
 OPT_TMPDIR = "tmpdir",
 OPT_INTERVAL = "interval",
 OPT_MAX_POS = "max_pos",
-OPT_READS_FEED = "reads_feed",  // TODO: on hold
+OPT_READS_FEED = "reads_feed",
+OPT_SPLIT_ZIP = "split_zip",
 OPT_ZIP_OUT = "zip-out",
+OPT_RESIDENT = "resident",
 OPT_INDEX = "index",
 OPT_ALIGN = "align",  // TODO: on hold
 OPT_FILTER = "filter",  // TODO: on hold
@@ -172,12 +175,17 @@ help_workdir =
 help_kvdb =
 	"Directory for Key-value database            WORKDIR/kvdb\n\n"
 	"       KVDB is used for storing the alignment results.\n\n",
+help_kvdb_store =
+	"Storage of the alignment results in KVDB dir            0\n\n"
+	"       0 - RocksDB key-value database\n"
+	"       1 - Memory mapped files. Fixed size slots indexed by the reads file and the read number\n"
+	"           pointing into a heap of the results. No hashing and no compactions\n\n",
 help_idxdir =
 	"Directory for storing Reference index.      WORKDIR/idx\n\n",
 help_readb = 
 	"Storage for pre-processed reads             WORKDIR/readb/\n\n"
-	"       Directory storing the split reads, or the random access index of compressed reads\n\n",
-	//"       Use with '" + OPT_READS_FEED + "'\n\n",
+	"       Directory storing the split reads, or the random access index of compressed reads\n"
+	"       Not used with '" + OPT_READS_FEED + " 1'\n\n",
 help_sam = 
 	"Output SAM alignment for aligned reads.\n\n",
 help_SQ = 
@@ -332,6 +340,12 @@ help_a =
 	"                                            Automatically redirects to '-threads'\n",
 help_threads = 
 	"Number of Processing threads to use                     2\n",
+help_resident = 
+	"Keep all the index parts and references loaded          False\n"
+	"                                            in memory and align the reads in a single pass\n"
+	"                                            over all the parts. Falls back to processing\n"
+	"                                            the index parts one by one if the available\n"
+	"                                            memory is not sufficient.\n",
 help_thpp = 
 	"Number of Post-Processing Read:Process threads to use   1:1\n",
 help_threp = 
@@ -354,14 +368,24 @@ help_max_pos =
 	"                                            store for each unique L-mer.\n"
 	"                                            If 0 - all positions are stored.\n",
 
-//help_reads_feed = 
-//	"Method of accessing the reads by the                    0\n"
-//	"                                            reads processors\n\n"
-//	"       0 - Split reads. Reads files are split into parts equal the number of processing threads\n"
-//	"       1 - FUTURE: Lockless queue. Reads are put into a lockless queue\n"
-//	"                   to be popped by the processing threads\n"
-//	"       3 - FUTURE: Random access to the compresssed reads files\n"
-//	"       4 - FUTURE: combination of the random access and the lockless queue\n\n",
+help_reads_feed = 
+	"Method of accessing the reads by the                    0\n"
+	"                                            reads processors\n\n"
+	"       0 - Split reads. Reads files are split into parts equal the number of processing threads\n"
+	"       1 - Lockless queue. A reader thread parses the reads files into batches put into a lockless queue\n"
+	"           to be popped by the processing threads. No split files are written - each pass over the reads\n"
+	"           streams the original files. Suits best the runs with a single index part\n"
+	"       2 - Binary read store. Same as 0, but the split parts are binary stores with the sequences packed\n"
+	"           2 bits per nucleotide and indexed by the read number. The passes over the reads need no parsing,\n"
+	"           and the blast/sam report passes fetch only the reads aligned to the reference part\n\n",
+
+help_split_zip =
+	"Compression of the split reads files                    0\n\n"
+	"       The split files are read on each pass over the reads i.e. once per index part and\n"
+	"       once per report pass. Only used if the reads files are compressed.\n"
+	"       0 - No compression. Fastest, uses the most disk space in the '" + OPT_READB + "' directory\n"
+	"       1 - gzip with the fastest compression level\n"
+	"       2 - gzip with the default compression level\n\n",
 
 help_zip_out =
 	"Controls the output compression                       Yes/True\n\n"
@@ -485,6 +509,7 @@ public:
 	int  findex = 2; // 0 (don't build index) | 1 (only build index) | 2 (default - build index if not present)
 	bool is_align = false;
 	bool is_filter = false;
+	bool is_resident = false; // OPT_RESIDENT keep all index parts in memory during alignment
 
 	// Option derived Flags
 	bool is_as_percent = false; // derived from OPT_EDGES
@@ -539,6 +564,8 @@ public:
 	long gap_extension = 2; // '--gap_ext' SW penalty (positive integer) for extending a gap
 	int score_N = 0; // '-N' SW penalty for ambiguous letters (N's)
 	FEED_TYPE feed_type = FEED_TYPE::SPLIT_READS; // OPT_READS_FEED
+	SPLIT_ZIP split_zip = SPLIT_ZIP::FLAT; // OPT_SPLIT_ZIP
+	KVDB_TYPE kvdb_type = KVDB_TYPE::ROCKSDB; // OPT_KVDB_STORE
 
 	double evalue = -1.0; // '-e' E-value threshold
 	double min_id = -1.0; // OTU-picking option: Identity threshold (%ID)
@@ -627,6 +654,7 @@ private:
 	void opt_N(const std::string& val); // opt_N_MatchAmbiguous
 	void opt_workdir(const std::string& path);
 	void opt_kvdb(const std::string& path);
+	void opt_kvdb_store(const std::string& val);
 	void opt_idxdir(const std::string& path); // see help_idxdir
 	void opt_readb(const std::string& path);
 	void opt_dbg_level(const std::string& val);
@@ -638,7 +666,9 @@ private:
 	void opt_L(const std::string &val);
 	void opt_max_pos(const std::string &val);
 	void opt_reads_feed(const std::string& val);
+	void opt_split_zip(const std::string& val);
 	void opt_zip_out(const std::string& val);
+	void opt_resident(const std::string& val);
 	void opt_index(const std::string& val); // help_index
 	void opt_align(const std::string& val); // TODO: may be no need for this  20210207
 	void opt_filter(const std::string& val); // TODO: may be no need for this  20210207
@@ -668,13 +698,14 @@ private:
 	std::multimap<std::string, std::string> mopt;
 
 	// OPTIONS Map - specifies all possible options
-	const std::array<opt_6_tuple, 53> options = {
+	const std::array<opt_6_tuple, 57> options = {
 		std::make_tuple(OPT_REF,            "PATH",        COMMON,      true,  help_ref, &Runopts::opt_ref),
 		std::make_tuple(OPT_READS,          "PATH",        COMMON,      true,  help_reads, &Runopts::opt_reads),
 		//std::make_tuple(OPT_ALIGN,          "BOOL",        COMMON,      true,  help_align, &Runopts::opt_align),
 		//std::make_tuple(OPT_FILTER,         "BOOL",        COMMON,      true,  help_filter, &Runopts::opt_filter),
 		std::make_tuple(OPT_WORKDIR,        "PATH",        COMMON,      false, help_workdir, &Runopts::opt_workdir),
 		std::make_tuple(OPT_KVDB,           "PATH",        COMMON,      false, help_kvdb, &Runopts::opt_kvdb),
+		std::make_tuple(OPT_KVDB_STORE,     "INT",         COMMON,      false, help_kvdb_store, &Runopts::opt_kvdb_store),
 		std::make_tuple(OPT_IDXDIR,         "PATH",        COMMON,      false, help_idxdir, &Runopts::opt_idxdir),
 		std::make_tuple(OPT_READB,          "PATH",        COMMON,      false, help_readb, &Runopts::opt_readb),
 		std::make_tuple(OPT_FASTX,          "BOOL",        COMMON,      false, help_fastx, &Runopts::opt_fastx),
@@ -701,7 +732,8 @@ private:
 		std::make_tuple(OPT_F,              "BOOL",        COMMON,      false, help_F, &Runopts::opt_F),
 		std::make_tuple(OPT_N,              "BOOL",        COMMON,      false, help_N, &Runopts::opt_N),
 		std::make_tuple(OPT_R,              "BOOL",        COMMON,      false, help_R, &Runopts::opt_R),
-		//std::make_tuple(OPT_READS_FEED,     "INT",         COMMON,      false, help_reads_feed, &Runopts::opt_reads_feed),
+		std::make_tuple(OPT_READS_FEED,     "INT",         COMMON,      false, help_reads_feed, &Runopts::opt_reads_feed),
+		std::make_tuple(OPT_SPLIT_ZIP,      "INT",         COMMON,      false, help_split_zip, &Runopts::opt_split_zip),
 		std::make_tuple(OPT_ID,             "INT",         OTU_PICKING, false, help_id, &Runopts::opt_id),
 		std::make_tuple(OPT_COVERAGE,       "INT",         OTU_PICKING, false, help_coverage, &Runopts::opt_coverage),
 		std::make_tuple(OPT_DENOVO_OTU,     "BOOL",        OTU_PICKING, false, help_denovo_otu, &Runopts::opt_denovo_otu),
@@ -713,6 +745,7 @@ private:
 		std::make_tuple(OPT_PID,            "BOOL",        ADVANCED,    false, help_pid, &Runopts::opt_pid),
 		std::make_tuple(OPT_A,              "INT",         ADVANCED,    false, help_a, &Runopts::opt_a),
 		std::make_tuple(OPT_THREADS,        "INT",         ADVANCED,    false, help_threads, &Runopts::opt_threads),
+		std::make_tuple(OPT_RESIDENT,       "BOOL",        ADVANCED,    false, help_resident, &Runopts::opt_resident),
 		std::make_tuple(OPT_INDEX,          "INT",         INDEXING,    false, help_index, &Runopts::opt_index),
 		std::make_tuple(OPT_L,              "DOUBLE",      INDEXING,    false, help_L, &Runopts::opt_L),
 		std::make_tuple(OPT_M,              "DOUBLE",      INDEXING,    false, help_m, &Runopts::opt_m),
@@ -41,6 +41,7 @@ struct Readstats;
 class Readfeed;
 class References;
 class KeyValueDatabase;
+class Read;
 
 class OtuMap {
 	// Clustering of reads around references by similarity i.e. {ref: [read, read, ...] , ref : [read, read...] , ...}
@@ -55,10 +56,9 @@ public:
 public:
 	OtuMap(int numThreads=1);
 	void push(int idx, std::string& ref_seq_str, std::string& read_seq_str);
+	void push(int idx, References& refs, uint32_t ref_num, Read& read);
 	void merge();
 	void write();
 	void init(Runopts& opts);
 	size_t count_otu();
 };
-
-void fill_otu_map(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kvdb, Runopts& opts, bool is_write=true);
@@ -36,6 +36,9 @@
 
 #pragma once
 
+#include <mutex>
+#include <condition_variable>
+
 #include "report_fastx.h"
 #include "report_fx_other.h"
 #include "report_blast.h"
@@ -53,8 +56,6 @@ struct Runopts;
 class KeyValueDatabase;
 class Readfeed;
 
-void writeReports(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kvdb, Runopts& opts);
-
 class Output {
 public:
 	ReportFastx fastx; // fastx aligned report
@@ -64,10 +65,35 @@ public:
 	ReportSam sam;
 	ReportBiom biom;
 
+	static const std::size_t COMMIT_SIZE = 1 << 22; // buffered bytes of a thread, all the reports, that trigger a commit
+
 	Output(Readfeed& readfeed, Runopts& opts, Readstats& readstats);
 	//~Output();
 
+	/* report a read or a pair. 'is_fx': fastx, other and denovo - once per read. Blast and SAM - on every reference part */
+	void append(const uint32_t& id, std::vector<Read>& reads, References& refs, Refstats& refstats, Runopts& opts, bool is_fx);
+	/* start a pass of 'num_threads' report threads over the reads. Called before the threads start */
+	void begin(const uint32_t& num_threads, Runopts& opts, bool is_fx);
+	/* the last commit of the report thread in the pass. Each thread started after 'begin' has to call it */
+	void end(const uint32_t& id);
+	/* commit the report buffers of all the threads and close the report files */
+	void finish(Readfeed& readfeed, Runopts& opts);
+
 private:
 	void init(Readfeed& readfeed, Runopts& opts, Readstats& readstats);
+	/*
+	 * append the buffers of the thread to the report files of all the reports at once. Waits for the turn of the thread.
+	 * The threads commit round robin in the order of the threads i.e. of the splits, skipping the threads done with the pass,
+	 * so the output does not depend on the timing of the threads. A single turn for all the reports, so a thread
+	 * never waits in one report while owing its turn in another
+	 * @param is_last  the last commit of the thread in the pass. Commits regardless of the size of the buffers
+	 */
+	void commit(const uint32_t& id, bool is_last);
+
+	std::vector<Report*> reports; // the reports written in the pass, set by 'begin'
+	std::mutex commit_lock;
+	std::condition_variable commit_cv; // signals the turn of the next thread to commit
+	uint32_t commit_turn; // the thread to commit next
+	std::vector<bool> is_done; // flags the threads that made the last commit in the pass
 
 }; // ~class Output
\ No newline at end of file
@@ -40,7 +40,6 @@
 #include <sstream>
 #include <vector>
 #include <algorithm> // std::find_if
-#include <tuple>
 
 #include "kvdb.hpp"
 #include "traverse_bursttrie.hpp" // id_win
@@ -48,6 +47,7 @@
 #include "options.hpp"
 
 class References; // forward
+struct Readrec;
 
 struct alignment_struct2
 {
@@ -136,10 +136,13 @@ public:
 public:
 	Read();
 	Read(std::string& readstr);
+	Read(const Readrec& rec); // copies the record's fields
 	Read(std::string id, std::string& read);
 	Read(std::string id, std::string header, std::string sequence, std::string quality, BIO_FORMAT format);
 	Read(const Read & that); // copy constructor
+	Read(Read && that) = default;
 	Read & operator=(const Read & that); // copy assignment
+	Read & operator=(Read && that) = default;
 	//~Read();
 
 public:
@@ -152,8 +155,11 @@ public:
 	std::string matchesToJson();
 	void unmarshallJson(KeyValueDatabase& kvdb);
 	/* serialize to binary string to store in DB */
+	static constexpr uint32_t BIN_FORMAT = 0x534d5202; // 'SMR' + format version 2 - leads 'toBinString'. Bump on any change of the stored fields (read, alignment_struct2, s_align2)
 	std::string toBinString(); 
 	bool load_db(KeyValueDatabase& kvdb);
+	bool load_db(const std::string& bstr);
+	static void load_db(KeyValueDatabase& kvdb, std::vector<Read>& reads);
 	void seqToIntStr();
 	void revIntStr();
 	/* convert isequence to alphabetic form i.e. to A,C,G,T,N */
@@ -162,12 +168,12 @@ public:
 	void flip34();
 
 	/*
-	* count mismatches, gaps, matches, and calculate %ID, %COV given an alignment
+	* count mismatches, gaps, matches given an alignment. The counts are stored in the alignment,
+	* see 's_align2::id', 's_align2::cov' for %ID, %COV
 	* @param  refs   references
-	* @param  align  alignment to evaluate
-	* @return tuple<mismatches, gaps, matches, %ID, %COV>
+	* @param  align  alignment to evaluate. The read has to be on the strand of the alignment, ambiguous nt as 4
 	*/
-	std::tuple<uint32_t, uint32_t, uint32_t, double, double> calc_miss_gap_match(const References& refs, const s_align2& align);
+	void calc_miss_gap_match(const References& refs, s_align2& align);
 
 	std::string getSeqId();
 	uint32_t hashKmer(uint32_t pos, uint32_t len);
@@ -0,0 +1,143 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/**
+ * FILE: readb.hpp
+ * Created: Oct 16, 2026 Fri
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <filesystem>
+
+// forward
+class Read;
+struct Readrec;
+
+/*
+ * Binary read store written by 'Readfeed::split' for each split file when '-reads_feed 2'
+ *
+ * The reads are stored in columns, each in its own file, so that a pass maps only the columns it uses:
+ *
+ *   <name>.rdb         readb_header followed by readb_rec[num_reads] - the read number offset index
+ *   <name>.rdb.seq     sequences packed 2 bits per nucleotide in the 0..3 alphabet of 'Read::isequence'.
+ *                      Each sequence starts on a byte boundary and is followed by its exceptions: 
+ *                      uint32 positions then the original characters of the nucleotides that are not 
+ *                      one of 'ACGT' (ambiguous, lower case, 'U'). Ambiguous nucleotides are packed as 0 (A) 
+ *                      same as in 'Read::seqToIntStr'
+ *   <name>.rdb.hdr     headers one after another
+ *   <name>.rdb.qual    qualities one after another (empty for fasta)
+ */
+const char READB_MAGIC[8] = { 'S', 'M', 'R', 'R', 'E', 'A', 'D', 'B' };
+const uint32_t READB_VERSION = 1;
+
+struct readb_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags; // reserved
+	uint64_t num_reads;
+	uint64_t seq_size; // size of each column file. Checked when mapping
+	uint64_t header_size;
+	uint64_t quality_size;
+};
+
+struct readb_rec {
+	uint64_t seq_pos; // position of the packed sequence in the sequence column
+	uint64_t header_pos;
+	uint64_t quality_pos;
+	uint32_t seq_len; // number of nucleotides
+	uint32_t header_len;
+	uint32_t quality_len;
+	uint32_t num_exc; // number of exceptions following the packed sequence
+	uint32_t is_ok; // the record was parsed fine, see 'Readrec::is_ok'
+	uint32_t reserved;
+};
+
+class Readb {
+public:
+	Readb();
+	~Readb();
+	Readb(const Readb&) = delete;
+	Readb& operator=(const Readb&) = delete;
+	Readb(Readb&& that) noexcept;
+	Readb& operator=(Readb&& that) noexcept;
+
+	/* create a new store. Truncates the existing files */
+	void create(const std::filesystem::path& path);
+	/* append a read. The read number is the count of the reads put before it */
+	void put(const Readrec& rec);
+	/* write the header and close the files of the store being created */
+	void close();
+
+	/* map the store read-only. False if the store is missing or not valid */
+	bool open(const std::filesystem::path& path);
+	void unmap();
+	uint64_t size() const { return num_reads; }
+	/*
+	 * fill the read's header, sequence, quality, and the integer sequence 'isequence' with the ambiguous 
+	 * positions directly from the packed sequence i.e. the read needs no 'seqToIntStr'
+	 * @return false if there is no such read
+	 */
+	bool get(uint64_t read_num, Read& read) const;
+	std::string_view header(uint64_t read_num) const;
+	std::string_view quality(uint64_t read_num) const;
+
+	/* remove the store and its column files */
+	static void remove(const std::filesystem::path& path);
+
+private:
+	struct Mapped {
+		char* addr = nullptr;
+		std::size_t size = 0;
+	};
+	static bool map_file(const std::filesystem::path& path, Mapped& mf);
+	static void unmap_file(Mapped& mf);
+
+private:
+	uint64_t num_reads;
+	// creating
+	std::filesystem::path path;
+	std::ofstream ofs_rec;
+	std::ofstream ofs_seq;
+	std::ofstream ofs_hdr;
+	std::ofstream ofs_qual;
+	readb_header hdr;
+	std::string packed; // buffer of a packed sequence
+	// reading
+	Mapped idx; // header and records
+	Mapped seq;
+	Mapped text; // headers
+	Mapped qual;
+	const readb_rec* recs;
+}; // ~class Readb
@@ -38,29 +38,90 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <fstream> // std::ifstream
 #include <filesystem>
+#include <memory> // std::unique_ptr
+#include <mutex>
+#include <atomic>
 
 #include "common.hpp"
 #include "izlib.hpp"
+#include "inflater.hpp"
+#include "readb.hpp"
 #include "readstate.h"
 #include "readfile.h"
 
  // forward
 class Read;
 class KeyValueDatabase;
+class ReadsQueue;
 struct Runopts;
 
+/*
+ * a read record filled by 'Readfeed::next' directly from the reads file: the header, the sequence
+ * and the quality are views into the record's buffer, which is reused for all the reads (one record per thread).
+ * The views are valid until the next call to 'Readfeed::next' with the same record.
+ */
+struct Readrec
+{
+	std::size_t readfile_idx = 0; // index of the split reads file the read comes from (FWD/REV stream for LOCKLESS)
+	std::size_t read_num = 0; // read number in the file starting from 0
+	std::string_view header;
+	std::string_view sequence;
+	std::string_view quality; // empty for fasta
+	bool is_ok = false; // the record has the expected number of lines
+	std::string buf; // 'header \n sequence [\n quality]' as read from the file
+	std::string line; // line buffer of the reader
+
+	/* set the views on the buffer. False if the buffer has more lines than the format allows */
+	bool parse();
+};
+
 /* 
  * Database-like interface for accessing reads
  */
 class Readfeed {
 public:
 	Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, std::filesystem::path& basedir, bool is_paired);
-	Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, const unsigned num_parts, std::filesystem::path& basedir, bool is_paired);
+	Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, const unsigned num_parts, std::filesystem::path& basedir, bool is_paired, SPLIT_ZIP split_zip = SPLIT_ZIP::FLAT);
+	/*
+	 * READB: open the read stores of an existing split for 'loadReadByIdx/Id' without touching 
+	 * the reads files i.e. never splits. The layout is taken from the descriptor. 'is_ready' is false on failure
+	 */
+	Readfeed(std::filesystem::path& basedir);
+	~Readfeed();
 
+	/*
+	 * LOCKLESS feed reader. Runs in a thread for a single pass over the original reads files, 
+	 * pushing batches of records on the queue popped by 'next'
+	 */
 	void run();
-	bool next(int inext, std::string& readstr);
+	/*
+	 * SPLIT_READS: get the next read from the split file 'inext'
+	 * READB:       get the next read from the read store 'inext'
+	 * LOCKLESS:    get the next read of the batch popped by the calling thread. 'inext' is not used - 
+	 *              the reads of a pair are always in the same batch, and come one after another
+	 */
+	bool next(int inext, Readrec& rec);
+	/*
+	 * get the next block of at most 'max_reads' reads (even if paired - the reads of a pair are never split between the blocks)
+	 *
+	 * @param inext     IN/OUT index of the stream to read. Switched FWD-REV after each read if paired
+	 * @param rec       record buffer reused for all the reads
+	 * @param reads     OUT the reads. Cleared first
+	 * @return          true if the block has reads
+	 */
+	bool next(int& inext, Readrec& rec, std::vector<Read>& reads, std::size_t max_reads);
+	/*
+	 * get the next block of reads for a processor. SPLIT_READS, READB: the processor takes the blocks of its own
+	 * split first, then the blocks of the splits still having reads, so that no processor sits idle while 
+	 * the others finish their splits. The blocks are taken under the split's lock.
+	 * LOCKLESS: same as 'next' - the queue balances the load already
+	 *
+	 * @param isplit  IN/OUT the split the processor takes the blocks from. Init with the processor ID
+	 */
+	bool next_block(unsigned& isplit, Readrec& rec, std::vector<Read>& reads, std::size_t max_reads);
 	void reset();
 	void rewind();
 	void rewind_in();
@@ -80,22 +141,25 @@ public:
 	*/
 	int clean();
 	static bool hasnext(std::ifstream& ifs);
-	static bool loadReadByIdx(Read& read);
-	static bool loadReadById(Read& read);
+	/*
+	 * READB: load the read 'read.read_num' of the split 'read.readfile_idx' from the read store.
+	 * The read comes with the integer sequence i.e. needs no 'Read::seqToIntStr'. Thread safe after 'init_reading'
+	 * @return false if there is no such read or the feed is not READB
+	 */
+	bool loadReadByIdx(Read& read) const;
+	/* same as 'loadReadByIdx' given the read ID 'readfile-idx_read-num' */
+	bool loadReadById(Read& read) const;
 
 private:
 	/*
-     * get a next read string from a reads file
-     * 20201012: TODO: exactly the same as next(int, uint, str, bool) but doesn't count sequence length.
-	 *  			   Counting sequence length could be a very small overhead -> no need for this overload?
+     * get a next read record from a reads file
      * 
      * @param inext   IN  index of the stream to read.
-     * @param readstr IN  read sequence
-     * @param is_orig IN  flags to return the original read string. If false, then the read string has format: 'read_id \n header \n sequence [\n quality]'
+     * @param rec     OUT read record. Its buffers are reused
      * @param files   IN  array of read files' descriptors
      * @return            true if record exists, else false
     */
-	bool next(int inext, std::string& readstr, bool is_orig, std::vector<Readfile>& files);
+	bool next(int inext, Readrec& rec, std::vector<Readfile>& files);
 	//bool next(int inext, std::string& readstr, unsigned& readlen, bool is_orig = false); // \n separated read data. FA - 2 lines, FQ - 4 lines
 	/*
      * uses zlib if files are gzipped or reads flat files
@@ -110,12 +174,16 @@ private:
 	bool next(int inext, std::string& readstr, unsigned& readlen, bool is_orig, std::vector<Readfile>& files);
 
 public:
+	static constexpr std::size_t BATCH_SIZE = 1024; // number of reads in a batch (LOCKLESS queue, split round-robin). Even - keeps the pairs together
+	static constexpr std::size_t QUEUE_SIZE = 16; // LOCKLESS: max number of batches on the queue
+
 	FEED_TYPE type;
 	bool is_done; // flags end of all read streams
 	bool is_ready; // flags the read feed is ready i.e. no need to run split
 	bool is_format_defined; // flags the file format is defined i.e. 'define_format' was success
 	bool is_two_files; // flags two read files are processed (otherwise single file)
 	bool is_paired;
+	SPLIT_ZIP split_zip; // compression of the split files if the original files are compressed
 	unsigned num_orig_files; // number of original reads files
 	unsigned num_splits;
 	unsigned num_split_files;
@@ -128,10 +196,19 @@ public:
 	std::vector<Readfile> orig_files;
 private:
 	std::vector<Readfile> split_files;
+	std::vector<Readb> readbv; // READB: the read stores, one per split file
+	std::unique_ptr<ReadsQueue> queue; // LOCKLESS: batches of reads from 'run' to the processors
+
+	// 'next_block': access to a split shared by the processors
+	struct Splitlock {
+		std::mutex lock;
+		std::atomic<bool> is_done{ false }; // no more reads in the split - skipped without locking
+	};
+	std::unique_ptr<Splitlock[]> split_locks;
 
 	// input processing
 	std::vector<std::ifstream> ifsv; // [fwd_0, rev_0, fwd_1, rev_1, ... fwd_n-1, rev_n-1]
-	std::vector<Izlib> vzlib_in;
+	std::vector<Inflater> vzlib_in; // inflating ahead on background threads
 	std::vector<Readstate> vstate_in;
 
 	// output processing
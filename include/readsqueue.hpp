@@ -36,144 +36,196 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <memory> // std::unique_ptr
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <sstream>
 #include <atomic>
+#include <cstdint> // std::intptr_t
 
 #include "common.hpp"
 #include "read.hpp"
+#include "readfeed.hpp" // Readrec
 
-#if defined(CONCURRENTQUEUE)
-#  include "concurrentqueue.h"
-#elif defined(LOCKQUEUE)
-#  include <queue>
-#endif
-
+/* a batch of read records. Pushed and popped as a whole to keep the queue traffic low */
+using Readbatch = std::vector<Readrec>;
 
 /**
- * Queue for Reads' records. Concurrently accessed by the Reader (producer) and the Processors (consumers)
+ * Bounded queue of read batches. Concurrently accessed by the Readers (producers) and the Processors (consumers)
+ *
+ * Multi-producer multi-consumer ring buffer (D.Vyukov). Each cell has a sequence number telling whether the cell
+ * is free for the push of the current lap, or holds a batch ready for the pop. Pushers and poppers only contend
+ * on their position counters. The batches are swapped in and out of the cells i.e. the records are never copied,
+ * and the buffers of the consumed batches go back to the Readers to be reused.
+ *
+ * A thread finding the queue full (push) or empty (pop) yields a few times, then parks on a condition variable
+ * until the other side makes progress. The end of the stream is signalled by the last pusher calling 'done_push'.
  */
 class ReadsQueue 
 {
 public:
 	std::string id;
-	size_t capacity; // max size of the queue
-	unsigned reads_tot; // total number of reads expected to be pushed/popped
-	std::atomic_uint num_pushed;
-	unsigned count_to_print;
-	unsigned max_print_count;
-	std::atomic_uint num_popped;
-	std::atomic_uint num_poppers;
-#if defined(CONCURRENTQUEUE)
-	moodycamel::ConcurrentQueue<std::string> queue; // lockless queue
-#elif defined(LOCKQUEUE)
-	std::queue<Read> recs; // shared: Reader & Processors, Writer & Processors
-	std::mutex qlock; // lock for push/pop on queue
-	std::condition_variable cvQueue;
-#endif
 
-public:
-	ReadsQueue(std::string id = "", std::size_t capacity = 100, std::size_t num_reads_tot = 0, std::size_t poppers = 0)
+	/*
+	 * @param id         queue name for logging
+	 * @param capacity   max number of batches in the queue. Rounded up to a power of 2
+	 * @param pushers    number of threads pushing on the queue
+	 */
+	ReadsQueue(std::string id = "", std::size_t capacity = 16, unsigned pushers = 1)
 		:
 		id(id),
-		capacity(capacity),
-		reads_tot(num_reads_tot),
-		num_pushed(0),
-		count_to_print(0),
-		max_print_count(reads_tot/20),
-		num_popped(0),
-		num_poppers(poppers)
-#ifdef CONCURRENTQUEUE
-		,
-		queue(capacity) // set initial capacity
-#endif
+		mask(0),
+		push_pos(0),
+		pop_pos(0),
+		num_pushers(pushers),
+		num_push_waiting(0),
+		num_pop_waiting(0)
 	{
-		INFO("created Reads queue with capacity [", capacity, "] Total reads to process: ", num_reads_tot);
+		std::size_t size = 2;
+		for (; size < capacity; size <<= 1);
+		mask = size - 1;
+		cells.reset(new Cell[size]);
+		for (std::size_t i = 0; i < size; ++i)
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		INFO("created Reads queue ", id, " with capacity [", size, "] batches");
 	}
 
-	//~ReadsQueue()
-
 	/** 
-	 * Synchronized. Blocks until queue has capacity for more reads
-	 * pushing stops automatically upon EOF which sets is_done_push = true
+	 * Blocks while the queue is full. The pushed batch is swapped with the content of the cell,
+	 * so on return 'batch' holds the records of an already consumed batch (or nothing)
 	 */
-	bool push(const std::string& rec) 
+	void push(Readbatch& batch)
 	{
-		bool ret = false;
-#if defined(CONCURRENTQUEUE)
-		while (!(ret = queue.try_enqueue(rec))) {
-			std::this_thread::sleep_for(std::chrono::nanoseconds(5));
-		}
-		if (ret) {
-			num_pushed.fetch_add(1, std::memory_order_relaxed);
-			++count_to_print;
+		for (unsigned i = 0; !try_push(batch); ++i) {
+			if (i < NUM_SPINS) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> lk(qlock);
+			num_push_waiting.fetch_add(1, std::memory_order_seq_cst);
+			cv_push.wait(lk, [this] { return is_push_ready(); });
+			num_push_waiting.fetch_sub(1, std::memory_order_relaxed);
 		}
-		if (count_to_print == max_print_count)
-		{
-			INFO_MEM("Thread [", std::this_thread::get_id(), "] Pushed another: ", max_print_count, ". Queue size: ", queue.size_approx());
-			count_to_print = 0;
-
+		wake(num_pop_waiting, cv_pop);
+	} // ~push
+
+	/**
+	 * Blocks while the queue is empty and there are active pushers. 
+	 * The popped batch is swapped with 'batch' i.e. the passed batch is left in the cell for reuse
+	 *
+	 * @return false when all the pushers are done and the queue is empty
+	 */
+	bool pop(Readbatch& batch)
+	{
+		for (unsigned i = 0;; ++i) {
+			// load before looking at the cells: no pushers means all the pushes are visible
+			auto is_last = num_pushers.load(std::memory_order_acquire) == 0;
+			if (try_pop(batch))
+				break;
+			if (is_last)
+				return false; // empty and no more pushes
+			if (i < NUM_SPINS) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> lk(qlock);
+			num_pop_waiting.fetch_add(1, std::memory_order_seq_cst);
+			cv_pop.wait(lk, [this] { return is_pop_ready() || num_pushers.load(std::memory_order_acquire) == 0; });
+			num_pop_waiting.fetch_sub(1, std::memory_order_relaxed);
 		}
-		if (reads_tot == num_pushed.load(std::memory_order_relaxed))
-		{
-			INFO("Thread [" , std::this_thread::get_id(), "] done Push reads total: ", reads_tot, ". Queue size: ", queue.size_approx());
+		wake(num_push_waiting, cv_push);
+		return true;
+	} // ~pop
+
+	/* called by a pusher when done pushing. The last one wakes up all the waiting poppers */
+	void done_push() {
+		if (num_pushers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::lock_guard<std::mutex> lk(qlock);
+			cv_pop.notify_all();
 		}
-#elif defined(LOCKQUEUE)
-		std::unique_lock<std::mutex> lmq(qlock);
-		cvQueue.wait(lmq, [this] { return recs.size() < capacity; });
-		recs.push(std::move(rec));
-		cvQueue.notify_one();
-#endif
-		return ret;
 	}
 
-	// synchronized
-	// return false when is_done_push == true && num_pushed == num_popped
-	bool pop(std::string& rec)
+	/* prepare for the next pass over the reads. The queue is empty at this point */
+	void reset(unsigned pushers = 1) {
+		num_pushers.store(pushers, std::memory_order_release);
+	}
+
+private:
+	struct Cell {
+		std::atomic<std::size_t> seq;
+		Readbatch batch;
+	};
+
+	static constexpr unsigned NUM_SPINS = 16; // yields before parking
+
+	bool try_push(Readbatch& batch)
 	{
-		bool ret = false;
-		//unsigned num_pop_tries = 0;
-#if defined(CONCURRENTQUEUE)
-		for (; !(ret = queue.try_dequeue(rec)); ) {
-			std::this_thread::sleep_for(std::chrono::nanoseconds(1));
-			// acquire
-			// num_pushed.load(std::memory_order_relaxed) == reads_tot && queue.size_approx() == 0
-			if (num_popped.load(std::memory_order_relaxed) == reads_tot) {
-				break;
+		auto pos = push_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = cells[pos & mask];
+			auto dif = static_cast<std::intptr_t>(cell.seq.load(std::memory_order_acquire)) - static_cast<std::intptr_t>(pos);
+			if (dif < 0)
+				return false; // full
+			if (dif == 0 && push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				std::swap(cell.batch, batch);
+				cell.seq.store(pos + 1, std::memory_order_release);
+				return true;
 			}
-			//INFO("Thread [", std::this_thread::get_id(), "]  Queue size: ", queue.size_approx());
-			//else if (num_pop_tries > 1000) {
-			//	INFO("Thread [", std::this_thread::get_id(), "] done after max Pop tries: ", num_pop_tries, ". Queue size: ", queue.size_approx());
-			//	break;
-			//}
+			if (dif > 0)
+				pos = push_pos.load(std::memory_order_relaxed); // another pusher took the cell
 		}
-		if (ret)
-			num_popped.fetch_add(1, std::memory_order_relaxed); // ++num_out  store  release
-#elif defined(LOCKQUEUE)
-		std::unique_lock<std::mutex> lmq(qlock);
-		cvQueue.wait(lmq, [this] { return (pushers.load() == 0 && recs.empty()) || !recs.empty(); }); // if False - keep waiting, else - proceed.
-		if (!recs.empty()) 
-		{
-			rec = recs.front();
-			recs.pop();
-			++numPopped;
-			if (numPopped.load() % 100000 == 0)
-			{
-				std::stringstream ss;
-				ss << STAMP << id << " Popped read number: " << rec.read_num << "\r";
-				std::cout << ss.str();
+	} // ~try_push
+
+	bool try_pop(Readbatch& batch)
+	{
+		auto pos = pop_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = cells[pos & mask];
+			auto dif = static_cast<std::intptr_t>(cell.seq.load(std::memory_order_acquire)) - static_cast<std::intptr_t>(pos + 1);
+			if (dif < 0)
+				return false; // empty
+			if (dif == 0 && pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				std::swap(cell.batch, batch);
+				cell.seq.store(pos + mask + 1, std::memory_order_release);
+				return true;
 			}
+			if (dif > 0)
+				pos = pop_pos.load(std::memory_order_relaxed); // another popper took the cell
 		}
-		cvQueue.notify_one();
-#endif
-		return ret;
+	} // ~try_pop
+
+	bool is_push_ready() {
+		auto pos = push_pos.load(std::memory_order_relaxed);
+		return cells[pos & mask].seq.load(std::memory_order_acquire) == pos;
+	}
+
+	bool is_pop_ready() {
+		auto pos = pop_pos.load(std::memory_order_relaxed);
+		return cells[pos & mask].seq.load(std::memory_order_acquire) == pos + 1;
 	}
 
-	void reset() {
-		num_pushed = 0;
-		num_popped = 0;
+	/* 
+	 * wake up a thread parked on the other side. The fence pairs with the waiter's counter increment: 
+	 * either the waiter sees the cell just changed, or the counter is seen here and the waiter is notified
+	 */
+	void wake(std::atomic<unsigned>& num_waiting, std::condition_variable& cv)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (num_waiting.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lk(qlock); // the waiter is either before its check or waiting
+			cv.notify_one();
+		}
 	}
 
+	std::size_t mask; // capacity - 1
+	std::unique_ptr<Cell[]> cells;
+	alignas(64) std::atomic<std::size_t> push_pos;
+	alignas(64) std::atomic<std::size_t> pop_pos;
+	alignas(64) std::atomic<unsigned> num_pushers;
+	std::atomic<unsigned> num_push_waiting;
+	std::atomic<unsigned> num_pop_waiting;
+	std::mutex qlock; // guards the parking only
+	std::condition_variable cv_push;
+	std::condition_variable cv_pop;
 }; // ~class ReadsQueue
@@ -37,6 +37,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 
@@ -46,39 +47,62 @@
 class Refstats;
 struct Runopts;
 
+/*
+ * Header of the binary reference store <name>.refs_<part>.dat written by the indexer
+ *
+ * The file holds the references of an index part ready for the alignment and is mapped read-only by References::load:
+ *
+ *   refs_store_header
+ *   refs_store_rec[num_seq]    position and length of each sequence and header
+ *   sequences                  numerical (0-4) sequences one after another
+ *   headers                    headers as in the reference file (trailing whitespace removed)
+ */
+const char REFS_STORE_MAGIC[8] = { 'S', 'M', 'R', 'R', 'E', 'F', 'M', 'M' };
+const uint32_t REFS_STORE_VERSION = 1;
+
+struct refs_store_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_seq; // number of the references in the part
+	uint64_t rec_offset; // file offset of the records table
+	uint64_t seq_offset; // file offset of the sequences
+	uint64_t text_offset; // file offset of the headers
+	uint64_t file_size;
+};
+
+struct refs_store_rec {
+	uint64_t seq_pos; // position of the sequence relative to 'seq_offset'
+	uint64_t header_pos; // position of the header relative to 'text_offset'
+	uint32_t seq_len;
+	uint32_t header_len;
+	uint32_t id_pos; // position of the ID in the header
+	uint32_t id_len;
+};
+
 class References {
 public:
+	/*
+	 * the views point into the mapped reference store
+	 */
 	struct BaseRecord
 	{
 		size_t nid; // position of the sequence in the Reference file [0...'number of sequences in the ref.file - 1']
-		std::string id; // ID from header
-		std::string header;
-		std::string sequence;
-		std::string quality; // "" (fasta) | "xxx..." (fastq)
-		BIO_FORMAT format; // FASTA | FATSQ
-		bool isEmpty;
-		BaseRecord(): isEmpty(true) {}
-		void clear()
-		{
-			header.clear();
-			sequence.clear();
-			quality.clear();
-			isEmpty = true;
-		}
-
-		std::string getId() {
-			std::string id = header.substr(0, header.find(' '));
-			id.erase(id.begin(), std::find_if(id.begin(), id.end(), [](auto ch) {return !(ch == FASTA_HEADER_START || ch == FASTQ_HEADER_START);}));
-			return id;
-		}
+		std::string_view id; // ID from header
+		std::string_view header;
+		std::string_view sequence; // numerical form
 	};
 
 	std::vector<BaseRecord> buffer; // Container for references TODO: change name?
 
-	References(): num(0), part(0) {}
-	//~References() {}
+	References(): num(0), part(0), image(NULL), image_size(0) {}
+	~References();
+	// the buffer points into the mapped store, which is owned by a single object
+	References(const References&) = delete;
+	References& operator=(const References&) = delete;
+	References(References&& other) noexcept;
+	References& operator=(References&& other) noexcept;
 
-	void load(uint32_t idx_num, uint32_t idx_part, Runopts & opts, Refstats & refstats); // load references into the buffer given index number and index part
+	void load(uint32_t idx_num, uint32_t idx_part, Runopts & opts, Refstats & refstats, bool is_ids_only = false); // load references into the buffer given index number and index part
 	void convert_fix(std::string & seq); // convert sequence to numberical form and fix ambiguous chars
 	std::string convertChar(int idx); // convert numerical form to char string
 	/*
@@ -88,10 +112,21 @@ public:
 	int findref(const std::string& id);
 	void unload();
 
+	/*
+	 * parse the 'numseq_part' references starting at 'start_part' in the reference file 
+	 * and write them into the binary reference store. Called by the indexer for each index part
+	 */
+	static void write_store(const std::string& reffile, uint64_t start_part, uint32_t numseq_part, const std::string& outfile);
+
 public:
 	uint16_t num; // number of the reference file currently loaded
 	uint16_t part; // part of the reference file currently loaded
 
-//private:
-//	bool load_for_search;
+private:
+	bool map_file(const std::string& storefile, uint32_t numseq_part);
+	void unmap_file();
+
+private:
+	char* image; // the memory mapped reference store (.refs_N.dat). The buffer points into it
+	size_t image_size;
 }; // ~class References
@@ -37,6 +37,7 @@
 
 #include <cstdint>
 #include <vector>
+#include <array>
 #include <utility> // std::pair
 
 #include "indexdb.hpp" // index_parts_stats;
@@ -74,4 +75,5 @@ public:
 
 private:
 	void load(Runopts& opts, Readstats& readstats); // called at construction
+	void load_gumbel(Runopts& opts, std::vector<std::array<double, 4>>& background_freqs); // called by 'load'
 };
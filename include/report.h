@@ -32,6 +32,7 @@
 
 #include <vector>
 #include <fstream>
+#include <sstream>
 
 #include "readstate.h"
 #include "readfile.h"
@@ -43,6 +44,11 @@ struct Runopts;
 
 /*
  * base class for writing reports
+ *
+ * The report threads write into their own buffers. When large enough the buffers of a thread
+ * are written in one go to the report files, so the reads of a thread keep their order, and
+ * the paired report files the same order of the pairs. The order of the threads is kept by
+ * 'Output::commit' for all the reports together.
 */
 class Report
 {
@@ -51,18 +57,32 @@ public:
 	virtual ~Report() = 0;
 	virtual void init(Readfeed& readfeed, Runopts& opts) = 0;
 	/*
-	* merge split report files.
-	* override if necessary
+	* number of bytes buffered by the report thread
+	* @param id  report thread
 	*/
-	virtual void merge(const uint32_t& num_splits, const uint32_t& num_out, const int& dbg = 0);
+	std::size_t pending(const uint32_t& id);
+	/*
+	* end the gzip members of the thread buffers, and start new ones. No-op if not compressed
+	* @param id  report thread
+	*/
+	void seal(const uint32_t& id);
+	/*
+	* append the buffers of the thread to the report files. The caller keeps the order of the threads
+	* @param id  report thread
+	*/
+	void write(const uint32_t& id);
+	/*
+	* write the buffers of all the threads, end the gzip streams, close the report files, 
+	* and strip the split suffix
+	*/
+	void finish(const int& dbg = 0);
 	/*
 	* init zip interface. So far common to all the reports.
 	*/
 	virtual void init_zip();
 
-	void openfr(unsigned idx); // open a single file for reading
 	/*
-	* open report files for writing
+	* open report files for writing, and allocate the buffers
 	* @param dbg  debug level, see 'Runopts.dbg_level'
 	*/
 	void openfw(const int& dbg=0);
@@ -74,7 +94,6 @@ public:
 	void openfw(const uint32_t& idx, const int& dbg=0); // close selected report file
 	void closef(const int& dbg=0); // close report files
 	void closef(const uint32_t& idx, const int& dbg=0); // close a file
-	int finish_deflate();
 	/*
 	* strip the split suffix from the output file name 
 	* and rename the final output e.g. 
@@ -87,14 +106,12 @@ public:
 protected:
 	std::string pid_str; // std::to_string(getpid());
 	bool is_zip; // flags the report is compressed
-	std::vector<std::string> fv; // report files
-	std::vector<std::fstream> fsv;
-
-	// reading compressed out files when merging the final output
-	std::vector<Izlib> vzlib_in;
-	std::vector<Readstate> vstate_in;
+	uint32_t num_out; // number of report files
+	std::vector<std::string> fv; // report files [split * num_out + i]. Only the first 'num_out' are written
+	std::vector<std::fstream> fsv; // report files [0..num_out)
+	std::vector<std::stringstream> bufv; // buffers of the report threads, indexed as 'fv'
 
-	// writing compressed output during report generation and the final compressed output
+	// writing compressed output. Each commit is a separate gzip member
 	std::vector<Izlib> vzlib_out;
 	std::vector<Readstate> vstate_out;
 };
@@ -137,6 +137,46 @@ s_align* ssw_align (const s_profile* prof,
 					const int32_t filterd,
 					const int32_t maskLen);
 
+/*!	@function	Score only alignment of the profile query against many references at once, one reference per SIMD
+				lane (inter-sequence). Cheaper than ssw_align with flag 0 when many references are tried with the same
+				query, e.g. to discard the candidates scoring under a threshold before the full alignments.
+	@param	prof	pointer to the query profile structure (only the query, the matrix and the kernels are used)
+	@param	refs	the target sequences, numbers like for ssw_align
+	@param	refLens	lengths of the target sequences
+	@param	num_refs	number of target sequences
+	@param	weight_gapO	the absolute value of gap open penalty
+	@param	weight_gapE	the absolute value of gap extension penalty
+	@param	scores	[out] the optimal alignment score per target, same as score1 of ssw_align
+*/
+void ssw_score_batch (const s_profile* prof,
+					const int8_t** refs,
+					const int32_t* refLens,
+					int32_t num_refs,
+					const uint8_t weight_gapO,
+					const uint8_t weight_gapE,
+					uint16_t* scores);
+
+/*!	@enum	instruction sets of the Smith-Waterman kernels, from the narrowest to the widest */
+enum { SSW_SSE2 = 0, SSW_AVX2 = 1, SSW_AVX512 = 2 };
+
+/*!	@function	Find the widest kernels supported by the CPU (CPUID).
+	@return	SSW_SSE2 | SSW_AVX2 | SSW_AVX512
+*/
+int ssw_simd_supported (void);
+
+/*!	@function	Select the kernels used by the profiles created from now on with ssw_init. For the gap penalties
+				the options accept (0 <= gap extension <= gap open) the results of all the kernels are identical,
+				only the speed differs.
+	@param	simd	SSW_SSE2 | SSW_AVX2 | SSW_AVX512; -1 or an instruction set not supported by the CPU selects
+					the widest supported. Not thread safe: call before the alignment threads are started.
+*/
+void ssw_simd_select (int simd);
+
+/*!	@function	The kernels used by ssw_init.
+	@return	SSW_SSE2 | SSW_AVX2 | SSW_AVX512
+*/
+int ssw_simd_selected (void);
+
 /*!	@function	Release the memory allocated by function ssw_align.
 	@param	a	pointer to the alignment result structure
 */
@@ -36,6 +36,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h> // abs
 #include <vector>
 #include <iterator>
 
@@ -51,9 +52,15 @@ typedef struct s_align2 {
 	uint16_t part;
 	uint16_t index_num;
 	bool strand; // flags whether this alignment was done on a forward (true) or reverse-complement (false) read.
+	// counts of mismatches, gaps, and matches. Calculated when the alignment is found, so that the
+	// post-processing does not need the reference sequence. See 'Read::calc_miss_gap_match'
+	uint32_t n_miss;
+	uint32_t n_gap;
+	uint32_t n_match;
 
 	// default construct
-	s_align2() : ref_num(0), ref_begin1(0), ref_end1(0), read_begin1(0), read_end1(0), readlen(0), score1(0), part(0), index_num(0), strand(false) {}
+	s_align2() : ref_num(0), ref_begin1(0), ref_end1(0), read_begin1(0), read_end1(0), readlen(0), score1(0), part(0), index_num(0), strand(false),
+		n_miss(0), n_gap(0), n_match(0) {}
 
 	// construct from binary string
 	s_align2(std::string bstr)
@@ -98,8 +105,20 @@ typedef struct s_align2 {
 		// strand
 		std::memcpy(static_cast<void*>(&strand), bstr.data() + offset, sizeof(strand));
 		offset += sizeof(strand);
+		// n_miss, n_gap, n_match
+		std::memcpy(static_cast<void*>(&n_miss), bstr.data() + offset, sizeof(n_miss));
+		offset += sizeof(n_miss);
+		std::memcpy(static_cast<void*>(&n_gap), bstr.data() + offset, sizeof(n_gap));
+		offset += sizeof(n_gap);
+		std::memcpy(static_cast<void*>(&n_match), bstr.data() + offset, sizeof(n_match));
+		offset += sizeof(n_match);
 	}
 
+	// identity e.g. 0.98
+	double id() const { return n_miss + n_gap + n_match == 0 ? 0 : (double)n_match / (n_miss + n_gap + n_match); }
+	// query coverage e.g. 0.86
+	double cov() const { return (double)abs(read_end1 - read_begin1 + 1) / readlen; }
+
 	// convert to binary string
 	std::string toString()
 	{
@@ -133,6 +152,13 @@ typedef struct s_align2 {
 		// strand
 		beginIt = static_cast<char*>(static_cast<void*>(&strand));
 		std::copy_n(beginIt, sizeof(strand), std::back_inserter(buf));
+		// n_miss, n_gap, n_match
+		beginIt = static_cast<char*>(static_cast<void*>(&n_miss));
+		std::copy_n(beginIt, sizeof(n_miss), std::back_inserter(buf));
+		beginIt = static_cast<char*>(static_cast<void*>(&n_gap));
+		std::copy_n(beginIt, sizeof(n_gap), std::back_inserter(buf));
+		beginIt = static_cast<char*>(static_cast<void*>(&n_match));
+		std::copy_n(beginIt, sizeof(n_match), std::back_inserter(buf));
 
 		return buf;
 	} // ~toString
@@ -149,7 +175,10 @@ typedef struct s_align2 {
 			+ sizeof(score1)
 			+ sizeof(part)
 			+ sizeof(index_num)
-			+ sizeof(strand);
+			+ sizeof(strand)
+			+ sizeof(n_miss)
+			+ sizeof(n_gap)
+			+ sizeof(n_match);
 	}
 
 	bool operator==(const s_align2& other)
@@ -164,6 +193,9 @@ typedef struct s_align2 {
 			other.score1 == score1 &&
 			other.part == part &&
 			other.index_num == index_num &&
-			other.strand == strand;
+			other.strand == strand &&
+			other.n_miss == n_miss &&
+			other.n_gap == n_gap &&
+			other.n_match == n_match;
 	}
 } s_align2;
\ No newline at end of file
@@ -0,0 +1,509 @@
+/*
+ *  ssw_kernel.h
+ *
+ *  Striped Smith-Waterman kernels (query profile, byte and word alignment) written once
+ *  for any SIMD register width. Included by ssw.c once per instruction set (SSE2, AVX2, AVX-512).
+ *
+ *  The kernels follow the original SSW library, except for the vertical gaps (F) that cross
+ *  the segments of the striped query. The Lazy_F loop of SSW advanced them by a single query
+ *  position per iteration whatever the register width, which took most of the alignment time,
+ *  and could stop before the column was complete when the gap open penalty is small, making the
+ *  results depend on the number of lanes. Here the F leaving each segment is carried into all the
+ *  following segments with a prefix scan over the lanes (log2 of the number of lanes steps), and
+ *  applied to the column in a single pass. The columns are exact, so all the kernels give the same
+ *  scores and alignment positions.
+ *
+ *  The including file defines (undefined at the end of this file):
+ *    SSW_SUFFIX      suffix of the function names e.g. _avx2
+ *    SSW_TARGET      function attribute enabling the instruction set (may be empty)
+ *    SSW_VEC         vector type
+ *    SSW_BYTES       vector width in bytes
+ *    v_zero()  v_set1_epi8(x)  v_set1_epi16(x)  v_load(p)  v_store(p, v)
+ *    v_adds_epu8  v_subs_epu8  v_max_epu8  v_adds_epi16  v_subs_epu16  v_max_epi16
+ *    v_slli(v, n)        shift the whole vector left by n bytes
+ *    v_hmax_epu8(v)      max of the unsigned bytes
+ *    v_hmax_epi16(v)     max of the signed words
+ *    v_all_eq(a, b)      true if a == b
+ *    v_any_gt_epi16(a, b) true if any signed word of a is greater than the one of b
+ *    v_carry_epu8(v, d)  prefix max over the byte lanes, decreased by d (saturated) per lane:
+ *                        lane k = max over m <= k of (v[m] - (k - m) * d)
+ *    v_carry_epu16(v, d) same on the word lanes
+ *  and 'ssw_calloc_aligned' / 'ssw_free_aligned' for the vector buffers.
+ */
+
+#define SSW_CAT_(a, b) a##b
+#define SSW_CAT(a, b) SSW_CAT_(a, b)
+#define SSW_FN(f) SSW_CAT(f, SSW_SUFFIX)
+
+/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch. */
+static SSW_TARGET SSW_VEC* SSW_FN(qP_byte)(const int8_t* read_num,
+	const int8_t* mat,
+	const int32_t readLen,
+	const int32_t n,	/* the edge length of the square matrix mat */
+	uint8_t bias) {
+
+	int32_t segLen = (readLen + SSW_BYTES - 1) / SSW_BYTES; /* number of segments, one byte lane per segment */
+	SSW_VEC* vProfile = (SSW_VEC*)ssw_calloc_aligned(n * segLen, sizeof(SSW_VEC));
+	int8_t* t = (int8_t*)vProfile;
+	int32_t nt, i, j, segNum;
+
+	for (nt = 0; LIKELY(nt < n); nt++) {
+		for (i = 0; i < segLen; i++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < SSW_BYTES); segNum++) {
+				*t++ = j >= readLen ? bias : mat[nt * n + read_num[j]] + bias;
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+/* Striped Smith-Waterman
+   Record the highest score of each reference position.
+   Return the alignment score and ending position of the best alignment, 2nd best alignment, etc.
+   Gap begin and gap extension are different.
+   wight_match > 0, all other weights < 0.
+   The returned positions are 0-based.
+ */
+static SSW_TARGET alignment_end* SSW_FN(sw_byte)(const int8_t* ref,
+	int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+	int32_t refLen,
+	int32_t readLen,
+	const uint8_t weight_gapO, /* will be used as - */
+	const uint8_t weight_gapE, /* will be used as - */
+	SSW_VEC* vProfile,
+	uint8_t terminate,
+	uint8_t bias,
+	int32_t maskLen) {
+
+	uint8_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
+	int32_t segLen = (readLen + SSW_BYTES - 1) / SSW_BYTES; /* number of segment */
+
+	/* array to record the largest score of each reference position */
+	uint8_t* maxColumn = (uint8_t*)calloc(refLen, 1);
+
+	SSW_VEC vZero = v_zero();
+
+	SSW_VEC* pvHStore = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+	SSW_VEC* pvHLoad = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+	SSW_VEC* pvE = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+	SSW_VEC* pvHmax = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+
+	int32_t i, j;
+	SSW_VEC vGapO = v_set1_epi8(weight_gapO);
+	SSW_VEC vGapE = v_set1_epi8(weight_gapE);
+	SSW_VEC vBias = v_set1_epi8(bias);
+	/* F decrease along a segment, saturated */
+	SSW_VEC vSegGapE = v_set1_epi8((int8_t)(segLen * weight_gapE < 0xff ? segLen * weight_gapE : 0xff));
+
+	SSW_VEC vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	SSW_VEC vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	SSW_VEC vTemp;
+	int32_t edge, begin = 0, end = refLen, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		SSW_VEC e = vZero, vF = vZero, vMaxColumn = vZero;
+
+		SSW_VEC vH = pvHStore[segLen - 1];
+		vH = v_slli(vH, 1);
+		SSW_VEC* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
+
+		/* Swap the 2 H buffers. */
+		SSW_VEC* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = v_adds_epu8(vH, v_load(vP + j));
+			vH = v_subs_epu8(vH, vBias); /* vH will be always > 0 */
+
+			/* Get max from vH, vE and vF. */
+			e = v_load(pvE + j);
+			vH = v_max_epu8(vH, e);
+			vH = v_max_epu8(vH, vF);
+			vMaxColumn = v_max_epu8(vMaxColumn, vH);
+
+			/* Save vH values. */
+			v_store(pvHStore + j, vH);
+
+			/* Update vE value. */
+			vH = v_subs_epu8(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = v_subs_epu8(e, vGapE);
+			e = v_max_epu8(e, vH);
+			v_store(pvE + j, e);
+
+			/* Update vF value. */
+			vF = v_subs_epu8(vF, vGapE);
+			vF = v_max_epu8(vF, vH);
+
+			/* Load the next vH. */
+			vH = v_load(pvHLoad + j);
+		}
+
+		/* Vertical gaps crossing the segments: the F leaving each segment is carried into all the following
+		   segments, and applied in a single pass. E(i, j) is not updated, as in the Lazy_F loop of SSW */
+		vF = v_carry_epu8(v_slli(vF, 1), vSegGapE);
+		for (j = 0; LIKELY(j < segLen); ++j)
+		{
+			vH = v_load(pvHStore + j);
+			vTemp = v_subs_epu8(vH, vGapO);
+			vTemp = v_subs_epu8(vF, vTemp);
+			if (v_all_eq(vTemp, vZero)) break; /* F cannot raise H any more in this column */
+			vH = v_max_epu8(vH, vF);
+			vMaxColumn = v_max_epu8(vMaxColumn, vH);
+			v_store(pvHStore + j, vH);
+			vF = v_subs_epu8(vF, vGapE);
+		}
+
+		vMaxScore = v_max_epu8(vMaxScore, vMaxColumn);
+		if (!v_all_eq(vMaxMark, vMaxScore)) {
+			uint8_t temp;
+			vMaxMark = vMaxScore;
+			temp = v_hmax_epu8(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				if (max + bias >= 255) break; //overflow
+
+				end_ref = i;
+
+				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		/* Record the max score of current column. */
+		maxColumn[i] = v_hmax_epu8(vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint8_t *t = (uint8_t*)pvHmax;
+	int32_t column_len = segLen * SSW_BYTES;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SSW_BYTES + i % SSW_BYTES * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	ssw_free_aligned(pvHmax);
+	ssw_free_aligned(pvE);
+	ssw_free_aligned(pvHLoad);
+	ssw_free_aligned(pvHStore);
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_end* bests = (alignment_end*)calloc(2, sizeof(alignment_end));
+	bests[0].score = max + bias >= 255 ? 255 : max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+
+	bests[1].score = 0;
+	bests[1].ref = 0;
+	bests[1].read = 0;
+
+	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+	for (i = 0; i < edge; i++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+	edge = (end_ref + maskLen) > refLen ? refLen : (end_ref + maskLen);
+	for (i = edge + 1; i < refLen; i++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+
+	free(maxColumn);
+	return bests;
+}
+
+static SSW_TARGET SSW_VEC* SSW_FN(qP_word)(const int8_t* read_num,
+	const int8_t* mat,
+	const int32_t readLen,
+	const int32_t n) {
+
+	int32_t segLen = (readLen + SSW_BYTES / 2 - 1) / (SSW_BYTES / 2);
+	SSW_VEC* vProfile = (SSW_VEC*)ssw_calloc_aligned(n * segLen, sizeof(SSW_VEC));
+	int16_t* t = (int16_t*)vProfile;
+	int32_t nt, i, j;
+	int32_t segNum;
+
+	for (nt = 0; LIKELY(nt < n); nt++) {
+		for (i = 0; i < segLen; i++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < SSW_BYTES / 2); segNum++) {
+				*t++ = j >= readLen ? 0 : mat[nt * n + read_num[j]];
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+/* Striped Smith-Waterman on 16 bit lanes, for the alignments scoring over 255. See sw_byte */
+static SSW_TARGET alignment_end* SSW_FN(sw_word)(const int8_t* ref,
+	int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+	int32_t refLen,
+	int32_t readLen,
+	const uint8_t weight_gapO, /* will be used as - */
+	const uint8_t weight_gapE, /* will be used as - */
+	SSW_VEC* vProfile,
+	uint16_t terminate,
+	int32_t maskLen) {
+
+	uint16_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
+	int32_t segLen = (readLen + SSW_BYTES / 2 - 1) / (SSW_BYTES / 2); /* number of segment */
+
+	/* array to record the largest score of each reference position */
+	uint16_t* maxColumn = (uint16_t*)calloc(refLen, 2);
+
+	SSW_VEC vZero = v_zero();
+
+	SSW_VEC* pvHStore = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+	SSW_VEC* pvHLoad = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+	SSW_VEC* pvE = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+	SSW_VEC* pvHmax = (SSW_VEC*)ssw_calloc_aligned(segLen, sizeof(SSW_VEC));
+
+	int32_t i, j;
+	SSW_VEC vGapO = v_set1_epi16(weight_gapO);
+	SSW_VEC vGapE = v_set1_epi16(weight_gapE);
+	/* F decrease along a segment, saturated */
+	SSW_VEC vSegGapE = v_set1_epi16((int16_t)(segLen * weight_gapE < 0xffff ? segLen * weight_gapE : 0xffff));
+
+	SSW_VEC vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	SSW_VEC vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	int32_t edge, begin = 0, end = refLen, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		SSW_VEC e = vZero, vF = vZero;
+		SSW_VEC vH = pvHStore[segLen - 1];
+		vH = v_slli(vH, 2);
+
+		/* Swap the 2 H buffers. */
+		SSW_VEC* pv = pvHLoad;
+
+		SSW_VEC vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
+
+		SSW_VEC* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		for (j = 0; LIKELY(j < segLen); j++) {
+			vH = v_adds_epi16(vH, v_load(vP + j));
+
+			/* Get max from vH, vE and vF. */
+			e = v_load(pvE + j);
+			vH = v_max_epi16(vH, e);
+			vH = v_max_epi16(vH, vF);
+			vMaxColumn = v_max_epi16(vMaxColumn, vH);
+
+			/* Save vH values. */
+			v_store(pvHStore + j, vH);
+
+			/* Update vE value. */
+			vH = v_subs_epu16(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = v_subs_epu16(e, vGapE);
+			e = v_max_epi16(e, vH);
+			v_store(pvE + j, e);
+
+			/* Update vF value. */
+			vF = v_subs_epu16(vF, vGapE);
+			vF = v_max_epi16(vF, vH);
+
+			/* Load the next vH. */
+			vH = v_load(pvHLoad + j);
+		}
+
+		/* Vertical gaps crossing the segments, see sw_byte */
+		vF = v_carry_epu16(v_slli(vF, 2), vSegGapE);
+		for (j = 0; LIKELY(j < segLen); ++j)
+		{
+			vH = v_load(pvHStore + j);
+			if (!v_any_gt_epi16(vF, v_subs_epu16(vH, vGapO))) break; /* F cannot raise H any more in this column */
+			vH = v_max_epi16(vH, vF);
+			vMaxColumn = v_max_epi16(vMaxColumn, vH);
+			v_store(pvHStore + j, vH);
+			vF = v_subs_epu16(vF, vGapE);
+		}
+
+		vMaxScore = v_max_epi16(vMaxScore, vMaxColumn);
+		if (!v_all_eq(vMaxMark, vMaxScore)) {
+			uint16_t temp;
+			vMaxMark = vMaxScore;
+			temp = v_hmax_epi16(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				end_ref = i;
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		/* Record the max score of current column. */
+		maxColumn[i] = v_hmax_epi16(vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint16_t *t = (uint16_t*)pvHmax;
+	int32_t column_len = segLen * (SSW_BYTES / 2);
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / (SSW_BYTES / 2) + i % (SSW_BYTES / 2) * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	ssw_free_aligned(pvHmax);
+	ssw_free_aligned(pvE);
+	ssw_free_aligned(pvHLoad);
+	ssw_free_aligned(pvHStore);
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_end* bests = (alignment_end*)calloc(2, sizeof(alignment_end));
+	bests[0].score = max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+
+	bests[1].score = 0;
+	bests[1].ref = 0;
+	bests[1].read = 0;
+
+	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+	for (i = 0; i < edge; i++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+	edge = (end_ref + maskLen) > refLen ? refLen : (end_ref + maskLen);
+	for (i = edge; i < refLen; i++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+
+	free(maxColumn);
+	return bests;
+}
+
+/*
+ * Score only alignment of one query against many references, one reference per word lane
+ * (inter-sequence): each lane runs the plain Gotoh recursion along its own reference, so there
+ * are no gaps crossing the lanes and no query profile. The scores are the same as score1 of
+ * the striped kernels. The substitution scores of the current column, one vector per query
+ * residue, are gathered from the references before the column is run.
+ *
+ * 'num' <= SSW_BYTES / 2 references; the lanes past 'num' and the columns past the end of a
+ * reference score SHRT_MIN on the diagonal so they never raise the maximum.
+ */
+static SSW_TARGET void SSW_FN(sw_batch)(const int8_t* read,
+	int32_t readLen,
+	const int8_t* mat,
+	int32_t n,
+	const int8_t** refs,
+	const int32_t* refLens,
+	int32_t num,
+	const uint8_t weight_gapO,
+	const uint8_t weight_gapE,
+	uint16_t* scores) {
+
+	int32_t i, j, k, maxLen = 0;
+	SSW_VEC vZero = v_zero();
+	SSW_VEC vGapO = v_set1_epi16(weight_gapO);
+	SSW_VEC vGapE = v_set1_epi16(weight_gapE);
+	SSW_VEC vMaxScore = vZero;
+	SSW_VEC* pvH = (SSW_VEC*)ssw_calloc_aligned(readLen + 1, sizeof(SSW_VEC)); /* H of the previous column, pvH[0] = 0 */
+	SSW_VEC* pvE = (SSW_VEC*)ssw_calloc_aligned(readLen, sizeof(SSW_VEC));
+	SSW_VEC* pvS = (SSW_VEC*)ssw_calloc_aligned(n, sizeof(SSW_VEC)); /* substitution scores of the column per query residue */
+	int16_t* s = (int16_t*)pvS;
+
+	for (k = 0; k < num; ++k) if (refLens[k] > maxLen) maxLen = refLens[k];
+
+	for (j = 0; LIKELY(j < maxLen); ++j) {
+		SSW_VEC vF = vZero, vDiag = vZero, vH;
+		for (k = 0; k < SSW_BYTES / 2; ++k) {
+			int32_t nt;
+			if (k < num && j < refLens[k])
+				for (nt = 0; nt < n; ++nt) s[nt * (SSW_BYTES / 2) + k] = mat[nt * n + refs[k][j]];
+			else
+				for (nt = 0; nt < n; ++nt) s[nt * (SSW_BYTES / 2) + k] = SHRT_MIN;
+		}
+
+		for (i = 0; LIKELY(i < readLen); ++i) {
+			SSW_VEC e = v_load(pvE + i);
+			vH = v_adds_epi16(vDiag, v_load(pvS + read[i]));
+			vDiag = v_load(pvH + i + 1);
+			vH = v_max_epi16(vH, e);
+			vH = v_max_epi16(vH, vF);
+			vH = v_max_epi16(vH, vZero);
+			vMaxScore = v_max_epi16(vMaxScore, vH);
+			v_store(pvH + i + 1, vH);
+
+			/* gap in the query (E, along the reference) and in the reference (F, along the query) */
+			vH = v_subs_epu16(vH, vGapO);
+			v_store(pvE + i, v_max_epi16(v_subs_epu16(e, vGapE), vH));
+			vF = v_max_epi16(v_subs_epu16(vF, vGapE), vH);
+		}
+	}
+
+	v_store(pvS, vMaxScore);
+	for (k = 0; k < num; ++k) scores[k] = ((uint16_t*)pvS)[k];
+
+	ssw_free_aligned(pvS);
+	ssw_free_aligned(pvE);
+	ssw_free_aligned(pvH);
+}
+
+#undef SSW_FN
+#undef SSW_CAT
+#undef SSW_CAT_
+
+#undef SSW_SUFFIX
+#undef SSW_TARGET
+#undef SSW_VEC
+#undef SSW_BYTES
+#undef v_zero
+#undef v_set1_epi8
+#undef v_set1_epi16
+#undef v_load
+#undef v_store
+#undef v_adds_epu8
+#undef v_subs_epu8
+#undef v_max_epu8
+#undef v_adds_epi16
+#undef v_subs_epu16
+#undef v_max_epi16
+#undef v_slli
+#undef v_hmax_epu8
+#undef v_hmax_epi16
+#undef v_all_eq
+#undef v_any_gt_epi16
+#undef v_carry_epu8
+#undef v_carry_epu16
@@ -0,0 +1,148 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/**
+ * FILE: alignidx.cpp
+ * Created: Oct 16, 2026 Fri
+ */
+
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+
+#include "alignidx.hpp"
+#include "read.hpp"
+#include "common.hpp"
+
+Alignidx::Alignidx(const std::filesystem::path& dir, unsigned num_threads) : dir(dir), vkeys(num_threads) {}
+
+/*
+ * the read file index in the high 24 bits, the read number in the low 40 bits
+ */
+uint64_t Alignidx::key(const Read& read)
+{
+	return ((uint64_t)read.readfile_idx << 40) | read.read_num;
+}
+
+std::filesystem::path Alignidx::get_path(uint16_t idx_num, uint16_t part)
+{
+	return dir / ("alnidx_" + std::to_string(idx_num) + "_" + std::to_string(part) + ".dat");
+}
+
+void Alignidx::add(unsigned id, const Read& read, uint16_t idx_num, uint16_t part)
+{
+	vkeys[id][((uint32_t)idx_num << 16) | part].push_back(key(read));
+}
+
+void Alignidx::add(unsigned id, const Read& read)
+{
+	for (auto const& align : read.alignment.alignv) {
+		auto& keyv = vkeys[id][((uint32_t)align.index_num << 16) | align.part];
+		// skip the repeats of the key. The remaining duplicates are removed in 'write'
+		if (keyv.empty() || keyv.back() != key(read))
+			keyv.push_back(key(read));
+	}
+}
+
+void Alignidx::write(uint16_t idx_num, uint16_t part)
+{
+	std::vector<uint64_t> keyv;
+	uint32_t pid = ((uint32_t)idx_num << 16) | part;
+	for (auto& thread_keys : vkeys) {
+		auto it = thread_keys.find(pid);
+		if (it != thread_keys.end()) {
+			keyv.insert(keyv.end(), it->second.begin(), it->second.end());
+			thread_keys.erase(it);
+		}
+	}
+	// keep the reads of the index file left by an interrupted run. Those reads are skipped as already processed
+	auto path = get_path(idx_num, part);
+	if (std::filesystem::exists(path)) {
+		std::ifstream ifs(path, std::ios_base::in | std::ios_base::binary);
+		auto num_keys = keyv.size();
+		keyv.resize(num_keys + std::filesystem::file_size(path) / sizeof(uint64_t));
+		ifs.read(reinterpret_cast<char*>(keyv.data() + num_keys), (keyv.size() - num_keys) * sizeof(uint64_t));
+	}
+	std::sort(keyv.begin(), keyv.end());
+	keyv.erase(std::unique(keyv.begin(), keyv.end()), keyv.end());
+
+	std::ofstream ofs(path, std::ios_base::out | std::ios_base::binary);
+	if (!ofs.is_open()) {
+		ERR("failed to open for writing: ", path);
+		exit(EXIT_FAILURE);
+	}
+	ofs.write(reinterpret_cast<const char*>(keyv.data()), keyv.size() * sizeof(uint64_t));
+	INFO("Alignment index: ", path.filename(), " reads: ", keyv.size());
+} // ~Alignidx::write
+
+bool Alignidx::load(uint16_t idx_num, uint16_t part)
+{
+	keys.clear();
+	auto path = get_path(idx_num, part);
+	std::ifstream ifs(path, std::ios_base::in | std::ios_base::binary);
+	if (!ifs.is_open()) {
+		WARN("No alignment index: ", path, " All the reads are checked for the alignments on the part");
+		return false;
+	}
+	keys.resize(std::filesystem::file_size(path) / sizeof(uint64_t));
+	ifs.read(reinterpret_cast<char*>(keys.data()), keys.size() * sizeof(uint64_t));
+	return true;
+} // ~Alignidx::load
+
+void Alignidx::filter(std::vector<Read>& reads, bool is_paired) const
+{
+	std::size_t num_reads = is_paired ? 2 : 1;
+	std::size_t inew = 0;
+	for (std::size_t i = 0; i + num_reads <= reads.size(); i += num_reads) {
+		bool is_aligned = false;
+		for (std::size_t j = i; j < i + num_reads && !is_aligned; ++j)
+			is_aligned = std::binary_search(keys.begin(), keys.end(), key(reads[j]));
+		if (!is_aligned) continue;
+		for (std::size_t j = i; j < i + num_reads; ++j, ++inew) {
+			if (inew != j) reads[inew] = std::move(reads[j]);
+		}
+	}
+	reads.resize(inew);
+} // ~Alignidx::filter
+
+std::vector<uint64_t> Alignidx::get_reads(std::size_t readfile_idx, unsigned num_files) const
+{
+	std::vector<uint64_t> read_nums;
+	const uint64_t mask = (1ULL << 40) - 1;
+	for (std::size_t i = readfile_idx; i < readfile_idx + num_files; ++i) {
+		auto first = std::lower_bound(keys.begin(), keys.end(), (uint64_t)i << 40);
+		auto last = std::lower_bound(first, keys.end(), (uint64_t)(i + 1) << 40);
+		auto num_prev = read_nums.size();
+		std::transform(first, last, std::back_inserter(read_nums), [mask](uint64_t key) { return key & mask; });
+		std::inplace_merge(read_nums.begin(), read_nums.begin() + num_prev, read_nums.end());
+	}
+	read_nums.erase(std::unique(read_nums.begin(), read_nums.end()), read_nums.end());
+	return read_nums;
+} // ~Alignidx::get_reads
@@ -95,6 +95,314 @@ void find_lis( deque<pair<uint32_t, uint32_t>>& a, vector<uint32_t>& b )
 		b[u] = static_cast<uint32_t>(v);
 } // ~find_lis
 
+void RefHitCounter::clear()
+{
+	for (auto i : slots)
+	{
+		keys[i] = EMPTY;
+		hits[i] = 0;
+	}
+	slots.clear();
+	counts.clear();
+} // ~RefHitCounter::clear
+
+void RefHitCounter::resize(uint32_t new_bits)
+{
+	std::vector<uint32pair> used;
+	used.reserve(slots.size());
+	for (auto i : slots)
+		used.push_back(uint32pair(keys[i], hits[i]));
+	bits = new_bits;
+	keys.assign(size_t(1) << bits, EMPTY);
+	hits.assign(size_t(1) << bits, 0);
+	slots.clear();
+	for (auto const& ref_hits : used)
+	{
+		add(ref_hits.first);
+		hits[slots.back()] = ref_hits.second;
+	}
+} // ~RefHitCounter::resize
+
+void RefHitCounter::count(uint32_t min_hits)
+{
+	for (auto i : slots)
+	{
+		if (hits[i] >= min_hits)
+			counts.push_back(uint32pair(keys[i], hits[i]));
+	}
+
+	// sort sequences by frequency in descending order
+	std::sort(counts.begin(), counts.end(), [](const uint32pair& e1, const uint32pair& e2) {
+		if (e1.second == e2.second)
+			return e1.first ASCENDING e2.first; // order references ascending for equal frequencies (originally - descending)
+		return e1.second DESCENDING e2.second; // order frequencies descending
+	});
+} // ~RefHitCounter::count
+
+void QueryProfileCache::clear()
+{
+	for (auto& e : entries)
+		init_destroy(&e.profile);
+	entries.clear();
+} // ~QueryProfileCache::clear
+
+const s_profile* QueryProfileCache::get(const Read& read, size_t que_start, size_t que_len)
+{
+	return get(read.id, (const int8_t*)(&read.isequence[0] + que_start), que_len, read.scoring_matrix);
+} // ~QueryProfileCache::get
+
+const s_profile* QueryProfileCache::get(const string& id, const int8_t* query, size_t que_len, const vector<int8_t>& matrix)
+{
+	if (id != read_id)
+	{
+		clear();
+		read_id = id;
+	}
+
+	for (auto const& e : entries)
+	{
+		if (e.query.size() == que_len && e.matrix == matrix
+			&& std::equal(e.query.begin(), e.query.end(), query))
+			return e.profile;
+	}
+
+	// the vectors' buffers are kept when 'entries' grows, so the profiles can point to them
+	entries.push_back({ vector<int8_t>(query, query + que_len), matrix, 0 });
+	auto& e = entries.back();
+	e.profile = ssw_init(&e.query[0], (int32_t)que_len, &e.matrix[0], 5, 2);
+	return e.profile;
+} // ~QueryProfileCache::get
+
+/*
+ * the slice of the reference and of the read to align around a LIS starting at 'lcs_ref_start' on the
+ * reference and 'lcs_que_start' on the read. The reference slice includes up to 'edges' positions
+ * ('head' and 'tail') on each side of the read.
+ */
+static void align_window(uint32_t lcs_ref_start, uint32_t lcs_que_start, std::size_t reflen, std::size_t readlen, uint32_t edges,
+	std::size_t& head, std::size_t& tail, std::size_t& align_ref_start, std::size_t& align_que_start, std::size_t& align_length)
+{
+	head = 0;
+	tail = 0;
+	// part of the read hangs off (or matches exactly) the beginning of the reference seq
+	//            ref |-----------------------------------|
+	// que |-------------------|
+	//             LIS |-----|
+	//
+	if (lcs_ref_start < lcs_que_start)
+	{
+		align_ref_start = 0;
+		align_que_start = lcs_que_start - lcs_ref_start;
+		head = 0;
+		// the read is longer than the reference sequence
+		//            ref |----------------|
+		// que |---------------------...|
+		//                LIS |-----|
+		//
+		if (reflen < readlen)
+		{
+			tail = 0;
+			// beginning from align_ref_start = 0 and align_que_start = X, the read finishes
+			// before the end of the reference
+			//            ref |----------------|
+			// que |------------------------|
+			//                  LIS |-----|
+			//                ^
+			//                align_que_start
+			if (align_que_start >(readlen - reflen))
+			{
+				align_length = reflen - (align_que_start - (readlen - reflen));
+			}
+			// beginning from align_ref_start = 0 and align_que_start = X, the read finishes
+			// after the end of the reference
+			//            ref |----------------|
+			// que |------------------------------|
+			//                  LIS |-----|
+			//                ^
+			//                align_que_start
+			else
+			{
+				align_length = reflen;
+			}
+		}
+		else
+		{
+			tail = reflen - align_ref_start - readlen;
+			tail > (edges - 1) ? tail = edges : tail;
+			align_length = readlen + head + tail - align_que_start;
+		}
+	}
+	else
+	{
+		align_ref_start = lcs_ref_start - lcs_que_start;
+		align_que_start = 0;
+		align_ref_start > (edges - 1) ? head = edges : head;
+		// part of the read hangs off the end of the reference seq
+		// ref |-----------------------------------|
+		//                          que |-------------------|
+		//                            LIS |-----|
+		//
+		if (align_ref_start + readlen > reflen) // readlen
+		{
+			tail = 0;
+			align_length = reflen - align_ref_start - head;
+		}
+		// the reference seq fully covers the read
+		// ref |-----------------------------------|
+		//    que |-------------------|
+		//          LIS |-----|
+		//
+		else
+		{
+			tail = reflen - align_ref_start - readlen;
+			tail > (edges - 1) ? tail = edges : tail;
+			align_length = readlen + head + tail;
+		}
+	}
+} // ~align_window
+
+void CandidateBatch::fill(uint32_t k, uint32_t max_num, Read& read, Runopts& opts, Index& index, References& refs, Refstats& refstats,
+	const vector<uint32pair>& candidates, QueryProfileCache& profiles)
+{
+	static const uint32_t lanes[] = { 8, 16, 32 }; // 16 bit lanes of the SSE2, AVX2, AVX-512 kernels
+	// a batch takes about as long with a single lane used as with all the lanes: score ahead only
+	// when the search is expected to try a full batch, otherwise take the candidate alone
+	auto num_lanes = lanes[ssw_simd_selected()];
+	begin = k;
+	end = std::min((uint32_t)candidates.size(), k + (max_num < num_lanes ? 1 : num_lanes));
+	auto num = end - begin;
+
+	if (hits.size() < num) hits.resize(num);
+	jobs.assign(num, job());
+	refs_idx.clear();
+	for (uint32_t i = 0; i < num; ++i)
+	{
+		hits[i].clear();
+		refs_idx.push_back(uint32pair(candidates[begin + i].first, i));
+	}
+	std::sort(refs_idx.begin(), refs_idx.end());
+
+	// k-mer hits on the candidates of the batch
+	for (auto const& hit : read.id_win_hits)
+	{
+		for (seq_pos* positions_tbl_ptr = index.positions_tbl.begin(hit.id), *pend = index.positions_tbl.end(hit.id);
+			positions_tbl_ptr != pend; ++positions_tbl_ptr)
+		{
+			auto it = std::lower_bound(refs_idx.begin(), refs_idx.end(), uint32pair(positions_tbl_ptr->seq, 0));
+			if (it != refs_idx.end() && it->first == positions_tbl_ptr->seq)
+				hits[it->second].push_back(uint32pair(positions_tbl_ptr->pos, hit.win));
+		}
+	}
+
+	uint32_t edges = 0;
+	if (opts.is_as_percent)
+		edges = static_cast<decltype(edges)>((opts.edges / 100.0) * read.sequence.length());
+	else
+		edges = static_cast<decltype(edges)>(opts.edges);
+
+	// first window of each candidate, same as the first iteration of the sliding window in 'compute_lis_alignment'
+	deque<uint32pair> match_set;
+	vector<uint32_t> lis_arr;
+	for (uint32_t i = 0; i < num; ++i)
+	{
+		// sort the positions in ascending order
+		std::sort(hits[i].begin(), hits[i].end(), [](uint32pair e1, uint32pair e2) {
+			if (e1.first == e2.first)
+				return (e1.second ASCENDING e2.second); // order references ascending for equal reference positions
+			return (e1.first ASCENDING e2.first);
+		}); // smallest
+
+		if (hits[i].empty()) continue;
+		uint32_t begin_ref = hits[i][0].first;
+		uint32_t begin_read = hits[i][0].second;
+		auto end_ref_max = begin_ref + read.sequence.length() - begin_read - refstats.lnwin[index.index_num] + 1;
+		match_set.clear();
+		for (auto const& hit : hits[i])
+		{
+			if (hit.first > end_ref_max) break;
+			match_set.push_back(hit);
+		}
+		if (match_set.size() < (uint32_t)opts.num_seeds) continue;
+
+		lis_arr.clear();
+		find_lis(match_set, lis_arr);
+		if (lis_arr.size() < (size_t)opts.min_lis) continue;
+
+		auto& j = jobs[i];
+		j.is_valid = true;
+		align_window(match_set[lis_arr[0]].first, match_set[lis_arr[0]].second, refs.buffer[candidates[begin + i].first].sequence.length(),
+			read.sequence.length(), edges, j.head, j.tail, j.align_ref_start, j.align_que_start, j.align_length);
+	}
+
+	// the read in 04 encoding, without changing the read (flipped only when it is aligned)
+	query.assign(read.isequence.begin(), read.isequence.end());
+	if (read.is03)
+	{
+		for (auto pos : read.ambiguous_nt)
+			query[read.reversed ? query.size() - pos - 1 : pos] = 4;
+	}
+
+	// score the jobs aligning the same slice of the read together
+	for (uint32_t i = 0; i < num; ++i)
+	{
+		if (!jobs[i].is_valid || jobs[i].is_scored) continue;
+		auto que_start = jobs[i].align_que_start;
+		auto que_len = jobs[i].align_length - jobs[i].head - jobs[i].tail;
+		if (que_len == 0 || que_start + que_len > query.size()) continue;
+		batch_jobs.clear();
+		for (uint32_t m = i; m < num; ++m)
+		{
+			auto const& j = jobs[m];
+			if (j.is_valid && !j.is_scored && j.align_que_start == que_start && j.align_length - j.head - j.tail == que_len)
+				batch_jobs.push_back(m);
+		}
+		if (batch_jobs.size() < 2) continue; // a single alignment is cheaper with the striped kernels
+
+		batch_refs.clear();
+		batch_lens.clear();
+		for (auto m : batch_jobs)
+		{
+			auto const& j = jobs[m];
+			batch_refs.push_back((const int8_t*)refs.buffer[candidates[begin + m].first].sequence.data() + j.align_ref_start - j.head);
+			batch_lens.push_back((int32_t)j.align_length);
+		}
+		batch_scores.resize(batch_jobs.size());
+		const s_profile* profile = profiles.get(read.id, &query[que_start], que_len, read.scoring_matrix);
+		ssw_score_batch(profile, &batch_refs[0], &batch_lens[0], (int32_t)batch_refs.size(), opts.gap_open, opts.gap_extension, &batch_scores[0]);
+		for (size_t m = 0; m < batch_jobs.size(); ++m)
+		{
+			jobs[batch_jobs[m]].is_scored = true;
+			jobs[batch_jobs[m]].score = batch_scores[m];
+		}
+	}
+} // ~CandidateBatch::fill
+
+/*
+ * number of the candidates from 'k' on, the search in 'compute_lis_alignment' is expected to try.
+ * Once the read is aligned, and 'min_lis' > 0, the search ends on the 'read.best'-th drop of the number of k-mer hits.
+ * Otherwise it is not known: most reads end the search on the first candidates (on the N-th alignment with
+ * '-num_alignments N' and no 'best'), so the expected depth starts with the alignments still missing, and grows
+ * with the candidates tried. Only the reads going through many candidates get the batches.
+ */
+static uint32_t search_depth(uint32_t k, Read& read, Runopts& opts, const vector<uint32pair>& candidates, bool is_aligned)
+{
+	uint32_t depth = (uint32_t)candidates.size() - k;
+	if (is_aligned && opts.min_lis > 0)
+	{
+		auto best = read.best;
+		depth = 1; // the candidate 'k' is tried
+		for (auto i = k + 1; i < candidates.size(); ++i, ++depth)
+			if (candidates[i].second < candidates[i - 1].second && --best < 1) break;
+	}
+	uint32_t num_left = 1;
+	if (opts.num_alignments > 0 && !opts.is_best)
+	{
+		auto num_found = (uint32_t)read.alignment.alignv.size();
+		if (opts.num_alignments > num_found) num_left = opts.num_alignments - num_found;
+	}
+	depth = std::min(depth, std::max(num_left, k));
+	return depth;
+} // ~search_depth
+
 void compute_lis_alignment( Read& read, Runopts& opts,
 							Index& index, References& refs, 
 							Readstats& readstats, Refstats& refstats,
@@ -103,47 +411,28 @@ void compute_lis_alignment( Read& read, Runopts& opts,
 	// true if SW alignment between the read and a candidate reference meets the threshold
 	bool is_aligned = false;
 
-	map<uint32_t, uint32_t> refs_kmer_count_map; // map of kmer hits on candidate references
-	//    |         |_number of k-mer hits on the reference
-	//    |_reference number/position in the ref file
-
-	vector<uint32pair> refs_kmer_count_vec; // use to sort the 'refs_kmer_count_map' (map cannot be sorted)
-	map<uint32_t, uint32_t>::iterator map_it;
+	static thread_local RefHitCounter ref_hits; // kmer hits on candidate references. Reused by the thread for all reads
+	static thread_local QueryProfileCache profiles; // SSW profiles of the read slices. Reused for all candidates and passes
+	static thread_local CandidateBatch batch; // k-mer hits and first alignments of the next candidates
+	ref_hits.clear();
+	batch.clear();
+	vector<uint32pair>& refs_kmer_count_vec = ref_hits.counts; // [reference number : number of k-mer hits on the reference]
 	uint32_t max_ref = 0; // reference with max kmer occurrences
 	uint32_t max_occur = 0; // number of kmer occurrences on the 'max_ref'
 
 	// 1. For each candidate reference compute the number of kmer hits belonging to it
 	for (auto const& hit: read.id_win_hits)
 	{
-		seq_pos* positions_tbl_ptr = index.positions_tbl[hit.id].arr;
 		// loop all positions of id
-		for (uint32_t j = 0; j < index.positions_tbl[hit.id].size; j++)
+		for (seq_pos* positions_tbl_ptr = index.positions_tbl.begin(hit.id), *end = index.positions_tbl.end(hit.id);
+			positions_tbl_ptr != end; ++positions_tbl_ptr)
 		{
-			uint32_t seq = positions_tbl_ptr++->seq;
-			if ((map_it = refs_kmer_count_map.find(seq)) != refs_kmer_count_map.end())
-				map_it->second++; // sequence already in the map, increment its frequency value
-			else
-				refs_kmer_count_map[seq] = 1; // sequence not in the map, add it
+			ref_hits.add(positions_tbl_ptr->seq);
 		}
 	}
 
-	// copy frequency map to vector for sorting
-	// consider only candidate references that have enough seed hits
-	for (auto const& freq_pair: refs_kmer_count_map)
-	{
-		if (freq_pair.second >= (uint32_t)opts.num_seeds)
-			refs_kmer_count_vec.push_back(freq_pair);
-	}
-
-	refs_kmer_count_map.clear();
-
-	// sort sequences by frequency in descending order
-	auto cmp = [](std::pair<uint32_t, uint32_t> e1, std::pair<uint32_t, uint32_t> e2) {
-		if (e1.second == e2.second)
-			return e1.first ASCENDING e2.first; // order references ascending for equal frequencies (originally - descending)
-		return e1.second DESCENDING e2.second; // order frequencies descending
-	}; // comparator
-	std::sort(refs_kmer_count_vec.begin(), refs_kmer_count_vec.end(), cmp);
+	// consider only candidate references that have enough seed hits, sorted by frequency in descending order
+	ref_hits.count((uint32_t)opts.num_seeds);
 
 	// 2. loop reference candidates, starting from the one with the highest number of kmer hits.
 	auto is_search_candidates = true;
@@ -166,37 +455,20 @@ void compute_lis_alignment( Read& read, Runopts& opts,
 			if (read.best < 1) break;
 		}
 
-		// list of matching kmer pairs on a given reference: 
+		//
+		// 3. populate 'hits_on_ref' - collected for the next candidates at once, together with their first alignment
+		//
+		if (k >= batch.end)
+			batch.fill(k, search_depth(k, read, opts, refs_kmer_count_vec, is_aligned), read, opts, index, refs, refstats, refs_kmer_count_vec, profiles);
+
+		// list of matching kmer pairs on a given reference sorted by position:
 		//  [pair<1st:k-mer ref pos, 2nd:k-mer read pos>] e.g.
 		//  [ (493, 0), ..., (674, 18), ... ]
 		//      |   |_k-mer position on the read
 		//      |_k-mer position on the reference
-		vector<uint32pair> hits_on_ref;
-
-		//
-		// 3. populate 'hits_on_ref'
-		//
-		for ( auto const& hit: read.id_win_hits )
-		{
-			uint32_t num_hits = index.positions_tbl[hit.id].size;
-			seq_pos* positions_tbl_ptr = index.positions_tbl[hit.id].arr;
-			// loop through every position of id
-			for (uint32_t j = 0; j < num_hits; j++)
-			{
-				if (positions_tbl_ptr->seq == max_ref)
-				{
-					hits_on_ref.push_back(uint32pair(positions_tbl_ptr->pos, hit.win));
-				}
-				positions_tbl_ptr++;
-			}
-		}
-
-		// sort the positions in ascending order
-		std::sort(hits_on_ref.begin(), hits_on_ref.end(), [](uint32pair e1, uint32pair e2) {
-			if (e1.first == e2.first) 
-				return (e1.second ASCENDING e2.second); // order references ascending for equal reference positions
-			return (e1.first ASCENDING e2.first);
-		}); // smallest
+		vector<uint32pair>& hits_on_ref = batch.hits[k - batch.begin];
+		auto const& first_job = batch.jobs[k - batch.begin]; // alignment of the first window
+		auto is_first_window = true;
 
 		// iterate over the set of hits, searching for windows of
 		// win.len == read.len which have at least ratio hits
@@ -278,130 +550,64 @@ void compute_lis_alignment( Read& read, Runopts& opts,
 							edges = static_cast<decltype(edges)>((opts.edges / 100.0) * read.sequence.length());
 						else
 							edges = static_cast<decltype(edges)>(opts.edges);
-						// part of the read hangs off (or matches exactly) the beginning of the reference seq
-						//            ref |-----------------------------------|
-						// que |-------------------|
-						//             LIS |-----|
-						//
-						if (lcs_ref_start < lcs_que_start)
-						{
-							align_ref_start = 0;
-							align_que_start = lcs_que_start - lcs_ref_start;
-							head = 0;
-							// the read is longer than the reference sequence
-							//            ref |----------------|
-							// que |---------------------...|
-							//                LIS |-----|
-							//
-							if (reflen < read.sequence.length())
-							{
-								tail = 0;
-								// beginning from align_ref_start = 0 and align_que_start = X, the read finishes
-								// before the end of the reference
-								//            ref |----------------|
-								// que |------------------------|
-								//                  LIS |-----|
-								//                ^
-								//                align_que_start
-								if (align_que_start >(read.sequence.length() - reflen))
-								{
-									align_length = reflen - (align_que_start - (read.sequence.length() - reflen));
-								}
-								// beginning from align_ref_start = 0 and align_que_start = X, the read finishes
-								// after the end of the reference
-								//            ref |----------------|
-								// que |------------------------------|
-								//                  LIS |-----|
-								//                ^
-								//                align_que_start
-								else
-								{
-									align_length = reflen;
-								}
-							}
-							else
-							{
-								tail = reflen - align_ref_start - read.sequence.length();
-								tail > (edges - 1) ? tail = edges : tail;
-								align_length = read.sequence.length() + head + tail - align_que_start;
-							}
-						}
-						else
-						{
-							align_ref_start = lcs_ref_start - lcs_que_start;
-							align_que_start = 0;
-							align_ref_start > (edges - 1) ? head = edges : head;
-							// part of the read hangs off the end of the reference seq
-							// ref |-----------------------------------|
-							//                          que |-------------------|
-							//                            LIS |-----|
-							//
-							if (align_ref_start + read.sequence.length() > reflen) // readlen
-							{
-								tail = 0;
-								align_length = reflen - align_ref_start - head;
-							}
-							// the reference seq fully covers the read
-							// ref |-----------------------------------|
-							//    que |-------------------|
-							//          LIS |-----|
-							//
-							else
-							{
-								tail = reflen - align_ref_start - read.sequence.length();
-								tail > (edges - 1) ? tail = edges : tail;
-								align_length = read.sequence.length() + head + tail;
-							}
-						}
+						align_window(lcs_ref_start, lcs_que_start, reflen, read.sequence.length(), edges,
+							head, tail, align_ref_start, align_que_start, align_length);
 
 						// put read into 04 encoding before SSW
 						if (read.is03) 
 							read.flip34();
                        
-						// create profile for read
-						s_profile* profile = 0;
-						profile = ssw_init((int8_t*)(&read.isequence[0] + align_que_start), (align_length - head - tail), &read.scoring_matrix[0], 5, 2);
+						// profile of the read slice - built once per slice and strand
+						const s_profile* profile = profiles.get(read, align_que_start, align_length - head - tail);
 
 						s_align* result = 0;
+						uint32_t score1 = 0;
+
+						// alignments scoring at most 'min_stored_score' pass the threshold or not, but are not stored
+						// in the read: only their score is needed, not the begin positions and the CIGAR (traceback)
+						uint32_t min_stored_score = refstats.minimal_score[index.index_num];
+						if (opts.num_alignments > 0 && opts.is_best && read.alignment.alignv.size() >= opts.num_alignments)
+						{
+							if (read.alignment.alignv.size() == opts.num_alignments && !opts.is_best_id_cov)
+								min_stored_score = std::max<uint32_t>(min_stored_score, read.alignment.alignv[read.alignment.min_index].score1);
+							else
+								min_stored_score = UINT16_MAX;
+						}
 
-						result = ssw_align(
-							profile,
-							(int8_t*)refs.buffer[max_ref].sequence.c_str() + align_ref_start - head,
-							align_length,
-							opts.gap_open,
-							opts.gap_extension,
-							2,
-							refstats.minimal_score[index.index_num], // minimal_score_index_num
-							0,
-							0
-						);
-
-						// deallocate memory for profile, no longer needed
-						if (profile != 0) 
-							init_destroy(&profile);
+						// the first window was already scored with the batch
+						auto is_scored = is_first_window && first_job.is_scored
+							&& first_job.align_ref_start == align_ref_start && first_job.align_que_start == align_que_start
+							&& first_job.align_length == align_length && first_job.head == head && first_job.tail == tail;
+
+						if (is_scored && first_job.score <= min_stored_score)
+						{
+							score1 = first_job.score;
+						}
+						else
+						{
+							// the reverse pass and the traceback only for the alignments to store
+							result = ssw_align(
+								profile,
+								(int8_t*)refs.buffer[max_ref].sequence.data() + align_ref_start - head,
+								align_length,
+								opts.gap_open,
+								opts.gap_extension,
+								2,
+								(uint16_t)std::min<uint32_t>(min_stored_score + 1, UINT16_MAX),
+								0,
+								0
+							);
+							if (result != 0)
+								score1 = result->score1;
+						}
 
 						// check alignment passes the threshold
-						is_aligned = (result != 0 && result->score1 > refstats.minimal_score[index.index_num]);
+						is_aligned = score1 > refstats.minimal_score[index.index_num];
 						if (is_aligned)
 						{
-							if (result->score1 == max_SW_score) 
+							if (score1 == max_SW_score) 
 								++read.max_SW_count; // a max possible score has been found
 
-							// add the offset calculated by the LCS (from the beginning of the sequence)
-							// to the offset computed by SW alignment
-							result->ref_begin1 += (align_ref_start - head);
-							result->ref_end1 += (align_ref_start - head);
-							result->read_begin1 += align_que_start;
-							result->read_end1 += align_que_start;
-							result->readlen = read.sequence.length();
-							result->ref_num = max_ref;
-
-							result->index_num = index.index_num;
-							result->part = index.part;
-							result->strand = !read.reversed; // flag whether the alignment was done on a forward or reverse strand
-
-							auto alignment = copyAlignment(result); // new alignment
-
 							// read has not yet been mapped, set bit to true for this read
 							// (this is the Only place where read.is_hit can be modified)
 							if (!read.is_hit)
@@ -411,48 +617,70 @@ void compute_lis_alignment( Read& read, Runopts& opts,
 								++readstats.reads_matched_per_db[index.index_num];
 							}
 
-							// if 'N == 0' or 'Not is_best' or 'is_best And read.alignments.size < N' => 
-							//   simply add the new alignment to read.alignments
-							if (opts.num_alignments == 0 || !opts.is_best || (opts.is_best && read.alignment.alignv.size() < opts.num_alignments))
-							{
-								read.alignment.alignv.emplace_back(alignment);
-								read.is_new_hit = true; // flag to store in DB
-							}
-							else if ( opts.is_best 
-									&& read.alignment.alignv.size() == opts.num_alignments 
-									&& read.alignment.alignv[read.alignment.min_index].score1 < result->score1 )
+							if (score1 > min_stored_score)
 							{
-								if (opts.is_best_id_cov) {
-									// TODO: new case to implement 20200703
+								// add the offset calculated by the LCS (from the beginning of the sequence)
+								// to the offset computed by SW alignment
+								result->ref_begin1 += (align_ref_start - head);
+								result->ref_end1 += (align_ref_start - head);
+								result->read_begin1 += align_que_start;
+								result->read_end1 += align_que_start;
+								result->readlen = read.sequence.length();
+								result->ref_num = max_ref;
+
+								result->index_num = index.index_num;
+								result->part = index.part;
+								result->strand = !read.reversed; // flag whether the alignment was done on a forward or reverse strand
+
+								auto alignment = copyAlignment(result); // new alignment
+
+								// mismatches, gaps, matches while the reference is at hand. The read is on the strand 
+								// of the alignment and in 04 encoding
+								read.calc_miss_gap_match(refs, alignment);
+
+								// if 'N == 0' or 'Not is_best' or 'is_best And read.alignments.size < N' => 
+								//   simply add the new alignment to read.alignments
+								if (opts.num_alignments == 0 || !opts.is_best || (opts.is_best && read.alignment.alignv.size() < opts.num_alignments))
+								{
+									read.alignment.alignv.emplace_back(alignment);
+									read.is_new_hit = true; // flag to store in DB
 								}
-								else {
-									// set min and max pointers - just once, after all the reads' alignments were filled
-									if (opts.num_alignments > 1 && read.alignment.max_index == 0 && read.alignment.min_index == 0) {
-										read.alignment.min_index = findMinIndex(read.alignment.alignv);
-										read.alignment.max_index = findMaxIndex(read.alignment.alignv);
+								else if ( opts.is_best 
+										&& read.alignment.alignv.size() == opts.num_alignments 
+										&& read.alignment.alignv[read.alignment.min_index].score1 < score1 )
+								{
+									if (opts.is_best_id_cov) {
+										// TODO: new case to implement 20200703
 									}
-
-									uint32_t min_score_index = read.alignment.min_index;
-									uint32_t max_score_index = read.alignment.max_index;
-
-									// replace the old smallest scored alignment with the new one
-									read.alignment.alignv[min_score_index] = alignment;
-									read.is_new_hit = true; // flag to store in DB
-
-									// if new_hit > max_hit: the old min_hit_idx becomes the new max_hit_idx
-									// only do if num_alignments > 1 i.e. max_idx != min_idx
-									if (result->score1 > read.alignment.alignv[max_score_index].score1 && read.alignment.alignv.size() > 1) {
-										read.alignment.max_index = min_score_index; // new max index
-										read.alignment.min_index = findMinIndex(read.alignment.alignv); // new min index
+									else {
+										// set min and max pointers - just once, after all the reads' alignments were filled
+										if (opts.num_alignments > 1 && read.alignment.max_index == 0 && read.alignment.min_index == 0) {
+											read.alignment.min_index = findMinIndex(read.alignment.alignv);
+											read.alignment.max_index = findMaxIndex(read.alignment.alignv);
+										}
+
+										uint32_t min_score_index = read.alignment.min_index;
+										uint32_t max_score_index = read.alignment.max_index;
+
+										// replace the old smallest scored alignment with the new one
+										read.alignment.alignv[min_score_index] = alignment;
+										read.is_new_hit = true; // flag to store in DB
+
+										// if new_hit > max_hit: the old min_hit_idx becomes the new max_hit_idx
+										// only do if num_alignments > 1 i.e. max_idx != min_idx
+										if (score1 > read.alignment.alignv[max_score_index].score1 && read.alignment.alignv.size() > 1) {
+											read.alignment.max_index = min_score_index; // new max index
+											read.alignment.min_index = findMinIndex(read.alignment.alignv); // new min index
+										}
+
+										// decrement number of reads mapped to database with lower score
+										--readstats.reads_matched_per_db[read.alignment.alignv[min_score_index].index_num];
+										//                                                           |_old min index
+										// increment number of reads mapped to database with higher score
+										++readstats.reads_matched_per_db[index.index_num];
 									}
-
-									// decrement number of reads mapped to database with lower score
-									--readstats.reads_matched_per_db[read.alignment.alignv[min_score_index].index_num];
-									//                                                           |_old min index
-									// increment number of reads mapped to database with higher score
-									++readstats.reads_matched_per_db[index.index_num];
-								}
-							}//~if
+								}//~if
+							}
 
 							// if all alignments have been found - stop searching
 							if (opts.num_alignments > 0) {
@@ -480,6 +708,7 @@ void compute_lis_alignment( Read& read, Runopts& opts,
 #endif                                              
 			}//~if enough window hits                                                
 		pop:
+			is_first_window = false;
 			// get the next candidate reference position 
 			if (!match_set.empty())
 			{
@@ -574,7 +803,7 @@ std::pair<bool,bool> inline is_id_cov_pass(std::string& read_iseq, s_align2& ali
 	auto read_i = alignment.ref_begin1; // index of the first char in the reference matched part
 	auto query_i = alignment.read_begin1; // index of the first char in the read matched part
 
-	std::string refseq = refs.buffer[alignment.ref_num].sequence; // reference sequence
+	auto const& refseq = refs.buffer[alignment.ref_num].sequence; // reference sequence
 	int32_t align_len = abs(alignment.read_end1 + 1 - alignment.read_begin1); // alignment length
 
 	for (uint32_t cigar_i = 0; cigar_i < alignment.cigar.size(); ++cigar_i)
@@ -41,6 +41,7 @@
 #include <cctype> // isdigit
 #include <string>
 #include <utility> // std::pair
+#include <algorithm> // std::all_of
 
 #include "cmd.hpp"
 #include "options.hpp"
@@ -65,7 +66,7 @@ void CmdSession::run(Runopts & opts)
 
 	for (;;)
 	{
-		std::cout << "Enter command: [read --id=ID | --db, index --idx=N --part=N --read=N --pos=0 | exit]: ";
+		std::cout << "Enter command: [read --id=ID | --db, index --idx=N --part=N --read=ID --pos=0 | exit]: ";
 		std::getline(std::cin, cmd);
 		std::cout << "Processing command: " << cmd << std::endl;
 		std::istringstream iss(cmd);
@@ -106,44 +107,55 @@ bool getOpt(std::string & cmd, const std::string OPT, std::string & optval)
 
 
 /* 
- * @param cmdv[1]  read index e.g. 0, 10, 480 i.e. read number in the file
+ * read --id=0_480 [--db]
+ *
+ * @param --id  read ID 'readsfile_readnumber' e.g. 0_480 i.e. the read 480 of the split file 0
  */
 void CmdSession::cmdRead(Runopts & opts, std::string & cmd)
 {
 	std::stringstream ss;
 
 	std::string readid;
-	bool isnumber = false;
+	bool isid = false;
 	bool isdb = false; // --db load read from DB
 	Read read;
 
 	getOpt(cmd, OPT_ID, readid);
 	isdb = cmd.find(OPT_DB) != std::string::npos;
 
-	isnumber = !readid.empty() && std::find_if(readid.begin(), readid.end(),
-		[](char c) { return !std::isdigit(c); }) == readid.end();
+	auto sep = readid.find('_');
+	auto isdigit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+	isid = sep != std::string::npos && sep > 0 && sep + 1 < readid.size()
+		&& std::all_of(readid.begin(), readid.begin() + sep, isdigit) && std::all_of(readid.begin() + sep + 1, readid.end(), isdigit);
 
-	if ( isnumber )
+	if ( isid )
 	{
 		if (isdb)
 		{
-			KeyValueDatabase kvdb(opts.kvdbdir.string());
+			KeyValueDatabase kvdb(opts.kvdbdir.string(), opts.kvdb_type);
 			read.clear();
-			read.init(opts); // TODO: pass the required reads file number i.e. 0 or 1 to generate a correct read.id
+			read.id = readid;
+			read.load_db(kvdb.get(readid));
 			ss << read.matchesToJson() << std::endl;
 		}
 		else
 		{
+			// the read stores of the split made with '-reads_feed 2'. Opened as they are - no split
+			Readfeed readfeed(opts.readb_dir);
 			read.id = readid;
-			bool isok = Readfeed::loadReadByIdx(read);
+			bool isok = readfeed.is_ready && readfeed.loadReadById(read);
 			ss << "Read load OK " << isok << std::endl;
 		}
 	}
+	else
+	{
+		ss << "cmdRead: expected the read ID 'readsfile_readnumber' e.g. 0_480. Got: " << readid << std::endl;
+	}
 	std::cout << ss.str(); ss.str("");
 } // ~CmdSession::cmdRead
 
 /* 
- * index --idx=0 --part=1 --ref=2095 --read=480 --pos=0
+ * index --idx=0 --part=1 --ref=2095 --read=0_480 --pos=0
  *
  * Find if the kmer at position '--pos' in the read '--read' has matches in the reference '--ref'
  */
@@ -169,7 +181,7 @@ void CmdSession::cmdIndex(Runopts & opts, std::string & cmd)
 		return;
 	}
 
-	KeyValueDatabase kvdb(opts.kvdbdir.string());
+	KeyValueDatabase kvdb(opts.kvdbdir.string(), opts.kvdb_type);
 	Readstats readstats(0, 0, 0, 0, kvdb, opts);
 	Refstats refstats(opts, readstats);
 	References refs;
@@ -178,8 +190,14 @@ void CmdSession::cmdIndex(Runopts & opts, std::string & cmd)
 
 	// find half-kmer prefix/suffix matches
 	//
+	Readfeed readfeed(opts.readb_dir); // the read stores of the split made with '-reads_feed 2'
 	read.id = readid;
-	isok = Readfeed::loadReadByIdx(read);
+	isok = readfeed.is_ready && readfeed.loadReadById(read);
+	if (!isok)
+	{
+		std::cout << "cmdIndex: failed to load the read " << readid << " from the read store. Returning.." << std::endl;
+		return;
+	}
 	if (read.sequence.size() > 0 && read.isequence.size() == 0)
 		read.seqToIntStr();
 	index.load(std::stoi(idxval), std::stoi(partval), opts.indexfiles, refstats);
@@ -231,28 +249,28 @@ void CmdSession::cmdIndex(Runopts & opts, std::string & cmd)
 
 	for (auto it = id_hits.begin(); it != id_hits.end(); ++it)
 	{
-		// sort matches by Reference ID
-		std::sort(&index.positions_tbl[it->id].arr[0],
-			&index.positions_tbl[it->id].arr[index.positions_tbl[it->id].size - 1],
+		// sort matches by Reference ID. The positions table is read-only (mapped index) - sort a copy
+		std::vector<seq_pos> positions(index.positions_tbl.begin(it->id), index.positions_tbl.end(it->id));
+		std::sort(positions.begin(), positions.end(),
 			[](seq_pos a, seq_pos b) { return a.seq > b.seq; });
 
-		std::cout << "kmer iD: " << it->id << " Num hits: " << index.positions_tbl[it->id].size << std::endl;
+		std::cout << "kmer iD: " << it->id << " Num hits: " << positions.size() << std::endl;
 
-		for ( uint32_t i = 0; i < index.positions_tbl[it->id].size; ++i)
+		for ( uint32_t i = 0; i < positions.size(); ++i)
 		{
 			// populate frequency map
-			auto map_it = seq_kmer_freq_map.find(index.positions_tbl[it->id].arr[i].seq);
+			auto map_it = seq_kmer_freq_map.find(positions[i].seq);
 			if (map_it != seq_kmer_freq_map.end())
 				map_it->second++; // increment the frequency
 			else
-				seq_kmer_freq_map[index.positions_tbl[it->id].arr[i].seq] = 1; // add seq to map with freq = 1
+				seq_kmer_freq_map[positions[i].seq] = 1; // add seq to map with freq = 1
 
-			if (index.positions_tbl[it->id].arr[i].seq == std::stoi(refid))
+			if (positions[i].seq == std::stoi(refid))
 				std::cout << "Found match in Ref: " << std::stoi(refid) 
-				<< " at Ref pos: " << index.positions_tbl[it->id].arr[i].pos 
+				<< " at Ref pos: " << positions[i].pos 
 				<< " hit number: " << i << std::endl;
 		}
-		//std::cout << "Max Reference number: " << index.positions_tbl[it->id].arr[0].seq << std::endl;
+		//std::cout << "Max Reference number: " << positions[0].seq << std::endl;
 	}
 
 	// copy frequency map pairs to vector
@@ -296,7 +314,7 @@ void CmdSession::cmd_max_ref_part(Runopts & opts, std::string & cmd)
 		return;
 	}
 
-	KeyValueDatabase kvdb(opts.kvdbdir.string());
+	KeyValueDatabase kvdb(opts.kvdbdir.string(), opts.kvdb_type);
 	Readstats readstats(0, 0, 0, 0, kvdb, opts);
 	Refstats refstats(opts, readstats);
 	References refs;
@@ -46,6 +46,16 @@
 #include <array>
 #include <sstream>
 #include <filesystem>
+#include <chrono>
+
+#if defined(_WIN32)
+#  include "windows.h"
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 #include "index.hpp"
 #include "indexdb.hpp"
@@ -56,7 +66,9 @@
 // forward
 std::string string_hash(const std::string& val); // util.cpp
 
-Index::Index(Runopts& opts) : index_num(0), part(0), number_elements(0), is_ready(false)
+Index::Index() : index_num(0), part(0), number_elements(0), is_ready(true), positions_tbl{ NULL, NULL }, image(NULL), image_size(0) {}
+
+Index::Index(Runopts& opts) : index_num(0), part(0), number_elements(0), is_ready(false), positions_tbl{ NULL, NULL }, image(NULL), image_size(0)
 {
 	std::stringstream ss;
 	std::array<std::string, 4> sfxarr{ {".bursttrie_0.dat", ".pos_0.dat", ".kmer_0.dat", ".stats"} };
@@ -139,6 +151,133 @@ Index::Index(Runopts& opts) : index_num(0), part(0), number_elements(0), is_read
 } // ~Index::Index
 
 void Index::load(uint32_t idx_num, uint32_t idx_part, std::vector<std::pair<std::string, std::string>>& indexfiles, Refstats& refstats)
+{
+	uint32_t limit = 1 << refstats.lnwin[idx_num];
+	std::string mmapfile = indexfiles[idx_num].second + ".mmap_" + std::to_string(idx_part) + ".dat";
+	std::string btriefile = indexfiles[idx_num].second + ".bursttrie_" + std::to_string(idx_part) + ".dat";
+
+	bool is_stale = !std::filesystem::exists(mmapfile)
+		|| (std::filesystem::exists(btriefile) && std::filesystem::last_write_time(mmapfile) < std::filesystem::last_write_time(btriefile));
+
+	if (is_stale || !map_file(mmapfile, limit))
+	{
+		INFO("Generating mappable index file ", mmapfile);
+		load_legacy(idx_num, idx_part, indexfiles, refstats);
+		// write to a temporary file first as other processes may be mapping the same index
+		std::string tmpfile = mmapfile + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+		write_mmap_index(tmpfile, lookup_tbl.data(), (uint32_t)lookup_tbl.size(), positions_tbl, number_elements);
+		unload_legacy();
+		std::error_code ec;
+		std::filesystem::rename(tmpfile, mmapfile, ec);
+		if (ec)
+		{
+			ERR("Failed to rename ", tmpfile, " to ", mmapfile, ": ", ec.message());
+			exit(EXIT_FAILURE);
+		}
+
+		if (!map_file(mmapfile, limit))
+		{
+			ERR("Failed to map the index file ", mmapfile);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// the look-up and positions tables reference the mapped file. Nothing is copied.
+	auto header = reinterpret_cast<mmap_index_header*>(image);
+	auto kmers = reinterpret_cast<mmap_index_kmer*>(image + header->kmer_offset);
+	lookup_tbl.resize(limit);
+	for (uint32_t i = 0; i < limit; i++)
+	{
+		lookup_tbl[i].count = kmers[i].count;
+		lookup_tbl[i].trie_F = kmers[i].trie_F == 0 ? NULL : reinterpret_cast<NodeElement*>(image + kmers[i].trie_F);
+		lookup_tbl[i].trie_R = kmers[i].trie_R == 0 ? NULL : reinterpret_cast<NodeElement*>(image + kmers[i].trie_R);
+	}
+
+	number_elements = header->number_elements;
+	positions_tbl.offset = reinterpret_cast<uint64_t*>(image + header->pos_offset);
+	positions_tbl.arr = reinterpret_cast<seq_pos*>(positions_tbl.offset + number_elements + 1);
+
+	index_num = idx_num;
+	part = idx_part;
+} // ~Index::load
+
+void Index::unload()
+{
+	lookup_tbl.clear();
+	positions_tbl.offset = NULL;
+	positions_tbl.arr = NULL;
+	unmap_file();
+} // ~Index::unload
+
+/*
+ * map the file read-only and shared, so that concurrent processes using the same index share the pages
+ * @return false if the file cannot be mapped or is not a valid index file
+ */
+bool Index::map_file(const std::string& mmapfile, uint32_t limit)
+{
+	unmap_file();
+#if defined(_WIN32)
+	HANDLE hfile = CreateFileA(mmapfile.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hfile == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fsize;
+	if (!GetFileSizeEx(hfile, &fsize) || fsize.QuadPart < (LONGLONG)sizeof(mmap_index_header))
+	{
+		CloseHandle(hfile);
+		return false;
+	}
+	HANDLE hmap = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hmap != NULL)
+	{
+		image = (char*)MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(hmap);
+	}
+	CloseHandle(hfile);
+	if (image == NULL) return false;
+	image_size = (size_t)fsize.QuadPart;
+#else
+	int fd = open(mmapfile.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(mmap_index_header))
+	{
+		close(fd);
+		return false;
+	}
+	void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return false;
+	image = (char*)addr;
+	image_size = st.st_size;
+	madvise(image, image_size, MADV_WILLNEED);
+#endif
+
+	auto header = reinterpret_cast<mmap_index_header*>(image);
+	if (memcmp(header->magic, MMAP_INDEX_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != MMAP_INDEX_VERSION
+		|| header->node_size != sizeof(NodeElement)
+		|| header->limit != limit
+		|| header->file_size != image_size)
+	{
+		WARN("Index file ", mmapfile, " is not valid or was generated by a different version");
+		unmap_file();
+		return false;
+	}
+	return true;
+} // ~Index::map_file
+
+void Index::unmap_file()
+{
+	if (image == NULL) return;
+#if defined(_WIN32)
+	UnmapViewOfFile(image);
+#else
+	munmap(image, image_size);
+#endif
+	image = NULL;
+	image_size = 0;
+} // ~Index::unmap_file
+
+void Index::load_legacy(uint32_t idx_num, uint32_t idx_part, std::vector<std::pair<std::string, std::string>>& indexfiles, Refstats& refstats)
 {
 	// STEP 1: load the kmer 'count' variables (dbname.kmer.dat)
 	std::string idxfile = indexfiles[idx_num].second + ".kmer_" + std::to_string(idx_part) + ".dat";
@@ -325,36 +464,33 @@ void Index::load(uint32_t idx_num, uint32_t idx_part, std::vector<std::pair<std:
 
 	uint32_t size = 0;
 	inreff.read(reinterpret_cast<char*>(&number_elements), sizeof(uint32_t));
-	positions_tbl.reserve(number_elements); // = new kmer_origin[number_elements]();
 
-	if (positions_tbl.capacity() == 0)
-	{
-		fprintf(stderr, "  ERROR: could not allocate memory for positions_tbl (main(), paralleltraversal.cpp)\n");
-		exit(EXIT_FAILURE);
-	}
+	// the file holds the number of positions followed by the positions for each 19-mer
+	auto num_pos = (std::filesystem::file_size(posfile) - sizeof(uint32_t) * (number_elements + 1ULL)) / sizeof(seq_pos);
+	pos_offset.resize(number_elements + 1ULL);
+	pos_arr.resize(num_pos);
 
+	pos_offset[0] = 0;
 	for (uint32_t i = 0; i < number_elements; i++)
 	{
 		/* the number of positions */
-		positions_tbl.push_back(kmer_origin());
 		inreff.read(reinterpret_cast<char*>(&size), sizeof(uint32_t));
-		positions_tbl[i].size = size;
-		/* the sequence seq_pos array */
-		positions_tbl[i].arr = new seq_pos[size]();
-		if (positions_tbl[i].arr == NULL)
+		pos_offset[i + 1] = pos_offset[i] + size;
+		if (pos_offset[i + 1] > num_pos)
 		{
-			fprintf(stderr, "  ERROR: could not allocate memory for positions_tbl (paralleltraversal.cpp)\n");
+			ERR("The index file ", posfile, " is corrupt");
 			exit(EXIT_FAILURE);
 		}
-		inreff.read(reinterpret_cast<char*>(positions_tbl[i].arr), sizeof(seq_pos)*size);
+		/* the sequence seq_pos array */
+		inreff.read(reinterpret_cast<char*>(&pos_arr[pos_offset[i]]), sizeof(seq_pos)*size);
 	}
 
 	inreff.close();
-	index_num = idx_num;
-	part = idx_part;
-} // ~Index::load
+	positions_tbl.offset = pos_offset.data();
+	positions_tbl.arr = pos_arr.data();
+} // ~Index::load_legacy
 
-void Index::unload()
+void Index::unload_legacy()
 {
 	// lookup_tbl
 	for (int i = 0; i < lookup_tbl.size(); i++)
@@ -374,13 +510,8 @@ void Index::unload()
 	lookup_tbl.clear();
 
 	// positions_tbl
-	for (int i = 0; i < positions_tbl.size(); i++)
-	{
-		if (positions_tbl[i].arr != NULL)
-		{
-			delete[] positions_tbl[i].arr;
-			positions_tbl[i].arr = NULL;
-		}
-	}
-	positions_tbl.clear();
-} // ~Index::clear
\ No newline at end of file
+	std::vector<uint64_t>().swap(pos_offset);
+	std::vector<seq_pos>().swap(pos_arr);
+	positions_tbl.offset = NULL;
+	positions_tbl.arr = NULL;
+} // ~Index::unload_legacy
\ No newline at end of file
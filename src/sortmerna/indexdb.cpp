@@ -48,6 +48,8 @@
 #include <iostream>
 #include <filesystem>
 #include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include <sys/stat.h> //for creating tmp dir
 
@@ -56,6 +58,7 @@
 #include "indexdb.hpp"
 #include "cmph.h"
 #include "options.hpp"
+#include "references.hpp"
 
 #if defined(_WIN32)
 #include <Winsock.h>
@@ -304,48 +307,83 @@ inline void insert_prefix(NodeElement* trie_node,
 
 
 
+// occurrence of a k-mer on a reference sequence, collected in the order of the sequences
+struct kmer_occurrence
+{
+	uint32_t id; // the k-mer id (MPHF)
+	seq_pos sp;
+};
+
 /*
  *
- * @function add a k-mer occurrence to the table of occurrences
- * @param kmer_origin* positions_tbl
- * @param uint32_t seq: the sequence number
- * @param uint32_t pos: the position on sequence
+ * @function build the table of k-mer occurrences in the compressed sparse row layout
+ * @param occurrences: all k-mer occurrences in the order of the reference sequences
+ * @param uint32_t number_elements: number of unique k-mers
+ * @param uint32_t max_pos: maximum number of occurrences to store per k-mer. 0 - all
+ * @param uint32_t num_threads: the occurrences are partitioned by k-mer id ranges between the threads
+ * @param offset: number_elements + 1 offsets into 'arr'
+ * @param arr: the contiguous array of the occurrences
  * @return void
- * @version 1.0 Jan 16, 2013
  *
  *******************************************************************/
-inline void add_kmer_to_table(kmer_origin* positions_tbl,
-	uint32_t seq,
-	uint32_t pos,
-	uint32_t max_pos)
+void build_positions_table(const std::vector<kmer_occurrence>& occurrences,
+	uint32_t number_elements,
+	uint32_t max_pos,
+	uint32_t num_threads,
+	std::vector<uint64_t>& offset,
+	std::vector<seq_pos>& arr)
 {
-	uint32_t size = positions_tbl->size;
-
-	// create an entry for the new unique k-mer occurrence
-	if (size == 0)
+	offset.assign(number_elements + 1, 0);
+	size_t num_occur = occurrences.size();
+	auto range_of = [&](uint32_t id) { return (uint32_t)((uint64_t)id * num_threads / (number_elements > 0 ? number_elements : 1)); };
+
+	// 1. split the occurrences into [chunk][id range] keeping their order
+	std::vector<std::vector<std::vector<kmer_occurrence>>> parts(num_threads, std::vector<std::vector<kmer_occurrence>>(num_threads));
+	std::vector<std::thread> tpool;
+	for (uint32_t t = 0; t < num_threads; ++t)
 	{
-		positions_tbl->arr = (seq_pos*)malloc(sizeof(seq_pos));
-		memset(positions_tbl->arr, 0, sizeof(seq_pos));
+		tpool.emplace_back([&, t]() {
+			for (size_t i = num_occur * t / num_threads; i < num_occur * (t + 1) / num_threads; ++i)
+				parts[t][range_of(occurrences[i].id)].push_back(occurrences[i]);
+		});
 	}
-	// add a position for an existing k-mer occurrence
-	else
+	for (auto& thr : tpool) thr.join();
+	tpool.clear();
+
+	// 2. count the occurrences of each k-mer. max_pos == 0 means to store all occurrences (default),
+	// otherwise only the first max_pos occurrences are stored
+	for (uint32_t r = 0; r < num_threads; ++r)
 	{
-		// max_pos == 0 means to store all occurrences (default), otherwise
-		// stop storing occurrences when size == max_pos
-		if ((max_pos > 0) && (size == max_pos)) return;
+		tpool.emplace_back([&, r]() {
+			for (uint32_t t = 0; t < num_threads; ++t)
+				for (auto const& occ : parts[t][r])
+					if (max_pos == 0 || offset[occ.id + 1] < max_pos)
+						++offset[occ.id + 1];
+		});
+	}
+	for (auto& thr : tpool) thr.join();
+	tpool.clear();
 
-		seq_pos* src = positions_tbl->arr;
-		positions_tbl->arr = (seq_pos*)malloc((size + 1) * sizeof(seq_pos));
-		memset(positions_tbl->arr, 0, (size + 1) * sizeof(seq_pos));
-		memcpy(positions_tbl->arr, src, size * sizeof(seq_pos));
+	for (uint32_t i = 0; i < number_elements; i++)
+		offset[i + 1] += offset[i];
 
-		free(src);
+	// 3. place the occurrences keeping their order
+	arr.resize(offset[number_elements]);
+	std::vector<uint64_t> next(offset.begin(), offset.end() - 1);
+	for (uint32_t r = 0; r < num_threads; ++r)
+	{
+		tpool.emplace_back([&, r]() {
+			for (uint32_t t = 0; t < num_threads; ++t)
+			{
+				for (auto const& occ : parts[t][r])
+					if (next[occ.id] < offset[occ.id + 1])
+						arr[next[occ.id]++] = occ.sp;
+				std::vector<kmer_occurrence>().swap(parts[t][r]);
+			}
+		});
 	}
-
-	positions_tbl->arr[size].seq = seq;
-	positions_tbl->arr[size].pos = pos;
-	positions_tbl->size++;
-}//~add_kmer_to_table
+	for (auto& thr : tpool) thr.join();
+}//~build_positions_table
 
 
 /*
@@ -868,6 +906,113 @@ void load_index(kmer* lookup_table, char* outfile, Runopts &opts)
 	btrie.close();
 }//~load_index()
 
+/*
+ * copy the mini-burst trie into the buffer replacing the pointers with offsets
+ * relative to the node element. Buckets are padded to 8 bytes.
+ *
+ * @return position of the trie node in the buffer
+ */
+static size_t flatten_trie(NodeElement* trie_node, std::vector<char>& buf)
+{
+	size_t node_pos = buf.size();
+	buf.resize(node_pos + 4 * sizeof(NodeElement), 0);
+
+	for (int i = 0; i < 4; i++, trie_node++)
+	{
+		NodeElement elem;
+		memset(&elem, 0, sizeof(NodeElement));
+		elem.flag = trie_node->flag;
+		size_t elem_pos = node_pos + i * sizeof(NodeElement);
+
+		switch (trie_node->flag)
+		{
+		case 0: break;
+		case 1:
+		{
+			size_t child_pos = flatten_trie(trie_node->nodetype.trie, buf);
+			elem.nodetype.offset = (int64_t)child_pos - (int64_t)elem_pos;
+		}
+		break;
+		case 2:
+		{
+			size_t bucket_pos = buf.size();
+			buf.resize(bucket_pos + ((trie_node->size + 7) & ~7u), 0);
+			memcpy(&buf[bucket_pos], trie_node->nodetype.bucket, trie_node->size);
+			elem.size = trie_node->size;
+			elem.nodetype.offset = (int64_t)bucket_pos - (int64_t)elem_pos;
+		}
+		break;
+		default:
+		{
+			ERR("flag is set to ", (int)trie_node->flag, " (flatten_trie)");
+			exit(EXIT_FAILURE);
+		}
+		break;
+		}
+		memcpy(&buf[elem_pos], &elem, sizeof(NodeElement));
+	}
+	return node_pos;
+}//~flatten_trie
+
+void write_mmap_index(const std::string& outfile, kmer* lookup_table, uint32_t limit, const kmer_positions& positions_tbl, uint32_t number_elements)
+{
+	std::ofstream os(outfile, std::ios::binary);
+	if (!os.is_open())
+	{
+		ERR("Failed to open file: ", outfile, " for writing. Error: ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	mmap_index_header header;
+	memset(&header, 0, sizeof(mmap_index_header));
+	memcpy(header.magic, MMAP_INDEX_MAGIC, sizeof(header.magic));
+	header.version = MMAP_INDEX_VERSION;
+	header.limit = limit;
+	header.number_elements = number_elements;
+	header.node_size = sizeof(NodeElement);
+	header.kmer_offset = sizeof(mmap_index_header);
+	header.trie_offset = header.kmer_offset + (uint64_t)limit * sizeof(mmap_index_kmer);
+
+	// header and 9-mer table are written once the tries offsets are known
+	os.seekp(header.trie_offset);
+
+	std::vector<mmap_index_kmer> kmers(limit);
+	std::vector<char> buf;
+	uint64_t offset = header.trie_offset;
+	for (uint32_t i = 0; i < limit; i++)
+	{
+		kmers[i].count = lookup_table[i].count;
+		for (int j = 0; j < 2; j++)
+		{
+			NodeElement* trie = j == 0 ? lookup_table[i].trie_F : lookup_table[i].trie_R;
+			if (trie == NULL) continue;
+			buf.clear();
+			flatten_trie(trie, buf);
+			if (j == 0) kmers[i].trie_F = offset;
+			else kmers[i].trie_R = offset;
+			os.write(buf.data(), buf.size());
+			offset += buf.size();
+		}
+	}
+
+	// the positions table: offsets into the contiguous seq_pos array followed by the array
+	header.pos_offset = offset;
+	uint64_t num_pos = positions_tbl.offset[number_elements];
+	os.write(reinterpret_cast<const char*>(positions_tbl.offset), (number_elements + 1ULL) * sizeof(uint64_t));
+	os.write(reinterpret_cast<const char*>(positions_tbl.arr), num_pos * sizeof(seq_pos));
+	header.file_size = header.pos_offset + (number_elements + 1ULL) * sizeof(uint64_t) + num_pos * sizeof(seq_pos);
+
+	os.seekp(0);
+	os.write(reinterpret_cast<const char*>(&header), sizeof(mmap_index_header));
+	os.write(reinterpret_cast<const char*>(kmers.data()), sizeof(mmap_index_kmer) * limit);
+	os.close();
+	if (os.fail())
+	{
+		ERR("Failed writing file: ", outfile, ". Error: ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}//~write_mmap_index
+
 
 
 /*
@@ -1115,6 +1260,203 @@ void get_keys_str(std::string &keys_str)
 	keys_str = keys_str + "sortmerna_keys_" + pidStr + ".txt";
 } // ~get_keys_str
 
+// sliding 19-mer window with its 9-mer prefix and suffix over an encoded sequence
+struct kmer_window
+{
+	uint32_t key_short_f; // 9-mer prefix of 19-mer
+	uint32_t key_short_r; // 9-mer suffix of 19-mer
+	unsigned char* key_short_f_p; // next letter to add to 9-mer prefix
+	unsigned char* key_short_r_p; // next letter to add to 9-mer suffix
+	unsigned char* key_short_r_rp; // 10-mer of reverse 19-mer to insert into the mini-burst trie
+	unsigned long long int key; // 19-mer
+	unsigned char* key_ptr; // next letter to add to 19-mer
+
+	kmer_window(std::vector<unsigned char>& seq, std::vector<unsigned char>& seqr)
+		: key_short_f(0), key_short_r(0), key(0)
+	{
+		uint32_t len = (uint32_t)seq.size();
+		key_short_f_p = &seq[0];
+		key_short_r_p = &seq[partialwin_gv + 1];
+		key_short_r_rp = &seqr[len - partialwin_gv - 1];
+		key_ptr = &seq[0];
+
+		// initialize the prefix and suffix 9-mers
+		for (uint32_t j = 0; j < partialwin_gv; j++)
+		{
+			(key_short_f <<= 2) |= (int)*key_short_f_p++;
+			(key_short_r <<= 2) |= (int)*key_short_r_p++;
+		}
+
+		// initialize the 19-mer
+		for (uint32_t j = 0; j < pread_gv; j++) (key <<= 2) |= (int)*key_ptr++;
+	}
+
+	// shift 19-mer window and both 9-mers
+	void shift(uint32_t interval)
+	{
+		for (uint32_t i = 0; i < interval; i++)
+		{
+			((key_short_f <<= 2) &= mask32) |= (int)*key_short_f_p++;
+			((key_short_r <<= 2) &= mask32) |= (int)*key_short_r_p++;
+			((key <<= 2) &= mask64) |= (int)*key_ptr++;
+			key_short_r_rp--;
+		}
+	}
+};
+
+/*
+ * add the 19-mers of the index part sequences into the mini-burst tries. The 9-mers
+ * are sharded between the threads: a thread only touches the look-up table entries
+ * and the tries of the 9-mers (key % num_shards == shard), in the order of the sequences
+ * as in a single threaded build, so the tries are identical.
+ *
+ * @param new_keys: [window ordinal, 18-mer] of the 18-mers not yet in the forward tries of the shard
+ */
+static void insert_kmers(std::vector<std::vector<unsigned char>>& seqs, kmer* lookup_table,
+	uint32_t shard, uint32_t num_shards, uint32_t interval, std::vector<std::pair<uint64_t, uint64_t>>& new_keys)
+{
+	// keep track which L/2-mers have been counted for by the forward sliding L/2-mer window
+	std::vector<bool> incremented_by_forward(mask32 + 1);
+	std::vector<unsigned char> seqr;
+	uint64_t ordinal = 0;
+
+	for (auto& seq : seqs)
+	{
+		// create a reverse sequence using the forward
+		seqr.assign(seq.rbegin(), seq.rend());
+		kmer_window win(seq, seqr);
+		uint32_t numwin = ((uint32_t)seq.size() - pread_gv + interval) / interval;
+
+		// for all 19-mers on the sequence
+		for (uint32_t j = 0; j < numwin; j++, ordinal++)
+		{
+			if (win.key_short_f % num_shards == shard)
+			{
+				lookup_table[win.key_short_f].count++;
+				incremented_by_forward[win.key_short_f] = true;
+
+				// ****** add the forward 19-mer
+
+				// new position for 18-mer in positions_tbl
+				bool new_position = true;
+				NodeElement*& trie_F = lookup_table[win.key_short_f].trie_F;
+
+				// forward 19-mer does not exist in the burst trie (duplicates not allowed)
+				if (trie_F == NULL || !search_burst_trie(trie_F, win.key_short_f_p, new_position))
+				{
+					// create a trie node if it doesn't exist
+					if (trie_F == NULL)
+					{
+						trie_F = (NodeElement*)malloc(4 * sizeof(NodeElement));
+						if (trie_F == NULL)
+						{
+							ERR("could not allocate memory for trie_node in indexdb.cpp");
+							exit(EXIT_FAILURE);
+						}
+						memset(trie_F, 0, 4 * sizeof(NodeElement));
+					}
+
+					insert_prefix(trie_F, win.key_short_f_p);
+				}
+
+				// 18-mer doesn't exist in the burst trie, add it to keys
+				if (new_position)
+					new_keys.push_back({ ordinal, win.key >> 2 });
+			}
+
+			if (win.key_short_r % num_shards == shard)
+			{
+				// increment 9-mer count only if it wasn't already
+				// incremented by key_short_f before
+				if (!incremented_by_forward[win.key_short_r]) lookup_table[win.key_short_r].count++;
+
+				// ****** add the reverse 19-mer
+				bool new_position = true;
+				NodeElement*& trie_R = lookup_table[win.key_short_r].trie_R;
+
+				// reverse 19-mer does not exist in the burst trie
+				if (trie_R == NULL || !search_burst_trie(trie_R, win.key_short_r_rp, new_position))
+				{
+					// create a trie node if it doesn't exist
+					if (trie_R == NULL)
+					{
+						trie_R = (NodeElement*)malloc(4 * sizeof(NodeElement));
+						if (trie_R == NULL)
+						{
+							ERR("could not allocate memory for trie_node in indexdb.cpp");
+							exit(EXIT_FAILURE);
+						}
+						memset(trie_R, 0, 4 * sizeof(NodeElement));
+					}
+
+					insert_prefix(trie_R, win.key_short_r_rp);
+				}
+			}
+
+			if (j != numwin - 1) win.shift(interval);
+		}//~for all 19-mers on the sequence
+	}
+}//~insert_kmers
+
+/*
+ * look up the MPHF ids of the 19-mers on the sequences [seq_begin, seq_end)
+ * and record their occurrences at the window ordinals
+ */
+static void find_kmer_ids(std::vector<std::vector<unsigned char>>& seqs, std::vector<uint64_t>& win_start, cmph_t* hash,
+	size_t seq_begin, size_t seq_end, uint32_t interval, std::vector<kmer_occurrence>& occurrences)
+{
+	std::vector<unsigned char> seqr;
+	for (size_t i = seq_begin; i < seq_end; ++i)
+	{
+		seqr.assign(seqs[i].rbegin(), seqs[i].rend());
+		kmer_window win(seqs[i], seqr);
+		uint32_t numwin = (uint32_t)(win_start[i + 1] - win_start[i]);
+		uint32_t index_pos = 0;
+
+		for (uint32_t j = 0; j < numwin; j++)
+		{
+			// character array to hold an unsigned long long integer for CMPH
+			char a[38] = { 0 };
+			sprintf(a, "%llu", (win.key >> 2));
+			uint32_t id = cmph_search(hash, a, (cmph_uint32)strlen(a));
+			occurrences[win_start[i] + j] = { id, { index_pos, (uint32_t)i } };
+
+			if (j != numwin - 1)
+			{
+				win.shift(interval);
+				index_pos += interval;
+			}
+		}
+	}
+}//~find_kmer_ids
+
+/*
+ * add the MPHF ids to the mini-burst tries. The 9-mers are sharded between the threads as in 'insert_kmers'
+ */
+static void add_kmer_ids(std::vector<std::vector<unsigned char>>& seqs, kmer* lookup_table,
+	uint32_t shard, uint32_t num_shards, uint32_t interval, std::vector<kmer_occurrence>& occurrences)
+{
+	std::vector<unsigned char> seqr;
+	uint64_t ordinal = 0;
+	for (auto& seq : seqs)
+	{
+		seqr.assign(seq.rbegin(), seq.rend());
+		kmer_window win(seq, seqr);
+		uint32_t numwin = ((uint32_t)seq.size() - pread_gv + interval) / interval;
+
+		for (uint32_t j = 0; j < numwin; j++, ordinal++)
+		{
+			uint32_t id = occurrences[ordinal].id;
+			if (win.key_short_f % num_shards == shard)
+				add_id_to_burst_trie(lookup_table[win.key_short_f].trie_F, win.key_short_f_p, id);
+			if (win.key_short_r % num_shards == shard)
+				add_id_to_burst_trie(lookup_table[win.key_short_r].trie_R, win.key_short_r_rp, id);
+
+			if (j != numwin - 1) win.shift(interval);
+		}
+	}
+}//~add_kmer_ids
+
 int build_index(Runopts& opts)
 {
 	std::stringstream ss;
@@ -1330,9 +1672,6 @@ int build_index(Runopts& opts)
 
 			memset(lookup_table, 0, (1 << opts.seed_win_len) * sizeof(kmer));
 
-			// bool vector to keep track which L/2-mers have been counted for by the forward sliding L/2-mer window
-			std::vector<bool> incremented_by_forward((1 << opts.seed_win_len));
-
 			// total size of index so far in bytes
 			index_size = 0;
 
@@ -1355,7 +1694,8 @@ int build_index(Runopts& opts)
 			// we store all unique 18-mer positions (not 19-mer) because if an 18-mer on a read matches exactly to the prefix
 			// or suffix of a 19-mer in the mini-burst trie, we need to recover all of the 18-mer occurrences in the database
 			//
-			// read the reads file char by char
+			// read the reads file char by char and collect the encoded sequences of this part
+			std::vector<std::vector<unsigned char>> seqs;
 			do
 			{
 				// start of current sequence in file
@@ -1365,9 +1705,8 @@ int build_index(Runopts& opts)
 				// scan to end of header name
 				while (nt != '\n') nt = fgetc(fp);
 
-				unsigned char* myseq = new unsigned char[maxlen];
-				unsigned char* myseqr = new unsigned char[maxlen];
-				uint32_t _j = 0;
+				std::vector<unsigned char> myseq;
+				myseq.reserve(maxlen);
 				len = 0;
 
 				nt = fgetc(fp);
@@ -1379,7 +1718,7 @@ int build_index(Runopts& opts)
 					{
 						len++;
 						// exact character
-						myseq[_j++] = map_nt[nt];
+						myseq.push_back(map_nt[nt]);
 					}
 					nt = fgetc(fp);
 				}
@@ -1435,121 +1774,7 @@ int build_index(Runopts& opts)
 					numseq_part++;
 				}
 
-				// create a reverse sequence using the forward
-				unsigned char* ptr = &myseq[len - 1];
-
-				for (_j = 0; _j < len; _j++) myseqr[_j] = *ptr--;
-				// 9-mer prefix of 19-mer
-				uint32_t kmer_key_short_f = 0;
-				// 9-mer suffix of 19-mer
-				uint32_t kmer_key_short_r = 0;
-				// pointer to next letter to add to 9-mer prefix
-				unsigned char* kmer_key_short_f_p = &myseq[0];
-				// pointer to next letter to add to 9-mer suffix
-				unsigned char* kmer_key_short_r_p = &myseq[partialwin_gv + 1];
-				// pointer to 10-mer of reverse 19-mer to insert
-				// into the mini-burst trie
-				unsigned char* kmer_key_short_r_rp = &myseqr[len - partialwin_gv - 1];
-				// 19-mer
-				unsigned long long int kmer_key = 0;
-				// pointer to 19-mer
-				unsigned char* kmer_key_ptr = &myseq[0];
-
-				// initialize the prefix and suffix 9-mers
-				for (uint32_t j = 0; j < partialwin_gv; j++)
-				{
-					(kmer_key_short_f <<= 2) |= (int)*kmer_key_short_f_p++;
-					(kmer_key_short_r <<= 2) |= (int)*kmer_key_short_r_p++;
-				}
-
-				// initialize the 19-mer
-				for (uint32_t j = 0; j < pread_gv; j++) (kmer_key <<= 2) |= (int)*kmer_key_ptr++;
-
-				uint32_t numwin = (len - pread_gv + opts.interval) / opts.interval; //TESTING
-				uint32_t index_pos = 0;
-
-				// for all 19-mers on the sequence
-				for (uint32_t j = 0; j < numwin; j++) //TESTING
-				{
-					lookup_table[kmer_key_short_f].count++;
-					incremented_by_forward[kmer_key_short_f] = true;
-					// increment 9-mer count only if it wasn't already
-					// incremented by kmer_key_short_f before
-					if (!incremented_by_forward[kmer_key_short_r]) lookup_table[kmer_key_short_r].count++;
-
-					// ****** add the forward 19-mer
-
-					// new position for 18-mer in positions_tbl
-					bool new_position = true;
-
-					// forward 19-mer does not exist in the burst trie (duplicates not allowed)
-					if (lookup_table[kmer_key_short_f].trie_F == NULL ||
-						(lookup_table[kmer_key_short_f].trie_F != NULL && 
-						!search_burst_trie(lookup_table[kmer_key_short_f].trie_F, kmer_key_short_f_p, new_position)))
-					{
-						// create a trie node if it doesn't exist
-						if (lookup_table[kmer_key_short_f].trie_F == NULL)
-						{
-							lookup_table[kmer_key_short_f].trie_F = (NodeElement*)malloc(4 * sizeof(NodeElement));
-							if (lookup_table[kmer_key_short_f].trie_F == NULL)
-							{
-								std::cerr << RED << "  ERROR" << COLOFF << ": could not allocate memory for trie_node in indexdb.cpp" << std::endl;
-								exit(EXIT_FAILURE);
-							}
-							memset(lookup_table[kmer_key_short_f].trie_F, 0, 4 * sizeof(NodeElement));
-						}
-
-						insert_prefix(lookup_table[kmer_key_short_f].trie_F, kmer_key_short_f_p);
-					}
-
-					// 18-mer doesn't exist in the burst trie, add it to keys file
-					if (new_position)
-					{
-						// increment number of unique 18-mers
-						number_elements++;
-						fprintf(keys, "%llu\n", (kmer_key >> 2));
-					}
-
-					// ****** add the reverse 19-mer
-					new_position = true;
-
-					// reverse 19-mer does not exist in the burst trie
-					if (lookup_table[kmer_key_short_r].trie_R == NULL ||
-						((lookup_table[kmer_key_short_r].trie_R != NULL) && 
-						!search_burst_trie(lookup_table[kmer_key_short_r].trie_R, kmer_key_short_r_rp, new_position)))
-					{
-						// create a trie node if it doesn't exist
-						if (lookup_table[kmer_key_short_r].trie_R == NULL)
-						{
-							lookup_table[kmer_key_short_r].trie_R = (NodeElement*)malloc(4 * sizeof(NodeElement));
-							if (lookup_table[kmer_key_short_r].trie_R == NULL)
-							{
-								std::cerr << RED << "  ERROR" << COLOFF << ": could not allocate memory for trie_node in indexdb.cpp" << std::endl;
-								exit(EXIT_FAILURE);
-							}
-							memset(lookup_table[kmer_key_short_r].trie_R, 0, 4 * sizeof(NodeElement));
-						}
-
-						insert_prefix(lookup_table[kmer_key_short_r].trie_R, kmer_key_short_r_rp);
-					}
-
-					// shift 19-mer window and both 9-mers
-					if (j != numwin - 1)
-					{
-						for (uint32_t shift = 0; shift < opts.interval; shift++)
-						{
-							((kmer_key_short_f <<= 2) &= mask32) |= (int)*kmer_key_short_f_p++;
-							((kmer_key_short_r <<= 2) &= mask32) |= (int)*kmer_key_short_r_p++;
-							((kmer_key <<= 2) &= mask64) |= (int)*kmer_key_ptr++;
-							kmer_key_short_r_rp--;
-							index_pos++;
-						}
-					}
-				}//~for all 19-mers on the sequence
-
-				delete[] myseq;
-				delete[] myseqr;
-
+				seqs.push_back(std::move(myseq));
 			} while (nt != EOF); // end of reads file
 
 			// no index can be created, all reference sequences are too large to fit alone into maximum memory
@@ -1560,8 +1785,29 @@ int build_index(Runopts& opts)
 					"with the current memory limit of ", opts.max_file_size, " Mbytes.\n");
 				break;
 			}
-			// continue to build hash and positions tables
-			else index_size = 0;
+
+			// add the 19-mers into the burst tries, each thread on its share of the 9-mers
+			uint32_t num_threads = opts.num_proc_thread > 0 ? opts.num_proc_thread : 1;
+			std::vector<std::vector<std::pair<uint64_t, uint64_t>>> new_keys(num_threads);
+			{
+				std::vector<std::thread> tpool;
+				for (uint32_t t = 0; t < num_threads; ++t)
+					tpool.emplace_back(std::thread(insert_kmers, std::ref(seqs), lookup_table, t, num_threads, opts.interval, std::ref(new_keys[t])));
+				for (auto& thr : tpool) thr.join();
+			}
+
+			// unique 18-mers in the order they were met on the sequences. The order defines the MPHF ids
+			std::vector<std::pair<uint64_t, uint64_t>> keys_ordered;
+			for (auto& shard_keys : new_keys)
+			{
+				keys_ordered.insert(keys_ordered.end(), shard_keys.begin(), shard_keys.end());
+				std::vector<std::pair<uint64_t, uint64_t>>().swap(shard_keys);
+			}
+			std::sort(keys_ordered.begin(), keys_ordered.end());
+			number_elements = (uint32_t)keys_ordered.size();
+			for (auto const& key : keys_ordered)
+				fprintf(keys, "%llu\n", (unsigned long long)key.second);
+			std::vector<std::pair<uint64_t, uint64_t>>().swap(keys_ordered);
 
 			rewind(keys);
 
@@ -1613,151 +1859,41 @@ int build_index(Runopts& opts)
 			if (opts.is_verbose)
 				INFO_NS("    (3/3) building position lookup tables ..");
 
-			// positions_tbl[kmer_id] will return a pointer to an array of pairs, each pair
-			// stores the sequence number and index on the sequence of the kmer_id 19-mer
-			kmer_origin* positions_tbl = NULL;
+			// ordinal of the first 19-mer window of each sequence
+			std::vector<uint64_t> win_start(seqs.size() + 1, 0);
+			for (size_t s = 0; s < seqs.size(); ++s)
+				win_start[s + 1] = win_start[s] + (seqs[s].size() - pread_gv + opts.interval) / opts.interval;
 
-			positions_tbl = (kmer_origin*)malloc(number_elements * sizeof(kmer_origin));
-			if (positions_tbl == NULL)
-			{
-				ERR("could not allocate memory for positions_tbl (main(), indexdb.cpp)");
-				exit(EXIT_FAILURE);
-			}
-
-			memset(positions_tbl, 0, number_elements * sizeof(kmer_origin));
-
-			// sequence number
-			uint32_t i = 0;
-
-			// reset the file pointer to the beginning of the current part
-			fseek(fp, start_part, SEEK_SET);
+			// occurrences of the 19-mers in the order of the sequences. Used to
+			// build the positions table, which for each kmer_id stores the sequence number
+			// and index on the sequence of the kmer_id 19-mer
+			std::vector<kmer_occurrence> occurrences(win_start.back());
 
 			//TIME(start);
 			st = std::chrono::high_resolution_clock::now();
-			do
 			{
-				long int start_seq = ftell(fp);
-				nt = fgetc(fp);
-
-				//cout << ">"; //TESTING2
-
-				// scan to end of header name
-				while (nt != '\n')
-				{
-					nt = fgetc(fp);
-					// if ( nt != '\n' ) cout << (char)nt; //TESTING
-				}
-
-				unsigned char* myseq = new unsigned char[maxlen];
-				unsigned char* myseqr = new unsigned char[maxlen];
-				uint32_t _j = 0;
-				len = 0;
-
-				// encode each sequence using integer alphabet {0,1,2,3}
-				nt = fgetc(fp);
-				while (nt != '>' && nt != EOF)
-				{
-					// skip line feed, carriage return or empty space in the sequence
-					if (nt != '\n' && nt != ' ')
-					{
-						len++;
-						// exact character
-						myseq[_j++] = map_nt[nt];
-					}
-					nt = fgetc(fp);
-				}
-
-				// put back the >
-				if (nt != EOF) ungetc(nt, fp);
-
-				// check the addition of this sequence will not overflow the maximum memory
-				double estimated_seq_mem = (len - pread_gv + 1)*9.5e-6;
-
-				// the sequence alone is too large, it will not fit into maximum memory, skip it
-				if (estimated_seq_mem > opts.max_file_size) continue;
-				// the additional sequence will overflow the maximum index memory,
-				// write existing index to disk and start a new index
-				else if (index_size + estimated_seq_mem > opts.max_file_size)
-				{
-					// set the character to something other than EOF
-					if (nt == EOF) nt = 'A';
-
-					// scan back to start of sequence for next index part
-					fseek(fp, start_seq, SEEK_SET);
-					break;
-				}
-				// add the additional sequence to the index
-				else
-				{
-					index_size += estimated_seq_mem;
-				}
-
-				// create a reverse sequence using the forward
-				unsigned char* ptr = &myseq[len - 1];
-
-				for (_j = 0; _j < len; _j++) myseqr[_j] = *ptr--;
-
-				uint32_t kmer_key_short_f = 0;
-				uint32_t kmer_key_short_r = 0;
-				unsigned char* kmer_key_short_f_p = &myseq[0];
-				unsigned char* kmer_key_short_r_p = &myseq[partialwin_gv + 1];
-				unsigned char* kmer_key_short_r_rp = &myseqr[len - partialwin_gv - 1];
-				unsigned long long int kmer_key = 0;
-				unsigned char* kmer_key_ptr = &myseq[0];
-
-				// initialize the 9-mers
-				for (uint32_t j = 0; j < partialwin_gv; j++)
+				// the sequences are split between the threads by the number of windows
+				std::vector<std::thread> tpool;
+				size_t seq_begin = 0;
+				for (uint32_t t = 0; t < num_threads; ++t)
 				{
-					(kmer_key_short_f <<= 2) |= (int)*kmer_key_short_f_p++;
-					(kmer_key_short_r <<= 2) |= (int)*kmer_key_short_r_p++;
+					uint64_t win_end = win_start.back() * (t + 1) / num_threads;
+					size_t seq_end = std::lower_bound(win_start.begin(), win_start.end(), win_end) - win_start.begin();
+					seq_end = std::min(seq_end, seqs.size());
+					tpool.emplace_back(std::thread(find_kmer_ids, std::ref(seqs), std::ref(win_start), hash, seq_begin, seq_end, opts.interval, std::ref(occurrences)));
+					seq_begin = seq_end;
 				}
+				for (auto& thr : tpool) thr.join();
+				tpool.clear();
 
-				// initialize the 19-mer
-				for (uint32_t j = 0; j < pread_gv; j++)
-					(kmer_key <<= 2) |= (int)*kmer_key_ptr++;
-
-				uint32_t numwin = (len - pread_gv + opts.interval) / opts.interval; //TESTING
-				uint32_t id = 0;
-
-				uint32_t index_pos = 0; //TESTING
-
-				// for all 19-mers on the sequence
-				for (uint32_t j = 0; j < numwin; j++) //TESTING
-				{
-					// character array to hold an unsigned long long integer for CMPH
-					char a[38] = { 0 };
-					sprintf(a, "%llu", (kmer_key >> 2));
-					const char *key = a;
-					id = cmph_search(hash, key, (cmph_uint32)strlen(key));
-
-					//cout << "\t" << id << "=" << (kmer_key>>2); //TESTING
-
-					add_id_to_burst_trie(lookup_table[kmer_key_short_f].trie_F, kmer_key_short_f_p, id);
-					add_id_to_burst_trie(lookup_table[kmer_key_short_r].trie_R, kmer_key_short_r_rp, id);
-
-					add_kmer_to_table(positions_tbl + id, i, index_pos, opts.max_pos);
-
-					// shift the 19-mer and 9-mers
-					if (j != numwin - 1)
-					{
-						for (uint32_t shift = 0; shift < opts.interval; shift++)
-						{
-							((kmer_key_short_f <<= 2) &= mask32) |= (int)*kmer_key_short_f_p++;
-							((kmer_key_short_r <<= 2) &= mask32) |= (int)*kmer_key_short_r_p++;
-							((kmer_key <<= 2) &= mask64) |= (int)*kmer_key_ptr++;
-							kmer_key_short_r_rp--;
-							index_pos++;
-						}
-					}
-				} 
-
-				delete[] myseq;
-				delete[] myseqr;
-
-				// next sequence
-				i++;
+				for (uint32_t t = 0; t < num_threads; ++t)
+					tpool.emplace_back(std::thread(add_kmer_ids, std::ref(seqs), lookup_table, t, num_threads, opts.interval, std::ref(occurrences)));
+				for (auto& thr : tpool) thr.join();
+			}
 
-			} while (nt != EOF); // for all file     
+			// sequence number
+			uint32_t i = (uint32_t)seqs.size();
+			std::vector<std::vector<unsigned char>>().swap(seqs);
 
 			if (opts.is_verbose) {
 				elapsed = std::chrono::high_resolution_clock::now() - st;
@@ -1768,6 +1904,12 @@ int build_index(Runopts& opts)
 			// Destroy hash
 			cmph_destroy(hash);
 
+			std::vector<uint64_t> pos_offset;
+			std::vector<seq_pos> pos_arr;
+			build_positions_table(occurrences, number_elements, opts.max_pos, num_threads, pos_offset, pos_arr);
+			std::vector<kmer_occurrence>().swap(occurrences);
+			kmer_positions positions_tbl = { pos_offset.data(), pos_arr.data() };
+
 			// *********** Check ID's in Burst trie are correct *****
 
 			// TESTING
@@ -1966,6 +2108,7 @@ int build_index(Runopts& opts)
 			}
 
 			index_parts_stats thispart;
+			memset(&thispart, 0, sizeof(index_parts_stats)); // no garbage in the padding written to the stats file
 			thispart.start_part = start_part;
 			thispart.seq_part_size = seq_part_size;
 			thispart.numseq_part = numseq_part;
@@ -2001,18 +2144,27 @@ int build_index(Runopts& opts)
 			// the positions
 			for (uint32_t j = 0; j < number_elements; j++)
 			{
-				uint32_t size = positions_tbl[j].size;
+				uint32_t size = positions_tbl.size(j);
 				ospos.write(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
-				ospos.write(reinterpret_cast<const char*>(positions_tbl[j].arr), sizeof(seq_pos)*size);
+				ospos.write(reinterpret_cast<const char*>(positions_tbl.begin(j)), sizeof(seq_pos)*size);
 			}
 			ospos.close();
 
-			// Free malloc'd memory
-			// Table of unique 19-mer positions
-			for (uint32_t z = 0; z < number_elements; z++)
-				free(positions_tbl[z].arr);
-			free(positions_tbl);
+			// 4. all of the above in a single pointer-free file for mapping into memory
+			idx_file = idxpair.second + ".mmap_" + part_str + ".dat";
+			if (opts.is_verbose) {
+				INFO_NS("      writing mappable index to ", idx_file.data(), "\n");
+			}
+			write_mmap_index(idx_file, lookup_table, (uint32_t)(1 << opts.seed_win_len), positions_tbl, number_elements);
 
+			// 5. the part's references encoded for the alignment and the reports
+			idx_file = idxpair.second + ".refs_" + part_str + ".dat";
+			if (opts.is_verbose) {
+				INFO_NS("      writing reference store to ", idx_file.data(), "\n");
+			}
+			References::write_store(idxpair.first, start_part, numseq_part, idx_file);
+
+			// Free malloc'd memory
 			// 9-mer look-up table and mini-burst tries
 			for (uint32_t z = 0; z < (uint32_t)(1 << opts.seed_win_len); z++)
 			{
@@ -0,0 +1,366 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/**
+ * FILE: inflater.cpp
+ * Created: Oct 16, 2026 Fri
+ */
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include "zlib.h"
+#include "inflater.hpp"
+#include "common.hpp"
+
+struct Inflater::Ring {
+	std::mutex lock;
+	std::condition_variable cv;
+	std::vector<Block> blocks;
+	std::deque<Block*> full; // inflated blocks in the order of the stream
+	std::deque<Block*> free;
+	bool is_stop = false;
+
+	Ring() : blocks(NUM_BLOCKS)
+	{
+		for (auto& blk : blocks) {
+			blk.data.resize(BLOCK_SIZE);
+			free.push_back(&blk);
+		}
+	}
+
+	// wait for a free block. Null if stopped
+	Block* get_free()
+	{
+		std::unique_lock<std::mutex> lk(lock);
+		cv.wait(lk, [this] { return !free.empty() || is_stop; });
+		if (is_stop) return nullptr;
+		auto blk = free.front();
+		free.pop_front();
+		blk->size = 0;
+		blk->status = RL_OK;
+		return blk;
+	}
+
+	void push_full(Block* blk)
+	{
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			full.push_back(blk);
+		}
+		cv.notify_all();
+	}
+
+	// wait for an inflated block. Null if stopped
+	Block* pop_full()
+	{
+		std::unique_lock<std::mutex> lk(lock);
+		cv.wait(lk, [this] { return !full.empty() || is_stop; });
+		if (is_stop) return nullptr;
+		auto blk = full.front();
+		full.pop_front();
+		return blk;
+	}
+
+	void release(Block* blk)
+	{
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			free.push_back(blk);
+		}
+		cv.notify_all();
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			is_stop = true;
+		}
+		cv.notify_all();
+	}
+}; // ~struct Inflater::Ring
+
+Inflater::Inflater() : num_threads(1), block(nullptr), pos(0) {}
+
+Inflater::~Inflater() { stop(); }
+Inflater::Inflater(Inflater&&) noexcept = default;
+Inflater& Inflater::operator=(Inflater&&) noexcept = default;
+
+void Inflater::init(unsigned num_threads)
+{
+	stop();
+	this->num_threads = std::max(1U, num_threads);
+}
+
+int Inflater::reset_inflate()
+{
+	stop();
+	return Z_OK;
+}
+
+void Inflater::stop()
+{
+	if (reader) {
+		ring->stop();
+		reader->join();
+		reader.reset();
+	}
+	ring.reset();
+	block = nullptr;
+	pos = 0;
+}
+
+int Inflater::getline(std::ifstream& ifs, std::string& line)
+{
+	line.clear();
+
+	if (!reader) {
+		ring = std::make_unique<Ring>();
+		reader = std::make_unique<std::thread>(&Inflater::run, ring.get(), &ifs, num_threads);
+	}
+
+	for (;;) {
+		if (!block) {
+			block = ring->pop_full();
+			pos = 0;
+			if (!block) return RL_END;
+		}
+
+		if (pos < block->size) {
+			auto start = block->data.data() + pos;
+			auto len = block->size - pos;
+			auto end = static_cast<const char*>(std::memchr(start, '\n', len));
+			if (end) {
+				line.append(start, end - start);
+				pos += end - start + 1; // skip '\n'
+				return RL_OK;
+			}
+			line.append(start, len);
+			pos = block->size;
+		}
+
+		// the block is used up. The last block of the stream stays to return the same status on the following calls
+		if (block->status != RL_OK) return block->status;
+		ring->release(block);
+		block = nullptr;
+	}
+} // ~Inflater::getline
+
+/*
+ * check the gzip header is a BGZF header i.e. has the 'BC' extra subfield
+ * @return  size of the member, 0 if not a BGZF member
+ */
+static std::size_t bgzf_member_size(const unsigned char* buf, std::size_t len)
+{
+	if (len < 18 || buf[0] != 0x1f || buf[1] != 0x8b || buf[2] != 8 || (buf[3] & 4) == 0)
+		return 0;
+	std::size_t xlen = buf[10] | (buf[11] << 8);
+	for (std::size_t i = 12; i + 4 <= 12 + xlen && i + 4 <= len; ) {
+		std::size_t slen = buf[i + 2] | (buf[i + 3] << 8);
+		if (buf[i] == 'B' && buf[i + 1] == 'C' && slen == 2 && i + 6 <= len)
+			return (std::size_t)(buf[i + 4] | (buf[i + 5] << 8)) + 1;
+		i += 4 + slen;
+	}
+	return 0;
+}
+
+/*
+ * background thread. Inflates the stream into the blocks of the ring
+ */
+void Inflater::run(Ring* ring, std::ifstream* ifs, unsigned num_threads)
+{
+	std::vector<char> zbuf(BLOCK_SIZE); // compressed data
+	ifs->read(zbuf.data(), zbuf.size());
+	std::size_t zlen = ifs->gcount();
+	if (!ifs->eof() && ifs->fail()) {
+		ERR("failed reading the compressed stream");
+		zlen = 0;
+	}
+	if (num_threads > 1 && bgzf_member_size(reinterpret_cast<unsigned char*>(zbuf.data()), zlen) > 0)
+		run_bgzf(*ring, *ifs, zbuf, zlen, num_threads);
+	else
+		run_serial(*ring, *ifs, zbuf, zlen);
+} // ~Inflater::run
+
+/*
+ * inflate the stream on the calling thread. Concatenated gzip members are inflated one after another
+ */
+void Inflater::run_serial(Ring& ring, std::ifstream& ifs, std::vector<char>& zbuf, std::size_t zlen)
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(z_stream));
+	if (inflateInit2(&strm, 47) != Z_OK) { // gzip or zlib header
+		ERR("inflateInit2 failed");
+		exit(EXIT_FAILURE);
+	}
+	strm.next_in = reinterpret_cast<Bytef*>(zbuf.data());
+	strm.avail_in = (uInt)zlen;
+
+	auto blk = ring.get_free();
+	for (; blk; ) {
+		// IN buffer empty - fill up with more data
+		if (strm.avail_in == 0) {
+			if (ifs.eof()) break;
+			ifs.read(zbuf.data(), zbuf.size());
+			if (!ifs.eof() && ifs.fail()) {
+				blk->status = RL_ERR;
+				break;
+			}
+			strm.next_in = reinterpret_cast<Bytef*>(zbuf.data());
+			strm.avail_in = (uInt)ifs.gcount();
+			if (strm.avail_in == 0) break;
+		}
+
+		strm.next_out = reinterpret_cast<Bytef*>(blk->data.data() + blk->size);
+		strm.avail_out = (uInt)(BLOCK_SIZE - blk->size);
+		auto ret = inflate(&strm, Z_NO_FLUSH);
+		blk->size = BLOCK_SIZE - strm.avail_out;
+
+		if (ret == Z_STREAM_END) {
+			inflateReset(&strm); // next member if any
+		}
+		else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+			ERR("inflate failed. Error: ", ret);
+			blk->status = RL_ERR;
+			break;
+		}
+
+		if (blk->size == BLOCK_SIZE) {
+			ring.push_full(blk);
+			blk = ring.get_free();
+		}
+	}
+	inflateEnd(&strm);
+
+	if (blk) {
+		if (blk->status == RL_OK) blk->status = RL_END;
+		ring.push_full(blk);
+	}
+} // ~Inflater::run_serial
+
+/*
+ * inflate the BGZF members in parallel. The inflated size of each member is stored at its end,
+ * so the members are inflated directly into their places in the block.
+ */
+void Inflater::run_bgzf(Ring& ring, std::ifstream& ifs, std::vector<char>& zbuf, std::size_t zlen, unsigned num_threads)
+{
+	struct Member {
+		std::size_t zpos; // position in the compressed buffer
+		std::size_t zsize;
+		std::size_t pos; // position in the block
+		std::size_t size;
+	};
+	std::vector<Member> members;
+	std::vector<std::thread> workers;
+	std::atomic<bool> is_error(false);
+	bool is_eof = ifs.eof();
+
+	for (;;) {
+		// the members fitting into a block
+		members.clear();
+		std::size_t zpos = 0, pos = 0;
+		for (;;) {
+			auto zbeg = reinterpret_cast<unsigned char*>(zbuf.data()) + zpos;
+			auto msize = bgzf_member_size(zbeg, zlen - zpos);
+			if (msize == 0 || zpos + msize > zlen) break;
+			std::size_t size = zbeg[msize - 4] | (zbeg[msize - 3] << 8) | (zbeg[msize - 2] << 16) | ((std::size_t)zbeg[msize - 1] << 24);
+			if (pos + size > BLOCK_SIZE) break;
+			members.push_back({ zpos, msize, pos, size });
+			zpos += msize;
+			pos += size;
+		}
+
+		auto blk = ring.get_free();
+		if (!blk) return;
+
+		if (members.empty()) {
+			// end of the stream, or not a BGZF member
+			if (zlen > 0) {
+				ERR("not a BGZF member at the end of the compressed stream");
+				blk->status = RL_ERR;
+			}
+			else
+				blk->status = RL_END;
+			ring.push_full(blk);
+			return;
+		}
+
+		auto inflate_members = [&](unsigned id) {
+			z_stream strm;
+			memset(&strm, 0, sizeof(z_stream));
+			inflateInit2(&strm, 31); // gzip
+			for (std::size_t i = id; i < members.size() && !is_error; i += num_threads) {
+				auto const& mem = members[i];
+				inflateReset(&strm);
+				strm.next_in = reinterpret_cast<Bytef*>(zbuf.data() + mem.zpos);
+				strm.avail_in = (uInt)mem.zsize;
+				strm.next_out = reinterpret_cast<Bytef*>(blk->data.data() + mem.pos);
+				strm.avail_out = (uInt)mem.size;
+				if (inflate(&strm, Z_FINISH) != Z_STREAM_END || strm.avail_out != 0) is_error = true;
+			}
+			inflateEnd(&strm);
+		};
+		for (unsigned i = 1; i < num_threads; ++i) {
+			workers.emplace_back(inflate_members, i);
+		}
+		inflate_members(0);
+		for (auto& thr : workers) {
+			thr.join();
+		}
+		workers.clear();
+
+		blk->size = pos;
+		if (is_error) {
+			ERR("failed inflating a BGZF member");
+			blk->status = RL_ERR;
+			ring.push_full(blk);
+			return;
+		}
+		ring.push_full(blk);
+
+		// move the remaining compressed data to the start of the buffer, and fill up the buffer
+		std::memmove(zbuf.data(), zbuf.data() + zpos, zlen - zpos);
+		zlen -= zpos;
+		if (!is_eof) {
+			ifs.read(zbuf.data() + zlen, zbuf.size() - zlen);
+			zlen += ifs.gcount();
+			is_eof = ifs.eof();
+			if (!is_eof && ifs.fail()) {
+				ERR("failed reading the compressed stream");
+				is_eof = true;
+			}
+		}
+	}
+} // ~Inflater::run_bgzf
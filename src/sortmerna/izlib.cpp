@@ -74,7 +74,7 @@ Izlib::Izlib(bool is_compress, bool is_init)
 /*
  * Called from constructor
  */
-void Izlib::init(bool is_compress)
+void Izlib::init(bool is_compress, int level)
 {
 	int windowBits = 15;
 	int GZIP_ENCODING = 16;
@@ -87,7 +87,7 @@ void Izlib::init(bool is_compress)
 	strm.next_in = Z_NULL;
 	// use deflateInit2 and inflateInit2 to output/input gzip format
 	int ret = is_compress 
-		? deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits | GZIP_ENCODING, memLevel, Z_DEFAULT_STRATEGY)
+		? deflateInit2(&strm, level, Z_DEFLATED, windowBits | GZIP_ENCODING, memLevel, Z_DEFAULT_STRATEGY)
 		: inflateInit2(&strm, 47);
 	if (ret != Z_OK) {
 		ERR("Izlib::init failed. Error: " , ret);
@@ -107,6 +107,11 @@ void Izlib::init(bool is_compress)
 	std::fill(z_out.begin(), z_out.end(), 0); // fill OUT buffer with 0s
 } // ~Izlib::init
 
+bool Izlib::is_pending() const
+{
+	return strm.total_in > 0 || strm.avail_in > 0;
+}
+
 int Izlib::reset_deflate() {
 	return deflateEnd(&strm);
 }
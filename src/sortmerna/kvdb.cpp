@@ -38,8 +38,13 @@
 #include <iostream>
 #include <filesystem>
 
-KeyValueDatabase::KeyValueDatabase(std::string const &kvdbPath) 
+KeyValueDatabase::KeyValueDatabase(std::string const &kvdbPath, KVDB_TYPE type) : kvdb(NULL)
 {
+	if (type == KVDB_TYPE::MMAP) {
+		store = std::make_unique<Resultstore>(kvdbPath);
+		return;
+	}
+
 	// init and open key-value database for read matches
 	options.IncreaseParallelism();
 #if defined(_WIN32)
@@ -48,10 +53,19 @@ KeyValueDatabase::KeyValueDatabase(std::string const &kvdbPath)
 	options.compression = rocksdb::kZlibCompression;
 #endif
 	options.create_if_missing = true;
+	batch_options.disableWAL = true;
 	rocksdb::Status s = rocksdb::DB::Open(options, kvdbPath, &kvdb);
 	assert(s.ok());
 }
 
+KeyValueDatabase::~KeyValueDatabase()
+{
+	if (kvdb == NULL) return;
+	// the batched writes bypass the WAL - persist the memtables before closing
+	kvdb->Flush(rocksdb::FlushOptions());
+	delete kvdb;
+}
+
 /* 
  * Remove database files from the given location
  */
@@ -62,12 +76,49 @@ int KeyValueDatabase::clear(std::string dbpath)
 
 void KeyValueDatabase::put(std::string key, std::string val)
 {
+	if (store) {
+		store->put(key, val);
+		return;
+	}
 	rocksdb::Status s = kvdb->Put(rocksdb::WriteOptions(), key, val);
 }
 
 std::string KeyValueDatabase::get(std::string key)
 {
+	if (store) return store->get(key);
 	std::string val;
 	rocksdb::Status s = kvdb->Get(rocksdb::ReadOptions(), key, &val);
 	return val;
-}
\ No newline at end of file
+}
+
+void KeyValueDatabase::write(rocksdb::WriteBatch& batch)
+{
+	rocksdb::Status s = kvdb->Write(batch_options, &batch);
+	if (!s.ok()) {
+		ERR("failed writing batch of ", batch.Count(), " puts: ", s.ToString());
+		exit(EXIT_FAILURE);
+	}
+	batch.Clear();
+}
+
+void KeyValueDatabase::multi_get(const std::vector<std::string>& keys, std::vector<std::string>& vals)
+{
+	if (store) {
+		vals.resize(keys.size());
+		for (std::size_t i = 0; i < keys.size(); ++i)
+			vals[i] = store->get(keys[i]);
+		return;
+	}
+	std::vector<rocksdb::Slice> slices(keys.begin(), keys.end());
+	auto stats = kvdb->MultiGet(rocksdb::ReadOptions(), slices, &vals);
+	for (std::size_t i = 0; i < stats.size(); ++i) {
+		if (stats[i].ok()) continue;
+		if (stats[i].IsNotFound()) {
+			vals[i].clear(); // same as 'get'
+		}
+		else {
+			ERR("failed reading key ", keys[i], ": ", stats[i].ToString());
+			exit(EXIT_FAILURE);
+		}
+	}
+}
@@ -74,8 +74,8 @@ int main(int argc, char** argv)
 		}
 
 		// init common objects
-		KeyValueDatabase kvdb(opts.kvdbdir.string());
-		Readfeed readfeed(opts.feed_type, opts.readfiles, opts.num_proc_thread, opts.readb_dir, opts.is_paired);
+		KeyValueDatabase kvdb(opts.kvdbdir.string(), opts.kvdb_type);
+		Readfeed readfeed(opts.feed_type, opts.readfiles, opts.num_proc_thread, opts.readb_dir, opts.is_paired, opts.split_zip);
 		Readstats readstats(readfeed.num_reads_tot, readfeed.length_all, readfeed.min_read_len, readfeed.max_read_len, kvdb, opts);
 
 		switch (opts.alirep)
@@ -86,26 +86,28 @@ int main(int argc, char** argv)
 			align(readfeed, readstats, index, kvdb, opts);
 			break;
 		case Runopts::ALIGN_REPORT::summary:
-			if (opts.is_otu_map || opts.is_denovo) denovo_stats(readfeed, readstats, kvdb, opts);
-			if (opts.is_otu_map) fill_otu_map(readfeed, readstats, kvdb, opts);
+			if (opts.is_otu_map || opts.is_denovo) postprocess(readfeed, readstats, kvdb, opts, true, false);
 			writeSummary(readstats, opts);
 			break;
 		case Runopts::ALIGN_REPORT::report:
-			writeReports(readfeed, readstats, kvdb, opts);
+			postprocess(readfeed, readstats, kvdb, opts, false, true);
 			break;
 		case Runopts::ALIGN_REPORT::alnsum:
 			align(readfeed, readstats, index, kvdb, opts);
-			if (opts.is_otu_map || opts.is_denovo) denovo_stats(readfeed, readstats, kvdb, opts);
-			if (opts.is_otu_map) fill_otu_map(readfeed, readstats, kvdb, opts);
+			if (opts.is_otu_map || opts.is_denovo) postprocess(readfeed, readstats, kvdb, opts, true, false);
 			writeSummary(readstats, opts);
 			break;
 		case Runopts::ALIGN_REPORT::all:
 			align(readfeed, readstats, index, kvdb, opts);
-			// TODO: combine processing otu map and reports to avoid double run through reads and refs (in this case only) 20201126
-			if (opts.is_otu_map || opts.is_denovo) denovo_stats(readfeed, readstats, kvdb, opts);
-			if (opts.is_otu_map) fill_otu_map(readfeed, readstats, kvdb, opts);
-			writeSummary(readstats, opts);
-			writeReports(readfeed, readstats, kvdb, opts);
+			if (opts.is_otu_map || opts.is_denovo) {
+				// denovo stats, OTU map and reports in a single run through the reads and refs
+				postprocess(readfeed, readstats, kvdb, opts, true, true);
+				writeSummary(readstats, opts);
+			}
+			else {
+				writeSummary(readstats, opts);
+				postprocess(readfeed, readstats, kvdb, opts, false, true);
+			}
 			break;
 		}
 	}
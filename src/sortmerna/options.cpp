@@ -1007,6 +1007,19 @@ void Runopts::opt_kvdb(const std::string& path) {
 	}
 }
 
+void Runopts::opt_kvdb_store(const std::string& val)
+{
+	KVDB_TYPE ktype = static_cast<KVDB_TYPE>(std::stoi(val));
+
+	if (ktype > KVDB_TYPE::MAX)
+	{
+		ERR("Option '", OPT_KVDB_STORE, "' can only take values in range [0..", static_cast<int>(KVDB_TYPE::MAX), "] Provided value is ['", val, "'");
+		exit(EXIT_FAILURE);
+	}
+
+	kvdb_type = ktype;
+} // ~Runopts::opt_kvdb_store
+
 void Runopts::opt_idxdir(const std::string& path) {
 	if (path.size() == 0)
 	{
@@ -1136,6 +1149,19 @@ void Runopts::opt_reads_feed(const std::string& val)
 	feed_type = ftype;
 } // ~Runopts::opt_reads_feed
 
+void Runopts::opt_split_zip(const std::string& val)
+{
+	SPLIT_ZIP ztype = static_cast<SPLIT_ZIP>(std::stoi(val));
+
+	if (ztype > SPLIT_ZIP::MAX)
+	{
+		ERR("Option '", OPT_SPLIT_ZIP, "' can only take values in range [0..", static_cast<int>(SPLIT_ZIP::MAX), "] Provided value is ['", val, "'");
+		exit(EXIT_FAILURE);
+	}
+
+	split_zip = ztype;
+} // ~Runopts::opt_split_zip
+
 void Runopts::opt_zip_out(const std::string& val)
 {
 	if (val.size() > 0) {
@@ -1150,6 +1176,11 @@ void Runopts::opt_zip_out(const std::string& val)
 	}
 }
 
+void Runopts::opt_resident(const std::string& val)
+{
+	is_resident = true;
+} // ~Runopts::opt_resident
+
 void Runopts::opt_index(const std::string& val)
 {
 	if (val.size() > 0) {
@@ -1494,7 +1525,7 @@ void Runopts::validate()
 {
 	validate_kvdbdir();
 	validate_idxdir();
-	if (feed_type == FEED_TYPE::SPLIT_READS)
+	if (feed_type == FEED_TYPE::SPLIT_READS || feed_type == FEED_TYPE::READB)
 		validate_readb_dir();
 	validate_aligned_pfx(); // there is always some output like log => validate
 	if (is_other) {
@@ -38,6 +38,9 @@
 #include <chrono>
 #include <thread> // std::this_thread
 #include <cmath> // std::floor
+#include <filesystem>
+#include <memory>
+#include <algorithm> // std::min, std::find_if
 
 #include "processor.hpp"
 #include "read.hpp"
@@ -47,6 +50,9 @@
 #include "readstats.hpp"
 #include "refstats.hpp"
 #include "options.hpp"
+#include "output.hpp"
+#include "otumap.h"
+#include "alignidx.hpp"
 //#include "readsqueue.hpp"
 
 // forward
@@ -59,20 +65,21 @@ void traverse(Runopts& opts, Index& index, References& refs, Readstats& readstat
 *  @param is_last_idx  flags the last index is being processed
 */
 void align2(int id, Readfeed& readfeed, Readstats& readstats, 
-			Index& index, References& refs, Refstats& refstats, KeyValueDatabase& kvdb, Runopts& opts)
+			Index& index, References& refs, Refstats& refstats, KeyValueDatabase& kvdb, Alignidx& alnidx, Runopts& opts)
 {
 	unsigned num_all = 0; // all reads this processor sees
 	unsigned num_skipped = 0; // reads already processed i.e. results found in Database
 	unsigned num_hit = 0; // count of reads with read.hit = true found by a single thread - just for logging
-	std::string readstr;
+	Readrec rec; // reused for all the reads
 
 	auto starts = std::chrono::high_resolution_clock::now();
 	INFO("Processor ", id, " thread ", std::this_thread::get_id(), " started");
-	int idx = id * readfeed.num_sense; // index into split files array
-	for (; readfeed.next(idx, readstr);)
+	std::vector<Read> reads; // a block of reads looked up in DB at once
+	KvdbBatch kvbatch(kvdb); // the results are written in batches
+	unsigned isplit = id; // own split first, then the blocks of the other splits
+	for (; readfeed.next_block(isplit, rec, reads, KeyValueDatabase::MULTI_GET_SIZE);)
 	{
-		{
-			Read read(readstr);
+		for (auto& read : reads) {
 			read.init(opts);
 			read.is_too_short = read.sequence.size() < refstats.lnwin[index.index_num];
 
@@ -80,11 +87,12 @@ void align2(int id, Readfeed& readfeed, Readstats& readstats,
 				read.isValid = false;
 				readstats.num_short.fetch_add(1, std::memory_order_relaxed);
 			}
+		}
 
-			if (read.isValid) {
-				read.load_db(kvdb);
-			}
+		Read::load_db(kvdb, reads); // valid reads only
 
+		for (auto& read : reads)
+		{
 			if (read.isEmpty || !read.isValid || read.is_done) {
 				if (read.is_done) {
 					++num_skipped;
@@ -118,15 +126,14 @@ void align2(int id, Readfeed& readfeed, Readstats& readstats,
 			if (read.isValid && !read.isEmpty)
 			{
 				if (read.is_hit) ++num_hit;
-				if (read.is_new_hit)
-					kvdb.put(read.id, read.toBinString());
+				if (read.is_new_hit) {
+					kvbatch.put(read.id, read.toBinString());
+					alnidx.add(id, read, index.index_num, index.part);
+				}
 			}
 
-			readstr.resize(0);
 			++num_all;
-		} // ~if & read destroyed
-
-		if (opts.is_paired) idx ^= 1; // switch FWD-REV
+		} // ~for reads in the block
 	} // ~while there are reads
 
 	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - starts;
@@ -135,6 +142,193 @@ void align2(int id, Readfeed& readfeed, Readstats& readstats,
 		" Aligned reads (passing E-value): ", num_hit, " Runtime sec: ", elapsed.count());
 } // ~align2
 
+/*
+* performs the alignment on all the index parts in a single pass over the reads
+*  runs in a thread.  align -> align_resident -> align2_resident
+*  All the index parts and references are already loaded. Each read is parsed, 
+*  loaded from DB, and stored to DB only once as opposed to once per index part in 'align2'
+*/
+void align2_resident(int id, Readfeed& readfeed, Readstats& readstats, std::vector<Index>& indices, 
+			std::vector<References>& refsv, Refstats& refstats, KeyValueDatabase& kvdb, Alignidx& alnidx, Runopts& opts)
+{
+	unsigned num_all = 0; // all reads this processor sees
+	unsigned num_skipped = 0; // reads already processed i.e. results found in Database
+	unsigned num_hit = 0; // count of reads with read.hit = true found by a single thread - just for logging
+	Readrec rec; // reused for all the reads
+
+	auto starts = std::chrono::high_resolution_clock::now();
+	INFO("Processor ", id, " thread ", std::this_thread::get_id(), " started");
+	std::vector<Read> reads; // a block of reads looked up in DB at once
+	KvdbBatch kvbatch(kvdb); // the results are written in batches
+	unsigned isplit = id; // own split first, then the blocks of the other splits
+	for (; readfeed.next_block(isplit, rec, reads, KeyValueDatabase::MULTI_GET_SIZE);)
+	{
+		for (auto& read : reads)
+			read.init(opts);
+
+		Read::load_db(kvdb, reads); // valid reads only
+
+		for (auto& read : reads)
+		{
+			++num_all;
+
+			if (read.isEmpty || !read.isValid || read.is_done) {
+				if (read.is_done) {
+					++num_skipped;
+				}
+				continue;
+			}
+
+			// search the forward and/or reverse strands depending on Run options
+			bool search_single_strand = opts.is_forward ^ opts.is_reverse; // search only a single strand
+			int num_strands = search_single_strand ? 1 : 2;
+
+			// the parts are ordered as in 'align' i.e. index 0 part 0, index 0 part 1, .., index N part M
+			// 'read' keeps the state that 'align2' would have stored to DB so far. Each part is searched
+			// on a copy of that state, exactly like 'align2' searches each part on a read loaded from DB
+			for (size_t i = 0; i < indices.size() && !read.is_done; ++i)
+			{
+				Read rpart(read);
+				rpart.is_new_hit = false;
+				rpart.best = opts.min_lis > 0 ? opts.min_lis : 0; // not stored in DB - see Read::init
+				rpart.is_too_short = rpart.sequence.size() < refstats.lnwin[indices[i].index_num];
+				if (rpart.is_too_short) {
+					// same as in 'align2' - the counter reflects the last index part only
+					if (i == indices.size() - 1)
+						readstats.num_short.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+
+				//                                                  |- stop if read was aligned on FWD strand
+				for (int count = 0; count < num_strands && !rpart.is_done; ++count)
+				{
+					if ((search_single_strand && opts.is_reverse) || count == 1)
+					{
+						if (!rpart.reversed)
+							rpart.revIntStr();
+					}
+
+					traverse(opts, indices[i], refsv[i], readstats, refstats, rpart, search_single_strand || count == 1); // 'paralleltraversal.cpp'
+					rpart.id_win_hits.clear(); // bug 46
+				}
+
+				if (rpart.is_new_hit) {
+					if (rpart.reversed)
+						rpart.revIntStr(); // keep the read on the forward strand for the next part
+					read = rpart;
+				}
+			} // ~for index parts
+
+			// write to DB - thread safe
+			if (read.is_hit) ++num_hit;
+			if (read.is_new_hit) {
+				kvbatch.put(read.id, read.toBinString());
+				alnidx.add(id, read);
+			}
+		} // ~for reads in the block
+	} // ~for reads
+
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - starts;
+	INFO("Processor ", id, " thread ", std::this_thread::get_id(), " done. Processed ",
+		num_all, " reads. Skipped already processed: ", num_skipped, " reads",
+		" Aligned reads (passing E-value): ", num_hit, " Runtime sec: ", elapsed.count());
+} // ~align2_resident
+
+/*
+* estimate the memory (bytes) necessary to keep all the index parts and references loaded.
+* The index parts and the references are mapped from the files '.mmap_N.dat' and '.refs_N.dat',
+* so the file sizes are counted, plus the look-up table and the reference records built on load.
+* A file not generated yet is estimated from the legacy index files and the reference sizes.
+*/
+static uint64_t resident_mem_estimate(Runopts& opts, Refstats& refstats)
+{
+	uint64_t mem = 0;
+	for (size_t idx_num = 0; idx_num < opts.indexfiles.size(); ++idx_num)
+	{
+		for (uint16_t idx_part = 0; idx_part < refstats.num_index_parts[idx_num]; ++idx_part)
+		{
+			auto const& idxpfx = opts.indexfiles[idx_num].second;
+			auto sfx = "_" + std::to_string(idx_part) + ".dat";
+			std::error_code ec;
+			auto mmap_sz = std::filesystem::file_size(idxpfx + ".mmap" + sfx, ec);
+			if (ec) {
+				mmap_sz = 0;
+				for (auto const& legacy : { ".kmer", ".bursttrie", ".pos" }) {
+					auto sz = std::filesystem::file_size(idxpfx + legacy + sfx, ec);
+					if (!ec) mmap_sz += sz;
+				}
+			}
+			mem += mmap_sz + ((uint64_t)1 << refstats.lnwin[idx_num]) * sizeof(kmer);
+
+			auto const& part_stats = refstats.index_parts_stats_vec[idx_num][idx_part];
+			auto refs_sz = std::filesystem::file_size(idxpfx + ".refs" + sfx, ec);
+			mem += (ec ? part_stats.seq_part_size : refs_sz) + part_stats.numseq_part * sizeof(References::BaseRecord);
+		}
+	}
+	return mem;
+} // ~resident_mem_estimate
+
+/*
+* load all the index parts and references, and run the alignment in a single pass over the reads.
+*  called from align
+*/
+static void align_resident(Readfeed& readfeed, Readstats& readstats, Refstats& refstats, KeyValueDatabase& kvdb, Alignidx& alnidx, Runopts& opts)
+{
+	std::vector<Index> indices;
+	std::vector<References> refsv;
+	std::vector<std::thread> tpool;
+	std::chrono::duration<double> elapsed;
+
+	size_t num_parts = 0;
+	for (size_t idx_num = 0; idx_num < opts.indexfiles.size(); ++idx_num)
+		num_parts += refstats.num_index_parts[idx_num];
+	indices.reserve(num_parts);
+	refsv.reserve(num_parts);
+	tpool.reserve(opts.num_proc_thread + 1);
+
+	auto start_i = std::chrono::high_resolution_clock::now();
+	for (size_t idx_num = 0; idx_num < opts.indexfiles.size(); ++idx_num)
+	{
+		for (uint16_t idx_part = 0; idx_part < refstats.num_index_parts[idx_num]; ++idx_part)
+		{
+			INFO("Loading index: ", idx_num, " part: ", idx_part + 1, "/", refstats.num_index_parts[idx_num], " Memory KB: ", (get_memory() >> 10), " ... ");
+			indices.emplace_back();
+			indices.back().load(idx_num, idx_part, opts.indexfiles, refstats);
+			refsv.emplace_back();
+			refsv.back().load(idx_num, idx_part, opts, refstats);
+		}
+	}
+	readstats.num_short.store(0, std::memory_order_relaxed); // reset the short reads counter
+	elapsed = std::chrono::high_resolution_clock::now() - start_i;
+	INFO_MEM("loaded ", num_parts, " index parts and references in [", elapsed.count(), "] sec");
+
+	start_i = std::chrono::high_resolution_clock::now();
+	if (opts.feed_type == FEED_TYPE::LOCKLESS)
+		tpool.emplace_back(std::thread(&Readfeed::run, std::ref(readfeed)));
+	for (int i = 0; i < opts.num_proc_thread; i++)
+	{
+		tpool.emplace_back(std::thread(align2_resident, i, std::ref(readfeed), std::ref(readstats), std::ref(indices),
+			std::ref(refsv), std::ref(refstats), std::ref(kvdb), std::ref(alnidx), std::ref(opts)));
+	}
+	for (auto& thr : tpool) {
+		thr.join();
+	}
+	for (auto& index : indices)
+		alnidx.write(index.index_num, index.part);
+	elapsed = std::chrono::high_resolution_clock::now() - start_i;
+	INFO_MEM("done all index parts in ", elapsed.count(), " sec");
+
+	start_i = std::chrono::high_resolution_clock::now();
+	for (auto& index : indices)
+		index.unload();
+	for (auto& refs : refsv)
+		refs.unload();
+	elapsed = std::chrono::high_resolution_clock::now() - start_i;
+	INFO_MEM("Index and References unloaded in ", elapsed.count(), " sec.");
+	readfeed.rewind_in();
+	readfeed.init_vzlib_in();
+} // ~align_resident
+
 /*
 * launches processing threads. called from main
 */
@@ -155,28 +349,47 @@ void align(Readfeed& readfeed, Readstats& readstats, Index& index, KeyValueDatab
 	{
 		numThreads = opts.num_read_thread + numProcThread;
 		INFO("using total threads: ", numThreads, " including Read threads: ", opts.num_read_thread, " Processor threads: ", numProcThread);
-		//ThreadPool tpool(numThreads);
-		//ReadsQueue read_queue("queue_1", opts.queue_size_max, readstats.all_reads_count, numProcThread);
 	}
 	else {
 		numThreads = numProcThread;
 		INFO("Using number of Processor threads: ", numProcThread);
-		readfeed.init_reading(); // prepare readfeed
 	}
+	readfeed.init_reading(); // prepare readfeed
+	const char* simd_names[] = { "SSE2", "AVX2", "AVX-512" };
+	INFO("Smith-Waterman kernels: ", simd_names[ssw_simd_selected()]);
 	std::vector<std::thread> tpool;
 	tpool.reserve(numThreads);
 
 	Refstats refstats(opts, readstats);
 	References refs;
+	Alignidx alnidx(opts.kvdbdir, numProcThread); // reads aligned to each part for the reports
 
 	int loopCount = 0; // counter of total number of processing iterations
 
+	// check all the index parts fit into memory
+	bool is_resident = false;
+	if (opts.is_resident) {
+		auto mem_req = resident_mem_estimate(opts, refstats);
+		auto mem_avail = get_available_memory();
+		is_resident = mem_req < mem_avail;
+		if (is_resident) {
+			INFO("Using resident index. Estimated memory MB: ", (mem_req >> 20), " Available MB: ", (mem_avail >> 20));
+		}
+		else {
+			WARN("Not enough memory for '", OPT_RESIDENT, "'. Estimated MB: ", (mem_req >> 20), 
+				" Available MB: ", (mem_avail >> 20), ". Processing the index parts one by one");
+		}
+	}
+
 	// perform alignment
 	auto start_a = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double> elapsed;
 
+	if (is_resident)
+		align_resident(readfeed, readstats, refstats, kvdb, alnidx, opts);
+
 	// loop through every index passed to option '--ref'
-	for (size_t idx_num = 0; idx_num < opts.indexfiles.size(); ++idx_num)
+	for (size_t idx_num = 0; !is_resident && idx_num < opts.indexfiles.size(); ++idx_num)
 	{
 		// iterate every part of an index
 		for (uint16_t idx_part = 0; idx_part < refstats.num_index_parts[idx_num]; ++idx_part)
@@ -201,24 +414,24 @@ void align(Readfeed& readfeed, Readstats& readstats, Index& index, KeyValueDatab
 			// add Readfeed job if necessary
 			if (opts.feed_type == FEED_TYPE::LOCKLESS)
 			{
-				//tpool.addJob(f_readfeed_run);
+				tpool.emplace_back(std::thread(&Readfeed::run, std::ref(readfeed)));
 			}
 
 			// add Processor jobs
 			for (int i = 0; i < numProcThread; i++)
 			{
 				tpool.emplace_back(std::thread(align2, i, std::ref(readfeed), std::ref(readstats), std::ref(index),
-					std::ref(refs), std::ref(refstats), std::ref(kvdb), std::ref(opts)));
+					std::ref(refs), std::ref(refstats), std::ref(kvdb), std::ref(alnidx), std::ref(opts)));
 			}
 			for (auto& thr: tpool) {
 				thr.join();
 			}
+			alnidx.write(idx_num, idx_part);
 
 			++loopCount;
 
 			elapsed = std::chrono::high_resolution_clock::now() - start_i;
 			INFO_MEM("done index: ", idx_num, " part: ", idx_part + 1, " in ", elapsed.count(), " sec");
-			//INFO_MEM("Done index ", idx_num, " Part: ", idx_part + 1, " Queue size: ", read_queue.queue.size_approx(), " Time: ", elapsed.count())
 
 			start_i = std::chrono::high_resolution_clock::now();
 			index.unload();
@@ -229,7 +442,6 @@ void align(Readfeed& readfeed, Readstats& readstats, Index& index, KeyValueDatab
 			// rewind for the next index
 			readfeed.rewind_in();
 			readfeed.init_vzlib_in();
-			//read_queue.reset();
 		} // ~for(idx_part)
 	} // ~for(idx_num)
 
@@ -241,101 +453,173 @@ void align(Readfeed& readfeed, Readstats& readstats, Index& index, KeyValueDatab
 	readstats.store_to_db(kvdb);
 } // ~align
 
-void denovo_stats_run(const uint32_t& id,
+/*
+ * Post-alignment processing of the reads. runs in a thread.
+ * A read is loaded from DB once per pass and passed to all the enabled consumers:
+ *   - denovo statistics: ID/COV classification of all the alignments of the read. Stored to DB
+ *   - OTU map: the reads passing both ID and COV thresholds grouped by the reference
+ *   - reports: fastx, other, denovo. Blast and SAM on the reference part loaded for the pass
+ * The ID/COV of the alignments were calculated during the alignment, so only the first pass 
+ * does the statistics, the OTU map, and the fastx reports.
+ *
+ * @param refs  references of the part for blast and SAM. Empty if no blast and SAM
+ * @param refids  references IDs of all the index parts for the OTU map
+ * @param otumap  null if the OTU map is not required
+ * @param output  null if the reports are not required
+ * @param alnidx  index of the reads aligned to the part for blast and SAM. Null if all the reads are processed
+ * @param is_first_pass  flags the first pass over the reads
+ * @param is_stats  flags the denovo statistics are calculated in the first pass
+ */
+void postprocess_run(const uint32_t& id,
 	Readfeed& readfeed,
 	Readstats& readstats,
 	References& refs,
+	std::vector<References>& refids,
+	Refstats& refstats,
 	KeyValueDatabase& kvdb,
+	OtuMap* otumap,
+	Output* output,
+	Alignidx* alnidx,
+	bool is_first_pass,
+	bool is_stats,
 	Runopts& opts)
 {
 	uint64_t countReads = 0;
 	uint64_t num_invalid = 0; // empty or invalid reads count
 	uint16_t num_reads = opts.is_paired ? 2 : 1;
-	std::string readstr;
+	Readrec rec; // reused for all the reads
+	std::vector<Read> block; // a block of reads looked up in DB at once
 	std::vector<Read> reads; // two reads if paired, a single read otherwise
+	KvdbBatch kvbatch(kvdb); // the results are written in batches
 
 	if (opts.dbg_level == 2)
-		INFO_MEM("Denovo stats thread ", id, " : ", std::this_thread::get_id(), " started.");
+		INFO_MEM("Postprocessing thread ", id, " : ", std::this_thread::get_id(), " started.");
 
-	for (bool isDone = false; !isDone;)
-	{
-		reads.clear();
-		uint32_t idx = id * readfeed.num_sense; // index into split_files array
-		for (uint16_t i = 0; i < num_reads; ++i)
-		{
-			if (readfeed.next(idx, readstr))
-			{
-				reads.emplace_back(Read(readstr));
-				reads[i].init(opts);
-				reads[i].load_db(kvdb);
-				readstr.resize(0);
-				++countReads;
-			}
-			else {
-				isDone = true;
-			}
-			if (opts.is_paired) idx ^= 1; // switch fwd-rev
-		}
+	auto process_block = [&]() {
+		for (auto& read : block)
+			read.init(opts);
+		Read::load_db(kvdb, block);
+
+		for (std::size_t ib = 0; ib + num_reads <= block.size(); ib += num_reads) {
+			reads.clear();
+			for (uint16_t i = 0; i < num_reads; ++i)
+				reads.push_back(std::move(block[ib + i]));
 
-		if (!isDone) {
 			if (reads.back().isEmpty || !reads.back().isValid) {
 				++num_invalid;
 				continue;
 			}
 
 			for (auto &read: reads) {
-				if (read.is03) read.flip34();
+				if (!is_first_pass || !is_stats) break;
 				for (auto const& align : read.alignment.alignv) {
-					if (align.index_num == refs.num	&& align.part == refs.part)	{
-						auto miss_gap_match = read.calc_miss_gap_match(refs, align);
-						auto idr = std::floor(std::get<3>(miss_gap_match) * 1000.0 + 0.5) / 1000.0; // round to 3 decimal
-						auto covr = std::floor(std::get<4>(miss_gap_match) * 1000.0 + 0.5) / 1000.0;
-						auto is_id = idr >= opts.min_id;
-						auto is_cov = covr >= opts.min_cov;
-						//auto is_id = std::get<3>(miss_gap_match) >= opts.min_id;
-						//auto is_cov = std::get<4>(miss_gap_match)>= opts.min_cov;
-						if (is_id && is_cov) {
-							++read.c_yid_ycov;
-							readstats.n_yid_ycov.fetch_add(1, std::memory_order_relaxed);
-						}
-						else if (is_id) {
-							++read.n_yid_ncov;
-							readstats.n_yid_ncov.fetch_add(1, std::memory_order_relaxed);
-						}
-						else if (is_cov) {
-							++read.n_nid_ycov;
-							readstats.n_nid_ycov.fetch_add(1, std::memory_order_relaxed);
-						}
-						else {
-							++read.n_denovo;
-							readstats.num_denovo.fetch_add(1, std::memory_order_relaxed); // neither ID nor COV
+					auto idr = std::floor(align.id() * 1000.0 + 0.5) / 1000.0; // round to 3 decimal
+					auto covr = std::floor(align.cov() * 1000.0 + 0.5) / 1000.0;
+					auto is_id = idr >= opts.min_id;
+					auto is_cov = covr >= opts.min_cov;
+					if (is_id && is_cov) {
+						++read.c_yid_ycov;
+						readstats.n_yid_ycov.fetch_add(1, std::memory_order_relaxed);
+						if (otumap) {
+							auto refs_it = std::find_if(refids.begin(), refids.end(), 
+								[&align](auto const& refs) { return refs.num == align.index_num && refs.part == align.part; });
+							otumap->push(id, *refs_it, align.ref_num, read);
 						}
 					}
+					else if (is_id) {
+						++read.n_yid_ncov;
+						readstats.n_yid_ncov.fetch_add(1, std::memory_order_relaxed);
+					}
+					else if (is_cov) {
+						++read.n_nid_ycov;
+						readstats.n_nid_ycov.fetch_add(1, std::memory_order_relaxed);
+					}
+					else {
+						++read.n_denovo;
+						readstats.num_denovo.fetch_add(1, std::memory_order_relaxed); // neither ID nor COV
+					}
 				}
-				kvdb.put(read.id, read.toBinString()); // store to DB
+				kvbatch.put(read.id, read.toBinString()); // store to DB
 			} // ~for reads
-		} // ~ if !is_done
-	} // ~for
 
-	//std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start; // ~20 sec Debug/Win
-	INFO_MEM("Denovo stats thread ", id, " : ", std::this_thread::get_id(), " done. Processed reads: ", countReads,
-		" Invalid reads: ", num_invalid); // , " denovo count: ", denovo_n
-} // ~denovo_stats_run
+			if (output) output->append(id, reads, refs, refstats, opts, is_first_pass);
+		} // ~for pairs in the block
+	};
+
+	int idx = id * readfeed.num_sense; // index into split_files array
+	if (alnidx && readfeed.type == FEED_TYPE::READB) {
+		// fetch from the read store only the reads aligned to the loaded part
+		auto read_nums = alnidx->get_reads(idx, readfeed.num_sense);
+		for (std::size_t i = 0; i < read_nums.size();) {
+			block.clear();
+			for (; i < read_nums.size() && block.size() < KeyValueDatabase::MULTI_GET_SIZE; ++i) {
+				for (uint32_t j = 0; j < readfeed.num_sense; ++j) {
+					block.emplace_back();
+					block.back().readfile_idx = idx + j;
+					block.back().read_num = read_nums[i];
+					readfeed.loadReadByIdx(block.back());
+				}
+			}
+			countReads += block.size();
+			process_block();
+		}
+	}
+	else {
+		for (; readfeed.next(idx, rec, block, KeyValueDatabase::MULTI_GET_SIZE);)
+		{
+			countReads += block.size();
+			if (alnidx) {
+				alnidx->filter(block, opts.is_paired); // only the reads aligned to the loaded part
+				if (block.empty()) continue;
+			}
+			process_block();
+		} // ~for
+	}
+	if (output) output->end(id);
+
+	INFO_MEM("Postprocessing thread ", id, " : ", std::this_thread::get_id(), " done. Processed reads: ", countReads,
+		" Invalid reads: ", num_invalid);
+
+	if (output && opts.is_fastx && opts.dbg_level > 1)
+		INFO("Aligned reads: good: ", output->fastx.getBase().num_reads, 
+			" bad: ", output->fastx.getBase().num_io_bad, " fail: ", output->fastx.getBase().num_io_fail);
+	if (output && opts.is_other && opts.dbg_level > 1)
+		INFO("Other reads: good: ", output->fx_other.getBase().num_reads, 
+			" bad: ", output->fx_other.getBase().num_io_bad, 
+			" fail: ", output->fx_other.getBase().num_io_fail, 
+			" count other: ", output->fx_other.getBase().num_miss);
+} // ~postprocess_run
 
-void denovo_stats(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kvdb, Runopts& opts)
+/*
+ * Denovo statistics, OTU map, and reports in as few passes over the reads as possible:
+ * a single pass, or a pass per reference part if the blast or SAM reports are required, as
+ * those print the aligned reference sequences.
+ * Used by all the modes following the alignment, with or without the statistics and the reports.
+ *
+ * @param is_stats  calculate the denovo statistics, and the OTU map if required
+ * @param is_report  write the reports
+ */
+void postprocess(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kvdb, Runopts& opts, bool is_stats, bool is_report)
 {
-	INFO("==== processing Denovo statistics ====");
+	bool is_otu_map = is_stats && opts.is_otu_map;
+	INFO("==== Postprocessing (", (is_stats ? "denovo statistics" : ""), (is_otu_map ? ", OTU map" : ""), 
+		(is_stats && is_report ? ", " : ""), (is_report ? "reports" : ""), ") ====");
 	auto start = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double> elapsed;
 
-	int nthreads = 0;
-	if (readfeed.type == FEED_TYPE::SPLIT_READS) {
-		nthreads = opts.num_proc_thread;
-		readfeed.init_reading(); // prepare readfeed
+	// LOCKLESS: the batches are popped in no particular order. The reports and the OTU map 
+	// keep the order of the reads only with a single processor (the default)
+	int nthreads = opts.num_proc_thread;
+	if (opts.feed_type == FEED_TYPE::LOCKLESS) {
+		if (is_report)
+			nthreads = std::min<int>(opts.num_proc_thread_rep, readfeed.num_splits);
+		else if (is_otu_map)
+			nthreads = opts.num_proc_thread_pp;
 	}
+	readfeed.init_reading(); // prepare readfeed
 
 	std::vector<std::thread> tpool;
-	tpool.reserve(nthreads);
+	tpool.reserve(nthreads + 1);
 
 	bool indb = readstats.restoreFromDb(kvdb);
 	if (indb) {
@@ -344,6 +628,29 @@ void denovo_stats(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kv
 
 	Refstats refstats(opts, readstats);
 	References refs;
+	Alignidx alnidx(opts.kvdbdir);
+	std::vector<References> refids; // IDs of the references for the OTU map
+	std::unique_ptr<OtuMap> otumap;
+	if (is_otu_map) {
+		otumap = std::make_unique<OtuMap>(nthreads);
+		auto start_i = std::chrono::high_resolution_clock::now();
+		for (uint16_t ref_idx = 0; ref_idx < opts.indexfiles.size(); ++ref_idx) {
+			for (uint16_t idx_part = 0; idx_part < refstats.num_index_parts[ref_idx]; ++idx_part) {
+				refids.emplace_back();
+				refids.back().load(ref_idx, idx_part, opts, refstats, true);
+			}
+		}
+		elapsed = std::chrono::high_resolution_clock::now() - start_i;
+		INFO("loaded reference IDs in sec ", elapsed.count());
+	}
+	std::unique_ptr<Output> output;
+	if (is_report) {
+		output = std::make_unique<Output>(readfeed, opts, readstats);
+		if (opts.is_sam) output->sam.write_header(opts);
+	}
+	bool is_per_part = is_report && (opts.is_blast || opts.is_sam);
+	// the first pass needs all the reads for the statistics and the fastx, other, denovo reports
+	bool is_all_first = is_stats || (is_report && (opts.is_fastx || opts.is_other || opts.is_denovo));
 
 	// loop through every reference file passed to option --ref (ex. SSU 16S and SSU 18S)
 	for (uint16_t ref_idx = 0; ref_idx < opts.indexfiles.size(); ++ref_idx)
@@ -351,20 +658,28 @@ void denovo_stats(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kv
 		// iterate all parts of the index
 		for (uint16_t idx_part = 0; idx_part < refstats.num_index_parts[ref_idx]; ++idx_part)
 		{
-			INFO_NE("loading reference ", ref_idx, " part ", idx_part + 1, "/", refstats.num_index_parts[ref_idx]);
 			auto start_i = std::chrono::high_resolution_clock::now();
-			refs.load(ref_idx, idx_part, opts, refstats);
-			elapsed = std::chrono::high_resolution_clock::now() - start_i;
-			INFO_NS(" ... done in sec ", elapsed.count(), "\n");
-
-			start_i = std::chrono::high_resolution_clock::now(); // index processing starts
+			if (is_per_part) {
+				INFO_NE("loading reference ", ref_idx, " part ", idx_part + 1, "/", refstats.num_index_parts[ref_idx]);
+				refs.load(ref_idx, idx_part, opts, refstats);
+				elapsed = std::chrono::high_resolution_clock::now() - start_i;
+				INFO_NS(" ... done in sec ", elapsed.count(), "\n");
+				start_i = std::chrono::high_resolution_clock::now(); // index processing starts
+			}
 
+			bool is_first_pass = ref_idx == 0 && idx_part == 0;
+			// the blast and SAM passes need only the reads aligned to the part, unless the null 
+			// alignments of the non-aligned reads are printed
+			bool is_idx = is_per_part && !(is_first_pass && is_all_first) && !opts.is_print_all_reads 
+				&& alnidx.load(ref_idx, idx_part);
 			// start threads
-			if (opts.feed_type == FEED_TYPE::SPLIT_READS) {
-				for (int i = 0; i < nthreads; ++i) {
-					tpool.emplace_back(std::thread(denovo_stats_run, i, std::ref(readfeed),
-						std::ref(readstats), std::ref(refs), std::ref(kvdb), std::ref(opts)));
-				}
+			if (output) output->begin(nthreads, opts, is_first_pass);
+			if (opts.feed_type == FEED_TYPE::LOCKLESS)
+				tpool.emplace_back(std::thread(&Readfeed::run, std::ref(readfeed)));
+			for (int i = 0; i < nthreads; ++i) {
+				tpool.emplace_back(std::thread(postprocess_run, i, std::ref(readfeed), std::ref(readstats), std::ref(refs), std::ref(refids),
+					std::ref(refstats), std::ref(kvdb), otumap.get(), output.get(), is_idx ? &alnidx : nullptr, 
+					is_first_pass, is_stats, std::ref(opts)));
 			}
 			// wait for all threads to finish
 			for (auto& thr: tpool) {
@@ -372,24 +687,47 @@ void denovo_stats(Readfeed& readfeed, Readstats& readstats, KeyValueDatabase& kv
 			}
 
 			elapsed = std::chrono::high_resolution_clock::now() - start_i; // index processing done
-			INFO("done reference ", ref_idx, " part: ", idx_part + 1, " in ", elapsed.count(), " sec");
-
-			start_i = std::chrono::high_resolution_clock::now();
-			refs.unload();
-			//read_queue.reset();
-			elapsed = std::chrono::high_resolution_clock::now() - start_i;
-			INFO_MEM("references unloaded in ", elapsed.count(), " sec");
+			if (is_per_part) {
+				INFO("done reference ", ref_idx, " part: ", idx_part + 1, " in ", elapsed.count(), " sec");
+				start_i = std::chrono::high_resolution_clock::now();
+				refs.unload();
+				elapsed = std::chrono::high_resolution_clock::now() - start_i;
+				INFO_MEM("references unloaded in ", elapsed.count(), " sec");
+			}
+			else {
+				INFO("done a single pass over the reads in ", elapsed.count(), " sec");
+			}
 			tpool.clear();
 			// rewind for the next index
 			readfeed.rewind_in();
 			readfeed.init_vzlib_in();
+
+			if (!is_per_part) break;
 		} // ~for(idx_part)
+		if (!is_per_part) break;
 	} // ~for(ref_idx)
 
+	if (is_stats) {
+		INFO("num_yid_ycov: ", readstats.n_yid_ycov,
+			"\n\t\t   num_yid_ncov: ", readstats.n_yid_ncov,
+			"\n\t\t   num_nid_ycov: ", readstats.n_nid_ycov,
+			"\n\t\t   num_denovo: ", readstats.num_denovo);
+	}
+
+	if (otumap) {
+		if (readstats.n_yid_ycov.load(std::memory_order_relaxed) > 0) {
+			otumap->merge();
+			readstats.total_otu = otumap->count_otu();
+			otumap->init(opts); // prepare the file
+			otumap->write();
+		}
+		else {
+			INFO("No OTU groups to output - No reads pass %ID and %COV thresholds");
+		}
+	}
+
+	if (output) output->finish(readfeed, opts);
+
 	elapsed = std::chrono::high_resolution_clock::now() - start;
-	INFO("num_yid_ycov: ", readstats.n_yid_ycov,
-		"\n\t\t   num_yid_ncov: ", readstats.n_yid_ncov,
-		"\n\t\t   num_nid_ycov: ", readstats.n_nid_ycov,
-		"\n\t\t   num_denovo: ", readstats.num_denovo);
-	INFO("=== done Denovo stats in ", elapsed.count(), " sec ===\n");
-} // ~denovo_stats
\ No newline at end of file
+	INFO("=== done Postprocessing in ", elapsed.count(), " sec ===\n");
+} // ~postprocess
\ No newline at end of file
@@ -40,6 +40,7 @@
 
 // SMR
 #include "read.hpp"
+#include "readfeed.hpp"
 #include "references.hpp"
 
 alignment_struct2::alignment_struct2() : max_size(0), min_index(0), max_index(0) 
@@ -51,6 +52,10 @@ alignment_struct2::alignment_struct2() : max_size(0), min_index(0), max_index(0)
 alignment_struct2::alignment_struct2(std::string bstr)
 {
 	size_t offset = 0;
+	if (bstr.size() < sizeof(min_index) + sizeof(max_index) + sizeof(size_t)) {
+		ERR("the stored alignments are truncated: ", bstr.size(), " bytes");
+		exit(EXIT_FAILURE);
+	}
 	// min_index
 	std::memcpy(static_cast<void*>(&min_index), bstr.data() + offset, sizeof(min_index));
 	offset += sizeof(min_index);
@@ -66,8 +71,22 @@ alignment_struct2::alignment_struct2(std::string bstr)
 	for (unsigned i = 0; i < alignv_size; i++)
 	{
 		size_t s_align_size = 0; // size of a_align struct
+		if (offset + sizeof(s_align_size) > bstr.size()) {
+			ERR("the stored alignments are truncated: ", bstr.size(), " bytes, alignment ", i, " of ", alignv_size);
+			exit(EXIT_FAILURE);
+		}
 		std::memcpy(static_cast<void*>(&s_align_size), bstr.data() + offset, sizeof(s_align_size));
 		offset += sizeof(s_align_size);
+		// the size has to match the one of an s_align2 with the stored cigar length
+		size_t cigarlen = 0;
+		if (s_align_size >= sizeof(cigarlen) && offset + s_align_size <= bstr.size())
+			std::memcpy(static_cast<void*>(&cigarlen), bstr.data() + offset, sizeof(cigarlen));
+		if (offset + s_align_size > bstr.size() || s_align_size < sizeof(cigarlen)
+			|| s_align_size != sizeof(cigarlen) + cigarlen * sizeof(uint32_t) + s_align2().size())
+		{
+			ERR("the stored alignment ", i, " is corrupt: ", s_align_size, " bytes");
+			exit(EXIT_FAILURE);
+		}
 		std::string s_align_str(bstr.data() + offset, bstr.data() + offset + s_align_size); // part of the string encoding the current s_align struct
 		offset += s_align_size;
 		alignv.push_back(s_align2(s_align_str));
@@ -144,6 +163,19 @@ Read::Read()
 
 Read::Read(std::string& readstr) : Read() {	isEmpty = !from_string(readstr); }
 
+Read::Read(const Readrec& rec) : Read()
+{
+	id = std::to_string(rec.readfile_idx) + '_' + std::to_string(rec.read_num);
+	readfile_idx = rec.readfile_idx;
+	read_num = rec.read_num;
+	header = rec.header;
+	sequence = rec.sequence;
+	quality = rec.quality;
+	if (!header.empty())
+		format = header.front() == FASTA_HEADER_START ? BIO_FORMAT::FASTA : BIO_FORMAT::FASTQ;
+	isEmpty = !rec.is_ok;
+}
+
 Read::Read(std::string id, std::string& read) :	Read() { id = id; }
 
 Read::Read(std::string id, std::string header, std::string sequence, std::string quality, BIO_FORMAT format)
@@ -222,6 +254,7 @@ Read & Read::operator=(const Read& that)
 	n_yid_ncov = that.n_yid_ncov;
 	n_nid_ycov = that.n_nid_ycov;
 	n_denovo = that.n_denovo;
+	is_done = that.is_done;
 	is_hit = that.is_hit;
 	is_new_hit = that.is_new_hit;
 	null_align_output = that.null_align_output;
@@ -259,7 +292,7 @@ void Read::init(Runopts& opts)
 	if (opts.num_alignments > 0) this->num_alignments = opts.num_alignments;
 	if (opts.min_lis > 0) this->best = opts.min_lis;
 	validate();
-	seqToIntStr();
+	if (!is03 && !is04) seqToIntStr(); // already in the integer alphabet if loaded from the read store
 	initScoringMatrix(opts.match, opts.mismatch, opts.score_N);
 } // ~Read::init
 
@@ -306,9 +339,9 @@ void Read::clear()
 	isRestored = false;
 	lastIndex = 0;
 	lastPart = 0;
-	c_yid_ycov = 0;
-	n_yid_ncov = 0;
-	n_nid_ycov = 0;
+	c_yid_ycov = 0;
+	n_yid_ncov = 0;
+	n_nid_ycov = 0;
 	n_denovo = 0;
 	is_done = false;
 	is_hit = false;
@@ -426,6 +459,8 @@ std::string Read::toBinString()
 
 	// hit, hit_denovo, null_align_output, max_SW_count, num_alignments, readhit, best
 	std::string buf;
+	auto format = BIN_FORMAT;
+	std::copy_n(static_cast<char*>(static_cast<void*>(&format)), sizeof(format), std::back_inserter(buf));
 	std::copy_n(static_cast<char*>(static_cast<void*>(&lastIndex)), sizeof(lastIndex), std::back_inserter(buf));
 	std::copy_n(static_cast<char*>(static_cast<void*>(&lastPart)), sizeof(lastPart), std::back_inserter(buf));
 	std::copy_n(static_cast<char*>(static_cast<void*>(&c_yid_ycov)), sizeof(c_yid_ycov), std::back_inserter(buf));
@@ -458,12 +493,54 @@ std::string Read::toBinString()
  * load read alignment data from DB 
  */
 bool Read::load_db(KeyValueDatabase& kvdb)
+{
+	return load_db(kvdb.get(id));
+}
+
+/*
+ * load the alignment data of all the valid reads with a single DB lookup
+ */
+void Read::load_db(KeyValueDatabase& kvdb, std::vector<Read>& reads)
+{
+	std::vector<std::string> ids, bstrs;
+	ids.reserve(reads.size());
+	for (auto const& read : reads) {
+		if (read.isValid) ids.push_back(read.id);
+	}
+	kvdb.multi_get(ids, bstrs);
+	for (std::size_t i = 0, j = 0; i < reads.size(); ++i) {
+		if (reads[i].isValid) reads[i].load_db(bstrs[j++]);
+	}
+}
+
+/*
+ * restore read alignment data from the binary string stored in DB. See 'toBinString'
+ */
+bool Read::load_db(const std::string& bstr)
 {
 	int id_win_hits_len = 0;
-	std::string bstr = kvdb.get(id);
 	if (bstr.size() == 0) { isRestored = false; return isRestored; }
 	size_t offset = 0;
 
+	// results of an older sortmerna have no format tag or a different one - their layout is unknown
+	uint32_t format = 0;
+	if (bstr.size() >= sizeof(format))
+		std::memcpy(static_cast<void*>(&format), bstr.data(), sizeof(format));
+	if (format != BIN_FORMAT) {
+		ERR("Read ID: ", id, " the alignment results stored in the KVDB were written by a different version of sortmerna."
+			" Remove the KVDB directory (option '", OPT_KVDB, "') and run the alignment again");
+		exit(EXIT_FAILURE);
+	}
+	offset += sizeof(format);
+
+	auto head_size = offset + sizeof(lastIndex) + sizeof(lastPart) + sizeof(c_yid_ycov) + sizeof(n_yid_ncov) + sizeof(n_nid_ycov)
+		+ sizeof(n_denovo) + sizeof(is_done) + sizeof(is_hit) + sizeof(null_align_output) + sizeof(max_SW_count) + sizeof(num_alignments)
+		+ sizeof(hit_seeds) + sizeof(size_t);
+	if (bstr.size() < head_size) {
+		ERR("Read ID: ", id, " the alignment results stored in the KVDB are truncated: ", bstr.size(), " bytes < ", head_size);
+		exit(EXIT_FAILURE);
+	}
+
 	std::memcpy(static_cast<void*>(&lastIndex), bstr.data() + offset, sizeof(lastIndex));
 	offset += sizeof(lastIndex);
 
@@ -523,6 +600,10 @@ bool Read::load_db(KeyValueDatabase& kvdb)
 	size_t alignment_size = 0;
 	std::memcpy(static_cast<void*>(&alignment_size), bstr.data() + offset, sizeof(alignment_size));
 	offset += sizeof(alignment_size);
+	if (offset + alignment_size != bstr.size()) {
+		ERR("Read ID: ", id, " the alignment results stored in the KVDB are corrupt: ", bstr.size(), " bytes != ", offset + alignment_size);
+		exit(EXIT_FAILURE);
+	}
 	std::string alignment_str(bstr.data() + offset, bstr.data() + offset + alignment_size);
 	alignment_struct2 alignstruct(alignment_str);
 	alignment = alignstruct;
@@ -538,7 +619,7 @@ void Read::unmarshallJson(KeyValueDatabase & kvdb)
 	INFO("Read::unmarshallJson: Not yet Implemented");
 }
 
-std::tuple<uint32_t, uint32_t, uint32_t, double, double> Read::calc_miss_gap_match(const References& refs, const s_align2& align)
+void Read::calc_miss_gap_match(const References& refs, s_align2& align)
 {
 	uint32_t n_miss = 0; // count of mismatched characters
 	uint32_t n_gap = 0; // count of gaps
@@ -547,7 +628,7 @@ std::tuple<uint32_t, uint32_t, uint32_t, double, double> Read::calc_miss_gap_mat
 	auto qb = align.ref_begin1; // index of the first char in the reference matched part
 	auto pb = align.read_begin1; // index of the first char in the read matched part
 
-	std::string refseq = refs.buffer[align.ref_num].sequence;
+	auto const& refseq = refs.buffer[align.ref_num].sequence;
 
 	for (auto const& cie: align.cigar)
 	{
@@ -575,11 +656,9 @@ std::tuple<uint32_t, uint32_t, uint32_t, double, double> Read::calc_miss_gap_mat
 		}
 	}
 
-	auto n_tot = n_miss + n_gap + n_match;
-	auto align_len = align.read_end1 - align.read_begin1 + 1;
-	auto id = (double)n_match / n_tot; // e.g. 0.98
-	auto cov = (double)abs(align.read_end1 - align.read_begin1 + 1) / align.readlen; // e.g. 0.86
-	return { n_miss, n_gap, n_match, id, cov };
+	align.n_miss = n_miss;
+	align.n_gap = n_gap;
+	align.n_match = n_match;
 } // ~Read::calc_miss_gap_match
 
 /* 
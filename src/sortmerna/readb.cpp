@@ -0,0 +1,328 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/**
+ * FILE: readb.cpp
+ * Created: Oct 16, 2026 Fri
+ */
+
+#include <cstring>
+#include <utility> // std::exchange
+
+#if defined(_WIN32)
+#  include "windows.h"
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "readb.hpp"
+#include "readfeed.hpp" // Readrec
+#include "read.hpp"
+#include "common.hpp"
+
+namespace {
+	const char* SFX_SEQ = ".seq";
+	const char* SFX_HDR = ".hdr";
+	const char* SFX_QUAL = ".qual";
+
+	std::filesystem::path column(const std::filesystem::path& path, const char* sfx)
+	{
+		return std::filesystem::path(path.string() + sfx);
+	}
+}
+
+Readb::Readb() : num_reads(0), hdr(), recs(nullptr) {}
+
+Readb::~Readb()
+{
+	unmap();
+}
+
+Readb::Readb(Readb&& that) noexcept
+	:
+	num_reads(std::exchange(that.num_reads, 0)),
+	path(std::move(that.path)),
+	ofs_rec(std::move(that.ofs_rec)),
+	ofs_seq(std::move(that.ofs_seq)),
+	ofs_hdr(std::move(that.ofs_hdr)),
+	ofs_qual(std::move(that.ofs_qual)),
+	hdr(that.hdr),
+	packed(std::move(that.packed)),
+	idx(std::exchange(that.idx, Mapped())),
+	seq(std::exchange(that.seq, Mapped())),
+	text(std::exchange(that.text, Mapped())),
+	qual(std::exchange(that.qual, Mapped())),
+	recs(std::exchange(that.recs, nullptr))
+{}
+
+Readb& Readb::operator=(Readb&& that) noexcept
+{
+	if (this != &that) {
+		unmap();
+		num_reads = std::exchange(that.num_reads, 0);
+		path = std::move(that.path);
+		ofs_rec = std::move(that.ofs_rec);
+		ofs_seq = std::move(that.ofs_seq);
+		ofs_hdr = std::move(that.ofs_hdr);
+		ofs_qual = std::move(that.ofs_qual);
+		hdr = that.hdr;
+		packed = std::move(that.packed);
+		idx = std::exchange(that.idx, Mapped());
+		seq = std::exchange(that.seq, Mapped());
+		text = std::exchange(that.text, Mapped());
+		qual = std::exchange(that.qual, Mapped());
+		recs = std::exchange(that.recs, nullptr);
+	}
+	return *this;
+}
+
+void Readb::create(const std::filesystem::path& path)
+{
+	unmap();
+	this->path = path;
+	num_reads = 0;
+	memset(&hdr, 0, sizeof(readb_header));
+	memcpy(hdr.magic, READB_MAGIC, sizeof(hdr.magic));
+	hdr.version = READB_VERSION;
+
+	auto mode = std::ios::out | std::ios::binary | std::ios::trunc;
+	ofs_rec.open(path, mode);
+	ofs_seq.open(column(path, SFX_SEQ), mode);
+	ofs_hdr.open(column(path, SFX_HDR), mode);
+	ofs_qual.open(column(path, SFX_QUAL), mode);
+	if (!ofs_rec.is_open() || !ofs_seq.is_open() || !ofs_hdr.is_open() || !ofs_qual.is_open()) {
+		ERR("Failed to create the read store ", path.generic_string());
+		exit(EXIT_FAILURE);
+	}
+	// the header is rewritten on close
+	ofs_rec.write(reinterpret_cast<const char*>(&hdr), sizeof(readb_header));
+} // ~Readb::create
+
+void Readb::put(const Readrec& rec)
+{
+	auto const& sequence = rec.sequence;
+	readb_rec r;
+	memset(&r, 0, sizeof(readb_rec));
+	r.seq_pos = hdr.seq_size;
+	r.header_pos = hdr.header_size;
+	r.quality_pos = hdr.quality_size;
+	r.seq_len = (uint32_t)sequence.size();
+	r.header_len = (uint32_t)rec.header.size();
+	r.quality_len = (uint32_t)rec.quality.size();
+	r.is_ok = rec.is_ok;
+
+	// pack 4 nucleotides per byte. The exceptions are appended after the packed bytes
+	auto num_bytes = (sequence.size() + 3) >> 2;
+	packed.assign(num_bytes, 0);
+	std::string exc_chars;
+	for (std::size_t i = 0; i < sequence.size(); ++i) {
+		auto ch = static_cast<unsigned char>(sequence[i]);
+		char c = ch < 128 ? nt_table[ch] : 4;
+		if (c == 4 || nt_map[(int)c] != (char)ch) {
+			uint32_t pos = (uint32_t)i;
+			packed.append(reinterpret_cast<const char*>(&pos), sizeof(pos));
+			exc_chars.push_back((char)ch);
+			if (c == 4) c = 0; // ambiguous
+		}
+		packed[i >> 2] |= (char)(c << ((i & 3) << 1));
+	}
+	packed.append(exc_chars);
+	r.num_exc = (uint32_t)exc_chars.size();
+
+	ofs_seq.write(packed.data(), packed.size());
+	ofs_hdr.write(rec.header.data(), rec.header.size());
+	ofs_qual.write(rec.quality.data(), rec.quality.size());
+	ofs_rec.write(reinterpret_cast<const char*>(&r), sizeof(readb_rec));
+	hdr.seq_size += packed.size();
+	hdr.header_size += rec.header.size();
+	hdr.quality_size += rec.quality.size();
+	++num_reads;
+} // ~Readb::put
+
+void Readb::close()
+{
+	if (!ofs_rec.is_open()) return;
+	hdr.num_reads = num_reads;
+	ofs_rec.seekp(0);
+	ofs_rec.write(reinterpret_cast<const char*>(&hdr), sizeof(readb_header));
+	ofs_rec.close();
+	ofs_seq.close();
+	ofs_hdr.close();
+	ofs_qual.close();
+	if (ofs_rec.fail() || ofs_seq.fail() || ofs_hdr.fail() || ofs_qual.fail()) {
+		ERR("Failed writing the read store ", path.generic_string());
+		exit(EXIT_FAILURE);
+	}
+} // ~Readb::close
+
+bool Readb::open(const std::filesystem::path& path)
+{
+	unmap();
+	this->path = path;
+	if (!map_file(path, idx) || idx.size < sizeof(readb_header))
+	{
+		unmap();
+		return false;
+	}
+	auto header = reinterpret_cast<const readb_header*>(idx.addr);
+	bool is_valid = memcmp(header->magic, READB_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == READB_VERSION
+		&& idx.size == sizeof(readb_header) + header->num_reads * sizeof(readb_rec)
+		&& map_file(column(path, SFX_SEQ), seq) && seq.size == header->seq_size
+		&& map_file(column(path, SFX_HDR), text) && text.size == header->header_size
+		&& map_file(column(path, SFX_QUAL), qual) && qual.size == header->quality_size;
+	if (!is_valid)
+	{
+		WARN("Read store ", path.generic_string(), " is not valid or was generated by a different version");
+		unmap();
+		return false;
+	}
+	num_reads = header->num_reads;
+	recs = reinterpret_cast<const readb_rec*>(idx.addr + sizeof(readb_header));
+	return true;
+} // ~Readb::open
+
+void Readb::unmap()
+{
+	unmap_file(idx);
+	unmap_file(seq);
+	unmap_file(text);
+	unmap_file(qual);
+	recs = nullptr;
+	if (!ofs_rec.is_open()) num_reads = 0;
+}
+
+bool Readb::get(uint64_t read_num, Read& read) const
+{
+	if (recs == nullptr || read_num >= num_reads) return false;
+
+	auto const& r = recs[read_num];
+	read.read_num = read_num;
+	read.header.assign(text.addr + r.header_pos, r.header_len);
+	read.quality.assign(qual.addr + r.quality_pos, r.quality_len);
+	if (!read.header.empty())
+		read.format = read.header.front() == FASTA_HEADER_START ? BIO_FORMAT::FASTA : BIO_FORMAT::FASTQ;
+
+	// unpack into both the integer and the alphabetic sequences
+	auto packs = reinterpret_cast<const unsigned char*>(seq.addr + r.seq_pos);
+	read.isequence.resize(r.seq_len);
+	read.sequence.resize(r.seq_len);
+	for (uint32_t i = 0; i < r.seq_len; ++i) {
+		char c = (packs[i >> 2] >> ((i & 3) << 1)) & 3;
+		read.isequence[i] = c;
+		read.sequence[i] = nt_map[(int)c];
+	}
+
+	// restore the original characters, and collect the ambiguous positions
+	read.ambiguous_nt.clear();
+	auto exc_pos = packs + ((r.seq_len + 3) >> 2);
+	auto exc_chars = exc_pos + r.num_exc * sizeof(uint32_t);
+	for (uint32_t k = 0; k < r.num_exc; ++k) {
+		uint32_t pos;
+		memcpy(&pos, exc_pos + k * sizeof(uint32_t), sizeof(uint32_t));
+		auto ch = exc_chars[k];
+		read.sequence[pos] = (char)ch;
+		if (ch > 127 || nt_table[ch] == 4)
+			read.ambiguous_nt.push_back((int)pos);
+	}
+	read.is03 = true;
+	read.is04 = false;
+	read.reversed = false;
+	read.isEmpty = r.is_ok == 0;
+	return true;
+} // ~Readb::get
+
+std::string_view Readb::header(uint64_t read_num) const
+{
+	if (recs == nullptr || read_num >= num_reads) return std::string_view();
+	return std::string_view(text.addr + recs[read_num].header_pos, recs[read_num].header_len);
+}
+
+std::string_view Readb::quality(uint64_t read_num) const
+{
+	if (recs == nullptr || read_num >= num_reads) return std::string_view();
+	return std::string_view(qual.addr + recs[read_num].quality_pos, recs[read_num].quality_len);
+}
+
+void Readb::remove(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	for (auto sfx : { SFX_SEQ, SFX_HDR, SFX_QUAL })
+		std::filesystem::remove(column(path, sfx), ec);
+}
+
+/*
+ * map a column read-only. An empty column e.g. the qualities of fasta reads is not mapped
+ */
+bool Readb::map_file(const std::filesystem::path& path, Mapped& mf)
+{
+	unmap_file(mf);
+	std::error_code ec;
+	auto fsize = std::filesystem::file_size(path, ec);
+	if (ec) return false;
+	if (fsize == 0) return true;
+#if defined(_WIN32)
+	HANDLE hfile = CreateFileA(path.string().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hfile == INVALID_HANDLE_VALUE) return false;
+	HANDLE hmap = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hmap != NULL)
+	{
+		mf.addr = (char*)MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(hmap);
+	}
+	CloseHandle(hfile);
+	if (mf.addr == NULL) return false;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+	void* addr = mmap(NULL, fsize, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) return false;
+	mf.addr = (char*)addr;
+#endif
+	mf.size = fsize;
+	return true;
+} // ~Readb::map_file
+
+void Readb::unmap_file(Mapped& mf)
+{
+	if (mf.addr == nullptr) return;
+#if defined(_WIN32)
+	UnmapViewOfFile(mf.addr);
+#else
+	munmap(mf.addr, mf.size);
+#endif
+	mf.addr = nullptr;
+	mf.size = 0;
+}
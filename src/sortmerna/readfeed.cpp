@@ -45,10 +45,15 @@
 #include <regex>
 
 #include "readfeed.hpp"
+#include "readsqueue.hpp"
+#include "read.hpp"
 
 // forward
 std::streampos filesize(const std::string& file); //util.cpp
 
+// number of lines before the file entries in the readfeed descriptor: timestamp, file counts, reads statistics
+constexpr int NUM_DESCRIPTOR_HEAD = 8;
+
 /*
  @param type       feed type
  @param readfiles  vector with reads file paths
@@ -66,6 +71,7 @@ Readfeed::Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, std::fil
 	is_format_defined(false),
 	is_two_files(readfiles.size() > 1),
 	is_paired(is_paired),
+	split_zip(SPLIT_ZIP::FLAT),
 	num_orig_files(readfiles.size()),
 	num_splits(0),
 	num_split_files(0),
@@ -79,7 +85,7 @@ Readfeed::Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, std::fil
 	init(readfiles);
 } // ~Readfeed::Readfeed 1
 
-Readfeed::Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, const unsigned num_parts, std::filesystem::path& basedir, bool is_paired)
+Readfeed::Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, const unsigned num_parts, std::filesystem::path& basedir, bool is_paired, SPLIT_ZIP split_zip)
 	:
 	type(type),
 	is_done(false),
@@ -87,6 +93,7 @@ Readfeed::Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, const un
 	is_format_defined(false),
 	is_two_files(readfiles.size() > 1),
 	is_paired(is_paired),
+	split_zip(split_zip),
 	num_orig_files(readfiles.size()),
 	num_splits(num_parts),
 	num_split_files(0),
@@ -100,7 +107,58 @@ Readfeed::Readfeed(FEED_TYPE type, std::vector<std::string>& readfiles, const un
 	init(readfiles);
 } //~Readfeed::Readfeed 2
 
-//Readfeed::~Readfeed() {}
+Readfeed::Readfeed(std::filesystem::path& basedir)
+	:
+	type(FEED_TYPE::READB),
+	is_done(false),
+	is_ready(false),
+	is_format_defined(false),
+	is_two_files(false),
+	is_paired(false),
+	split_zip(SPLIT_ZIP::FLAT),
+	num_orig_files(0),
+	num_splits(0),
+	num_split_files(0),
+	num_sense(0),
+	num_reads_tot(0),
+	length_all(0),
+	min_read_len(0),
+	max_read_len(0),
+	basedir(basedir)
+{
+	// the descriptor head: time, num_orig_files, num_sense, num_splits
+	std::filesystem::path fn = basedir / "readfeed";
+	std::ifstream ifs(fn, std::ios_base::in | std::ios_base::binary);
+	unsigned lidx = 0;
+	for (std::string line; lidx < 4 && std::getline(ifs, line); ) {
+		if (line.empty() || line[0] == '#') continue;
+		if (lidx == 1) num_orig_files = std::stoul(line);
+		else if (lidx == 2) num_sense = std::stoul(line);
+		else if (lidx == 3) num_splits = std::stoul(line);
+		++lidx;
+	}
+	if (lidx < 4) {
+		ERR("no readfeed descriptor: ", fn.generic_string());
+		return;
+	}
+	is_two_files = num_orig_files > 1;
+	is_paired = num_sense > 1;
+	num_split_files = num_sense * num_splits;
+
+	readbv.resize(num_split_files);
+	for (decltype(num_splits) i = 0, idx = 0; i < num_splits; ++i) {
+		for (decltype(num_sense) j = 0; j < num_sense; ++j, ++idx) {
+			auto path = basedir / ((j == 0 ? "fwd_" : "rev_") + std::to_string(i) + ".rdb");
+			if (!readbv[idx].open(path)) {
+				ERR("failed to open the read store: ", path.generic_string());
+				return;
+			}
+		}
+	}
+	is_ready = true;
+} // ~Readfeed::Readfeed 3
+
+Readfeed::~Readfeed() {} // here as ReadsQueue is incomplete in the header
 
 void Readfeed::init(std::vector<std::string>& readfiles, const int& dbg)
 {
@@ -119,9 +177,12 @@ void Readfeed::init(std::vector<std::string>& readfiles, const int& dbg)
 
 	// always do even when split is ready (need for validation)
 	define_format();
-	count_reads();
+	// the split counts the reads in the same pass, or takes the counts from the descriptor if ready.
+	// The lockless feed has no such pass before the alignment, which needs the reads statistics
+	if (type == FEED_TYPE::LOCKLESS)
+		count_reads();
 
-	if (type == FEED_TYPE::SPLIT_READS) {
+	if (type == FEED_TYPE::SPLIT_READS || type == FEED_TYPE::READB) {
 		init_split_files();
 		is_ready = is_split_ready();
 		if (is_ready) { INFO("split is ready - no need to run"); }
@@ -129,6 +190,7 @@ void Readfeed::init(std::vector<std::string>& readfiles, const int& dbg)
 	}
 	else {
 		is_ready = true;
+		queue.reset(new ReadsQueue("reads", QUEUE_SIZE));
 	}
 
 	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
@@ -136,141 +198,72 @@ void Readfeed::init(std::vector<std::string>& readfiles, const int& dbg)
 }
 
 /* 
- * can be run in a thread
+ * LOCKLESS feed reader. Runs in a thread
+ *
+ * Parses the original reads files into batches of records and pushes them on the queue. The pairs are never
+ * split between the batches. When a single file holds interleaved pairs, the reads are numbered as if they were
+ * in two files i.e. both reads of a pair have the same number, and the stream index 0 (FWD) or 1 (REV)
  */
 void Readfeed::run()
 {
 	auto starts = std::chrono::high_resolution_clock::now();
-	INFO("Readsfile::run thread ", std::this_thread::get_id(), " started");
+	INFO("Readfeed::run thread ", std::this_thread::get_id(), " started");
 
-	// init input file streams
-	ifsv.resize(split_files.size());
-	for (std::size_t i = 0; i < split_files.size(); ++i) {
-		ifsv[i].open(split_files[i].path, std::ios_base::in | std::ios_base::binary);
-		if (!ifsv[i].is_open()) {
-			ERR("Failed to open file ", split_files[i].path);
-			exit(1);
-		}
-	}
-
-	// bug 114 - Z_STREAM_ERROR even though init is called at construction time
-	vzlib_in.resize(split_files.size(), Izlib(true));
-	for (std::size_t i = 0; i < vzlib_in.size(); ++i) {
-		vzlib_in[i].init(false);
-	}
-
-	std::string readstr;
-	int inext = 0;
-	unsigned seqlen = 0;
+	Readbatch batch; // holds the records of a consumed batch after each push
+	std::size_t num_recs = 0; // number of records in the current batch
+	uint64_t num_reads = 0;
+	bool is_interleaved = is_paired && !is_two_files;
 
 	// loop until EOF - get reads - push on queue
-	for (;;)
+	for (int inext = 0;;)
 	{
-		if (next(inext, readstr, seqlen, split_files)) {
-			++num_reads_tot;
-			inext = is_two_files ? inext ^ 1 : inext; // toggle next file index
-		}
+		if (num_recs == batch.size())
+			batch.emplace_back();
+		auto& rec = batch[num_recs];
+		if (!next(inext, rec, orig_files))
+			break;
 
-		is_done = true;
-		for (std::size_t i = 0; i < vstate_in.size(); ++i) {
-			is_done = is_done && vstate_in[i].is_done;
+		if (is_interleaved) {
+			rec.readfile_idx = num_reads & 1;
+			rec.read_num = num_reads >> 1;
 		}
-		if (is_done) {
-			break;
+		++num_reads;
+		if (is_two_files) inext ^= 1; // toggle next file index
+
+		if (++num_recs == BATCH_SIZE) {
+			queue->push(batch);
+			num_recs = 0;
 		}
 	} // ~for
 
+	if (num_recs > 0) {
+		batch.resize(num_recs);
+		queue->push(batch);
+	}
+	queue->done_push();
+
 	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - starts;
-	INFO("Reader::run thread ", std::this_thread::get_id(), " done. Reads count: ", num_reads_tot, " Runtime sec: ", elapsed.count());
+	INFO("Readfeed::run thread ", std::this_thread::get_id(), " done. Reads count: ", num_reads, " Runtime sec: ", elapsed.count());
 } // ~Readfeed::run
 
-bool Readfeed::loadReadByIdx(Read & read)
+bool Readfeed::loadReadByIdx(Read& read) const
 {
-	std::stringstream ss;
-	bool isok = false;
-#if 0
-
-	pstate->fs.open(Reader::*pstate->readsfile, std::ios_base::in | std::ios_base::binary);
-	if (!rstate->fs.is_open()) {
-		std::cerr << STAMP << "failed to open " << rstate->readsfile << std::endl;
-		exit(EXIT_FAILURE);
-	}
-
-	std::string line;
-	std::size_t read_num = 0;
-	//bool isFastq = true;
-	//Gzip gzip(opts.is_gz);
-
-	auto t = std::chrono::high_resolution_clock::now();
-
-	// read lines from the reads file
-	for (int count = 0, stat = 0; ; ) // count lines in a single read
-	{
-		stat = rstate->gzip.getline(rstate->fs, line);
-		if (stat == RL_END) break;
-
-		if (stat == RL_ERR)
-		{
-			std::cerr << STAMP << "ERROR reading from Reads file. Exiting..." << std::endl;
-			exit(1);
-		}
-
-		if (line.empty()) continue;
-
-		line.erase(std::find_if(line.rbegin(), line.rend(), [l = std::locale{}](auto ch) { return !std::isspace(ch, l); }).base(), line.end());
-
-		if ( line[0] == FASTA_HEADER_START || line[0] == FASTQ_HEADER_START )
-		{
-			if (!read.isEmpty) {
-				isok = true;
-				break; // read is ready
-			}
-
-			// add header -->
-			if (read_num == read.read_num)
-			{
-				rstate->isFastq = (line[0] == FASTQ_HEADER_START);
-				read.format = rstate->isFastq ? Format::FASTQ : Format::FASTA;
-				read.header = line;
-				read.isEmpty = false;
-			}
-			else {
-				++read_num;
-				count = 0; // for fastq
-			}
-		} // ~if header line
-		else if ( !read.isEmpty )
-		{
-			// add sequence -->
-			if (rstate->isFastq )
-			{
-				++count;
-				if ( line[0] == '+' ) continue;
-				if ( count == 3 )
-				{
-					read.quality = line; // last line in Fastq read
-					continue;
-				}
-			}
-			read.sequence += line;
-		}
-	} // ~for getline
-
-	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - t;
-
-	//ss << id << " thread: " << std::this_thread::get_id() << " done. Elapsed time: "
-	//	<< std::setprecision(2) << std::fixed << elapsed.count() << " sec Reads added: " << read_id << std::endl;
-	//std::cout << ss.str(); ss.str("");
-
-	rstate->fs.close();
-#endif
-	return isok;
-
-} // ~Readfeed::loadRead
+	if (type != FEED_TYPE::READB || read.readfile_idx >= readbv.size())
+		return false;
+	if (!readbv[read.readfile_idx].get(read.read_num, read))
+		return false;
+	read.id = std::to_string(read.readfile_idx) + '_' + std::to_string(read.read_num);
+	return true;
+} // ~Readfeed::loadReadByIdx
 
-bool Readfeed::loadReadById(Read& read)
+bool Readfeed::loadReadById(Read& read) const
 {
-	return true;
+	auto pos = read.id.find('_');
+	if (pos == std::string::npos || pos == 0 || pos + 1 == read.id.size())
+		return false;
+	read.readfile_idx = std::stoull(read.id.substr(0, pos));
+	read.read_num = std::stoull(read.id.substr(pos + 1));
+	return loadReadByIdx(read);
 } // ~Readfeed::loadReadById
 
 bool Readfeed::next(int inext, std::string& read, unsigned& seqlen, bool is_orig, std::vector<Readfile>& files) {
@@ -406,25 +399,27 @@ bool Readfeed::next(int inext, std::string& read, unsigned& seqlen, bool is_orig
 	return readss.str().size() > 0;
 } // ~Readfeed::next
 
-bool Readfeed::next(int inext, std::string& readstr, bool is_orig, std::vector<Readfile>& files)
+bool Readfeed::next(int inext, Readrec& rec, std::vector<Readfile>& files)
 {
-	std::string line;
-	std::stringstream readss; // an empty read
+	std::string& line = rec.line;
+	std::string& buf = rec.buf; // an empty read
 	auto stat = vstate_in[inext].last_stat;
 
+	buf.clear();
+	rec.readfile_idx = inext;
+	rec.read_num = vstate_in[inext].read_count;
+
 	// read lines from the reads file and extract a single read
 	for (auto count = vstate_in[inext].last_count; !vstate_in[inext].is_done; ++count) // count lines in a single record/read
 	{
 		if (vstate_in[inext].last_header.size() > 0)
 		{
-			if (!is_orig)
-				readss << inext << '_' << vstate_in[inext].read_count << '\n';
-			readss << vstate_in[inext].last_header << '\n';
-			vstate_in[inext].last_header = "";
+			buf.append(vstate_in[inext].last_header).push_back('\n');
+			vstate_in[inext].last_header.clear();
 		}
 
 		// read a line
-		line = "";
+		line.clear();
 		if (!vstate_in[inext].is_done) {
 			if (files[inext].isZip) {
 				stat = vzlib_in[inext].getline(ifsv[inext], line);
@@ -448,7 +443,7 @@ bool Readfeed::next(int inext, std::string& readstr, bool is_orig, std::vector<R
 			// 20210714 - issue 294 - add last line (FQ quality or FA sequence)
 			//         for cases where there is no NL at the end of reads file
 			if (!line.empty()) {
-				readss << line;
+				buf.append(line);
 			}
 			vstate_in[inext].is_done = true;
 			auto FR = (inext & 1) == 0 ? FWD : REV; // if index is even -> FWD
@@ -489,9 +484,7 @@ bool Readfeed::next(int inext, std::string& readstr, bool is_orig, std::vector<R
 		{
 			if (vstate_in[inext].line_count == 1)
 			{
-				if (!is_orig)
-					readss << inext << '_' << vstate_in[inext].read_count << '\n'; // add read id 'filenum_readnum' starting with '0_0'
-				readss << line << '\n'; // the very first header
+				buf.append(line).push_back('\n'); // the very first header
 				count = 0;
 			}
 			else
@@ -499,7 +492,7 @@ bool Readfeed::next(int inext, std::string& readstr, bool is_orig, std::vector<R
 				// read is ready - return
 				// 20210714 - issue 294 - add NL to fasta. Cannot do earlier due possible multiline fasta sequence
 				if (files[inext].isFasta)
-					readss << '\n';
+					buf.push_back('\n');
 				vstate_in[inext].last_header = line;
 				vstate_in[inext].last_count = 1;
 				vstate_in[inext].last_stat = stat;
@@ -511,42 +504,143 @@ bool Readfeed::next(int inext, std::string& readstr, bool is_orig, std::vector<R
 			if (files[inext].isFastq)
 			{
 				if (count == 2) {
-					if (is_orig)
-						readss << line << '\n'; // line[0] == '+'
-					continue;
+					continue; // line[0] == '+'
 				}
 				if (count == 3)
 				{
-					readss << line;
+					buf.append(line);
 					continue;
 				}
-				readss << line << '\n'; // FQ sequence
+				buf.append(line).push_back('\n'); // FQ sequence
 			}
 			else {
-				readss << line; // FASTA sequence possibly multiline
+				buf.append(line); // FASTA sequence possibly multiline
 			}
 		}
 	} // ~for getline
 
 	++vstate_in[inext].read_count;
 
-	auto is_read_ok = readss.str().size() > 0;
-	if (is_read_ok)
-		readstr = readss.str();
-	return is_read_ok;
+	rec.is_ok = rec.parse();
+	return buf.size() > 0;
 } // ~Readfeed::next
 
 /*
  * public function
  */
-bool Readfeed::next(int inext, std::string& readstr)
+bool Readfeed::next(int inext, Readrec& rec)
 {
 	auto has_read = false;
 	if (type == FEED_TYPE::SPLIT_READS)
-		has_read = next(inext, readstr, false, split_files);
+		has_read = next(inext, rec, split_files);
+	else if (type == FEED_TYPE::LOCKLESS) {
+		// the batch being consumed by the calling thread
+		static thread_local Readbatch batch;
+		static thread_local std::size_t ibatch = 0;
+		if (ibatch == batch.size()) {
+			ibatch = 0;
+			if (!queue->pop(batch)) {
+				batch.clear(); // no more reads in this pass
+				return false;
+			}
+		}
+		auto& brec = batch[ibatch++];
+		std::swap(rec.buf, brec.buf); // the record's old buffer goes back to the reader with the batch
+		rec.readfile_idx = brec.readfile_idx;
+		rec.read_num = brec.read_num;
+		rec.is_ok = brec.is_ok && rec.parse(); // views into the swapped buffer
+		has_read = true;
+	}
+	else if (type == FEED_TYPE::READB) {
+		// restore the record as it was in the reads file
+		static thread_local Read read;
+		read.readfile_idx = inext;
+		read.read_num = vstate_in[inext].read_count;
+		has_read = loadReadByIdx(read);
+		if (has_read) {
+			++vstate_in[inext].read_count;
+			rec.readfile_idx = read.readfile_idx;
+			rec.read_num = read.read_num;
+			rec.buf.assign(read.header).append(1, '\n').append(read.sequence);
+			if (!read.quality.empty())
+				rec.buf.append(1, '\n').append(read.quality);
+			rec.is_ok = !read.isEmpty && rec.parse();
+		}
+	}
 	return has_read;
 }
 
+bool Readfeed::next(int& inext, Readrec& rec, std::vector<Read>& reads, std::size_t max_reads)
+{
+	reads.clear();
+	reads.reserve(max_reads);
+	if (type == FEED_TYPE::READB) {
+		// the reads are loaded straight from the store - no text record
+		for (; reads.size() < max_reads && vstate_in[inext].read_count < readbv[inext].size();) {
+			reads.emplace_back();
+			reads.back().readfile_idx = inext;
+			reads.back().read_num = vstate_in[inext].read_count++;
+			loadReadByIdx(reads.back());
+			if (is_paired) inext ^= 1; // switch FWD-REV
+		}
+		return reads.size() > 0;
+	}
+	for (; reads.size() < max_reads && next(inext, rec);) {
+		reads.emplace_back(rec);
+		if (is_paired) inext ^= 1; // switch FWD-REV
+	}
+	return reads.size() > 0;
+}
+
+bool Readfeed::next_block(unsigned& isplit, Readrec& rec, std::vector<Read>& reads, std::size_t max_reads)
+{
+	if (type == FEED_TYPE::LOCKLESS) {
+		int inext = 0;
+		return next(inext, rec, reads, max_reads);
+	}
+
+	// the blocks end on a pair boundary, so that each block starts with a FWD read
+	max_reads -= max_reads % num_sense;
+	for (unsigned i = 0; i < num_splits; ++i, isplit = (isplit + 1) % num_splits) {
+		isplit %= num_splits;
+		auto& split = split_locks[isplit];
+		if (split.is_done.load(std::memory_order_acquire))
+			continue;
+		std::lock_guard<std::mutex> lock(split.lock);
+		if (split.is_done.load(std::memory_order_relaxed))
+			continue; // finished while waiting for the lock
+		int inext = isplit * num_sense; // FWD file of the split
+		if (next(inext, rec, reads, max_reads))
+			return true;
+		split.is_done.store(true, std::memory_order_release);
+	}
+	reads.clear();
+	return false;
+} // ~Readfeed::next_block
+
+bool Readrec::parse()
+{
+	std::string_view lines[3];
+	std::size_t num_lines = 0;
+	for (std::size_t pos = 0; pos < buf.size(); ++num_lines)
+	{
+		auto end = buf.find('\n', pos);
+		if (end == std::string::npos) end = buf.size();
+		if (num_lines < 3) lines[num_lines] = std::string_view(buf.data() + pos, end - pos);
+		pos = end + 1;
+	}
+	header = lines[0];
+	sequence = lines[1];
+	quality = lines[2];
+
+	auto is_fastq = header.size() > 0 && header.front() != FASTA_HEADER_START;
+	if (num_lines > (is_fastq ? 3u : 2u)) {
+		ERR("unexpected number of lines in ", is_fastq ? "fastq" : "fasta", " read: ", buf);
+		return false;
+	}
+	return true;
+} // ~Readrec::parse
+
 /**
  * test if there is a next read in the reads file
  */
@@ -582,8 +676,14 @@ void Readfeed::rewind_in() {
 				exit(1);
 			}
 		}
-		vstate_in[i].reset();
 	}
+	for (std::size_t i = 0; i < vstate_in.size(); ++i) {
+		vstate_in[i].reset(); // READB: the stores have no streams to rewind
+	}
+	for (unsigned i = 0; split_locks && i < num_splits; ++i) {
+		split_locks[i].is_done.store(false, std::memory_order_relaxed);
+	}
+	if (queue) queue->reset();
 }
 
 /*
@@ -593,6 +693,10 @@ void Readfeed::rewind_in() {
  *   2 paired file     -> num files out = 2 x num_parts i.e. each paired file is split into specified number of parts
  *   1 paired file     -> num files out = 1 x num_parts AND ensure each part has even number of reads
  *   1 non-paired file -> num files out = 1 x num_parts
+ *
+ * The reads are dealt to the splits round-robin in batches of BATCH_SIZE reads (pairs if paired) in a single 
+ * pass over the input, so the number of reads is not needed upfront. The reads count and the length statistics 
+ * are accumulated on the way and saved in the descriptor.
  */
 bool Readfeed::split()
 {
@@ -620,11 +724,11 @@ bool Readfeed::split()
 	}
 	rewind_in();
 
-	// init zlib IN for inflation
+	// init zlib IN for inflation. The processing threads are idle - use them for inflating BGZF
 	bool is_zip = false; // flags at least one file requires archiving operations
 	for (std::size_t i = 0; i < orig_files.size(); ++i) {
 		if (orig_files[i].isZip) {
-			vzlib_in[i].init();
+			vzlib_in[i].init(num_splits);
 			is_zip = true;
 		}
 	}
@@ -632,7 +736,14 @@ bool Readfeed::split()
 	// prepare split files to output:
 	//init_split_files(num_splits);
 	// [ fwd_1.fq.gz, rev_1.fq.gz,   fwd_2.fq.gz, rev_2.fq.gz,   ...,   fwd_n.fq.gz, ref_n.fq.gz ]
-	ofsv.resize(num_split_files);
+	if (type == FEED_TYPE::READB) {
+		readbv.resize(num_split_files);
+		for (std::size_t i = 0; i < readbv.size(); ++i) {
+			readbv[i].create(split_files[i].path);
+		}
+	}
+	else
+		ofsv.resize(num_split_files);
 
 	for (std::size_t i = 0; i < ofsv.size(); ++i) {
 		if (!ofsv[i].is_open()) {
@@ -645,26 +756,47 @@ bool Readfeed::split()
 	}
 
 	// prepare zlib interface for writing split files
-	if (is_zip) {
-		vzlib_out.resize(num_split_files, Izlib(true, true));
+	if (is_zip && std::any_of(split_files.begin(), split_files.end(), [](auto const& f) { return f.isZip; })) {
+		vzlib_out.resize(num_split_files, Izlib(true, false));
 		for (std::size_t i = 0; i < vzlib_out.size(); ++i) {
-			vzlib_out[i].init(true);
+			vzlib_out[i].init(true, split_zip == SPLIT_ZIP::GZIP_FAST ? Z_BEST_SPEED : Z_DEFAULT_COMPRESSION);
 		}
 	}
 
 	// prepare Readstates OUT
 	vstate_out.resize(num_split_files);
 
+	// counted during the split
+	num_reads_tot = 0;
+	length_all = 0;
+	min_read_len = 0;
+	max_read_len = 0;
+	for (auto& file : orig_files) file.numreads = 0;
+	for (auto& file : split_files) file.numreads = 0;
+
 	unsigned seqlen = 0;
 	std::string readstr;
 
 	// loop until EOF - get reads from input files - write into split files
-	for (auto inext = 0, iout = 0; next(inext, readstr, seqlen, true, orig_files);)
+	Readrec rec; // READB
+	auto is_readb = type == FEED_TYPE::READB;
+	for (auto inext = 0, iout = 0; is_readb ? next(inext, rec, orig_files) : next(inext, readstr, seqlen, true, orig_files);)
 	{
+		if (is_readb) seqlen = (unsigned)rec.sequence.size();
+		++num_reads_tot;
+		++orig_files[inext].numreads;
+		++split_files[iout].numreads;
+		length_all += seqlen;
+		if (max_read_len < seqlen) max_read_len = seqlen;
+		if (min_read_len > seqlen || min_read_len == 0) min_read_len = seqlen;
+
 		++vstate_out[iout].read_count;
-		// if original files zipped, zip the splits too
-		if (orig_files[inext].isZip) {
-			int ret = vzlib_out[iout].defstr(readstr, ofsv[iout], vstate_out[iout].read_count == split_files[iout].numreads); // Z_STREAM_END | Z_OK - ok
+		if (is_readb) {
+			readbv[iout].put(rec);
+		}
+		// zip the splits if the original files are zipped, unless '-split_zip 0'
+		else if (split_files[iout].isZip) {
+			int ret = vzlib_out[iout].defstr(readstr, ofsv[iout], false); // Z_OK - ok. Finished after the loop
 			if (ret < Z_OK || ret > Z_STREAM_END) {
 				ERR("Failed deflating readstring: ", readstr, " Output file idx: ", iout, " zlib status: ", ret);
 				retval = false;
@@ -679,12 +811,22 @@ bool Readfeed::split()
 
 		// switch files
 		if (is_two_files) inext ^= 1;
-		if (vstate_out[iout].read_count == split_files[iout].numreads 
+		if (vstate_out[iout].read_count % BATCH_SIZE == 0
 			&& ((is_paired && (iout & 1) == 1) || !is_paired)) 
-			iout += num_sense; // switch split if previous split is done
+			iout = (iout + num_sense) % num_split_files; // switch split if the batch is done
 		if (is_paired) iout ^= 1;
 	} // ~for
 
+	// finish the deflate streams. Some splits may get no reads at all if the input is small
+	for (std::size_t i = 0; i < vzlib_out.size() && retval; ++i) {
+		if (!split_files[i].isZip) continue;
+		int ret = vzlib_out[i].defstr("", ofsv[i], true); // Z_STREAM_END - ok
+		if (ret < Z_OK || ret > Z_STREAM_END) {
+			ERR("Failed finishing the deflate stream. Output file idx: ", i, " zlib status: ", ret);
+			retval = false;
+		}
+	}
+
 	// close IN file streams
 	for (unsigned i = 0; i < num_orig_files; ++i) {
 		if (ifsv[i].is_open()) {
@@ -697,6 +839,9 @@ bool Readfeed::split()
 		if (ofsv[i].is_open())
 			ofsv[i].close();
 	}
+	for (unsigned i = 0; i < readbv.size(); ++i) {
+		readbv[i].close();
+	}
 
 	// reset Readstates. No need for izlib - already cleaned
 	for (unsigned i = 0; i < num_orig_files; ++i) {
@@ -722,13 +867,15 @@ bool Readfeed::split()
   verify the split was already performed and the feed is ready
   logic:
 	Read feed descriptor and verify:
-	  - original files have the same name, size and line count
+	  - original files have the same name and size, and were not modified after the split
 	  - num splits are the same
-	  - split files names, count, and line count are the same
+	  - split files names, count, and format are the same
+	The reads counts and the length statistics are taken from the descriptor - no need to count the reads
   Split readfeed descriptor:
 	timestamp: xxx
 	num_input: 2  # number of input files
 	num_parts: 3  # number of split parts. split[].size = num_input * num_parts
+	num_reads_tot, length_all, min_read_len, max_read_len
 	input:
 	  - file_1: name, sha
 	  - file_2: name, sha
@@ -750,11 +897,21 @@ bool Readfeed::is_split_ready() {
 			exit(1);
 		}
 
+		// the input modified after the split
+		auto desc_time = std::filesystem::last_write_time(fn);
+		for (auto const& file : orig_files) {
+			if (std::filesystem::last_write_time(file.path) > desc_time) {
+				INFO("reads file ", file.path, " is newer than the readfeed descriptor");
+				return is_ready = false;
+			}
+		}
+
 		unsigned lidx = 0; // line index
 		unsigned fcnt = 0; // count of file entries in the descriptor
 		unsigned fcnt_max = num_splits * num_sense + num_orig_files;
 		unsigned fidx = 0; // file index
 		unsigned fpidx = 0; // index of file parameters: name, size, lines, zip, fastq/fasta
+		std::regex rx_num("[0-9]+");
 		for (std::string line; std::getline(ifs, line); ) {
 			if (!line.empty()) {
 				// trim
@@ -768,8 +925,15 @@ bool Readfeed::is_split_ready() {
 						is_ready = is_ready && std::stoul(line) == num_sense;
 					else if (lidx == 3)
 						is_ready = is_ready && std::stoul(line) == num_splits;
-					else if (lidx == 4)
-						is_ready = is_ready && std::stoul(line) == num_reads_tot;
+					else if (lidx < (unsigned)NUM_DESCRIPTOR_HEAD) {
+						// reads statistics. Descriptors written before these were added have the file paths here
+						is_ready = is_ready && std::regex_match(line, rx_num);
+						if (!is_ready) break;
+						if (lidx == 4) num_reads_tot = std::stoull(line);
+						else if (lidx == 5) length_all = std::stoull(line);
+						else if (lidx == 6) min_read_len = std::stoul(line);
+						else if (lidx == 7) max_read_len = std::stoul(line);
+					}
 					else {
 						if (fpidx == 0) { // file path
 							++fcnt;
@@ -792,9 +956,9 @@ bool Readfeed::is_split_ready() {
 						}
 						else if (fpidx == 2) { // number of reads
 							if (fcnt <= num_orig_files)
-								is_ready = is_ready && std::stoul(line) == orig_files[fidx].numreads;
+								orig_files[fidx].numreads = std::stoul(line);
 							else
-								is_ready = is_ready && std::stoul(line) == split_files[fidx].numreads;
+								split_files[fidx].numreads = std::stoul(line);
 						}
 						else if (fpidx == 3) { // is zip
 							bool isZip = std::stoi(line) == 1;
@@ -831,7 +995,7 @@ bool Readfeed::is_split_ready() {
 		// verify count of files
 		is_ready = is_ready && (size_t)fidx == split_files.size();
 
-		// reset split file sizes if not ready
+		// reset split file sizes if not ready. The counts are recalculated by the split
 		if (!is_ready) {
 			for (std::size_t i = 0; i < split_files.size(); ++i) {
 				split_files[i].size = 0;
@@ -869,7 +1033,7 @@ bool Readfeed::define_format(const int& dbg)
 	vstate_in.resize(num_orig_files);
 
 	std::string str(100, '\0');
-	unsigned seqlen = 0;
+	Readrec rec;
 	for (decltype(num_orig_files) i = 0; i < num_orig_files; ++i) {
 		if (!ifsv[i].is_open()) {
 			ifsv[i].open(orig_files[i].path, std::ios_base::in | std::ios_base::binary);
@@ -897,14 +1061,14 @@ bool Readfeed::define_format(const int& dbg)
 		if (!is_ascii) {
 			// init izlib for inflation
 			if (vzlib_in.size() < (size_t)i+1) {
-				vzlib_in.emplace_back(Izlib());
+				vzlib_in.emplace_back();
 			}
-			vzlib_in[i].init(false);
+			vzlib_in[i].init();
 		}
 		
 		ifsv[i].seekg(0); // rewind stream to the start
 		// get a read
-		if (next(i, str, seqlen, orig_files)) {
+		if (next(i, rec, orig_files)) {
 			std::string fmt = orig_files[i].isZip ? "gzipped" : "flat ASCII";
 			if (orig_files[i].isFasta) {
 				//biof = BIO_FORMAT::FASTA;
@@ -957,7 +1121,7 @@ void Readfeed::count_reads()
 	// init zlib
 	for (std::size_t i = 0; i < orig_files.size(); ++i) {
 		if (orig_files[i].isZip) {
-			vzlib_in[i].init();
+			vzlib_in[i].init(num_splits);
 		}
 	}
 
@@ -981,7 +1145,8 @@ void Readfeed::count_reads()
 } // ~Readfeed::count_reads
 
 /*
-  init split files' names, and attributes including format fastq/a, zip, number of reads.
+  init split files' names, and attributes including format fastq/a, zip.
+  The number of reads is known after the split, or from the descriptor if the split is ready
 */
 void Readfeed::init_split_files()
 {
@@ -993,7 +1158,8 @@ void Readfeed::init_split_files()
 			std::string stem = j == 0 ? "fwd_" : "rev_";
 			auto jj = is_two_files ? j : 0;
 			std::string sfx_1 = orig_files[jj].isFasta ? ".fa" : ".fq";
-			auto sfx = orig_files[jj].isZip ? sfx_1 + ".gz" : sfx_1;
+			auto sfx = type == FEED_TYPE::READB ? ".rdb"
+				: orig_files[jj].isZip && split_zip != SPLIT_ZIP::FLAT ? sfx_1 + ".gz" : sfx_1;
 			ss << stem << i << sfx; // split file basename
 			//auto idx = i * num_orig_files + j;
 			split_files[idx].path = basedir / ss.str();
@@ -1002,16 +1168,11 @@ void Readfeed::init_split_files()
 		}
 	}
 
-	// calculate number of reads in each of the split files
-	auto nreads = num_reads_tot / num_sense; // num reads of the same sense e.g. FWD
-	auto minr = nreads / num_splits; // quotient i.e. min number of reads in each output file
-	auto surplus = nreads - minr * num_splits; // remainder of reads to be distributed between the output files
 	for (decltype(num_splits) i = 0, idx = 0; i < num_splits; ++i) {
-		auto maxr = i < surplus ? minr + 1 : minr; // distribute the surplus
 		for (decltype(num_sense) j = 0; j < num_sense; ++j, ++idx) {
-			split_files[idx].numreads = maxr;
+			split_files[idx].numreads = 0;
 			auto jj = is_two_files ? j : 0;
-			split_files[idx].isZip = orig_files[jj].isZip;
+			split_files[idx].isZip = type != FEED_TYPE::READB && orig_files[jj].isZip && split_zip != SPLIT_ZIP::FLAT;
 			split_files[idx].isFastq = orig_files[jj].isFastq;
 			split_files[idx].isFasta = orig_files[jj].isFasta;
 		}
@@ -1038,6 +1199,9 @@ void Readfeed::write_descriptor()
 		"#   num_sense\n"
 		"#   num_splits\n"
 		"#   num_reads_tot\n"
+		"#   length_all\n"
+		"#   min_read_len\n"
+		"#   max_read_len\n"
         "#   [\n"
 		"#     file\n"
 		"#     size\n"
@@ -1061,6 +1225,9 @@ void Readfeed::write_descriptor()
 		ofs << num_sense << '\n';       // line 2
 		ofs << num_splits << '\n';      // line 3:
 		ofs << num_reads_tot << '\n';   // line 4:
+		ofs << length_all << '\n';      // line 5
+		ofs << min_read_len << '\n';    // line 6
+		ofs << max_read_len << '\n';    // line 7
 		for (std::size_t i = 0; i < orig_files.size(); ++i) {
 			ofs << orig_files[i].path.generic_string() << '\n';     // file path
 			ofs << orig_files[i].size << '\n';     // file size
@@ -1086,41 +1253,60 @@ void Readfeed::write_descriptor()
 
 void Readfeed::init_vzlib_in()
 {
-	vzlib_in.resize(split_files.size());
+	auto& files = type == FEED_TYPE::LOCKLESS ? orig_files : split_files;
+	vzlib_in.resize(files.size());
 	for (std::size_t i = 0; i < vzlib_in.size(); ++i) {
-		if (split_files[i].isZip) vzlib_in[i].init();
+		if (files[i].isZip) vzlib_in[i].init();
 	}
 }
 
 /*
- * called at the start of reading the split files 
+ * called at the start of reading the split files (the original files if LOCKLESS)
  * init readfeed for reading:
  *   ifsv
  *   vstate_in
  *   vzlib_in
  */
 void Readfeed::init_reading()
-{
+{
+	auto& files = type == FEED_TYPE::LOCKLESS ? orig_files : split_files;
 	for (std::size_t i = 0; i < vstate_in.size(); ++i) {
 		vstate_in[i].reset();
 	}
-	vstate_in.resize(split_files.size());
+	vstate_in.resize(files.size());
+	split_locks.reset(new Splitlock[num_splits]);
 
 	// ifsv
 	for (std::size_t i = 0; i < ifsv.size(); ++i) {
 		if (ifsv[i].is_open()) ifsv[i].close();
 	}
-	ifsv.resize(split_files.size());
-	for (std::size_t i = 0; i < split_files.size(); ++i) {
-		ifsv[i].open(split_files[i].path, std::ios_base::in | std::ios_base::binary);
+
+	// READB: map the stores instead of opening the streams
+	if (type == FEED_TYPE::READB) {
+		ifsv.clear();
+		readbv.resize(files.size());
+		for (std::size_t i = 0; i < files.size(); ++i) {
+			if (!readbv[i].open(files[i].path)) {
+				ERR("failed to open the read store: ", files[i].path.generic_string());
+				exit(1);
+			}
+		}
+		return;
+	}
+
+	ifsv.resize(files.size());
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		ifsv[i].open(files[i].path, std::ios_base::in | std::ios_base::binary);
 		if (!ifsv[i].is_open()) {
-			ERR("failed to open: ", split_files[i].path.generic_string());
+			ERR("failed to open: ", files[i].path.generic_string());
 			exit(1);
 		}
 	}
 
 	// vzlib_in
 	init_vzlib_in();
+
+	if (queue) queue->reset();
 } // ~Readfeed::init_reading
 
 int Readfeed::clean()
@@ -1152,17 +1338,18 @@ int Readfeed::clean()
 				// trim
 				line.erase(std::find_if(line.rbegin(), line.rend(), [l = std::locale{}](auto ch) { return !std::isspace(ch, l); }).base(), line.end());
 				if (line[0] != '#') { // skip comments
-					if (lidx == 1 || lidx == 2 || lidx == 3 || lidx == 4) {
+					if (lidx > 0 && lidx < NUM_DESCRIPTOR_HEAD) {
 						if (!std::regex_match(line, rx_num)) {
-							ERR("not a number: '", line, "'");
-							exit(1);
+							// the split files are overwritten anyway
+							WARN("not a number: '", line, "' Descriptor of an older version? Split files are not removed");
+							break;
 						}
 					}
 					if (lidx == 0); // skip timestamp
 					else if (lidx == 1) n_orig = std::stoi(line);
 					else if (lidx == 2) n_sense = std::stoi(line);
 					else if (lidx == 3) n_split = std::stoi(line);
-					else if (lidx == 4) {
+					else if (lidx < NUM_DESCRIPTOR_HEAD) {
 						//n_tot = std::stoi(line);
 						fcnt_max = n_split * n_sense + n_orig;
 					}
@@ -1174,7 +1361,7 @@ int Readfeed::clean()
 								std::filesystem::path sf(line);
 								if (std::filesystem::exists(sf) && sf.parent_path() == basedir) {
 									INFO("removing split file: ", line);
-									std::filesystem::remove(sf);
+									Readb::remove(sf); // with the columns if a read store
 									++n_del;
 								}
 							}
@@ -35,10 +35,20 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <cctype> // std::isspace
 #include <ios>
 #include <cstdint>
-#include <locale>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+
+#if defined(_WIN32)
+#  include "windows.h"
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 #include "references.hpp"
 #include "refstats.hpp"
@@ -46,40 +56,130 @@
 #include "common.hpp"
 
 
+References::~References() { unmap_file(); }
+
+References::References(References&& other) noexcept
+	: buffer(std::move(other.buffer)), num(other.num), part(other.part), image(other.image), image_size(other.image_size)
+{
+	other.buffer.clear();
+	other.image = NULL;
+	other.image_size = 0;
+}
+
+References& References::operator=(References&& other) noexcept
+{
+	if (this != &other) {
+		unmap_file();
+		buffer = std::move(other.buffer);
+		num = other.num;
+		part = other.part;
+		image = other.image;
+		image_size = other.image_size;
+		other.buffer.clear();
+		other.image = NULL;
+		other.image_size = 0;
+	}
+	return *this;
+}
+
 /**
- * load to memory the Reference records from a given index part
- * Read the reference file, extract the part's references into an array (vector) of reference objects
+ * map into memory the references of a given index part from the binary reference store.
+ * If the store is missing or older than the reference file (index built by a previous version), 
+ * it is first generated from the reference file.
+ *
+ * @param is_ids_only  the IDs are used only (OTU map). The sequences are left empty
  */
-void References::load(uint32_t idx_num, uint32_t idx_part, Runopts & opts, Refstats & refstats)
+void References::load(uint32_t idx_num, uint32_t idx_part, Runopts & opts, Refstats & refstats, bool is_ids_only)
 {
 	num = idx_num;
 	part = idx_part;
 	uint32_t numseq_part = refstats.index_parts_stats_vec[idx_num][idx_part].numseq_part;
+	auto const& reffile = opts.indexfiles[idx_num].first;
+	std::string storefile = opts.indexfiles[idx_num].second + ".refs_" + std::to_string(idx_part) + ".dat";
+
+	bool is_stale = !std::filesystem::exists(storefile)
+		|| std::filesystem::last_write_time(storefile) < std::filesystem::last_write_time(reffile);
+
+	if (is_stale || !map_file(storefile, numseq_part))
+	{
+		INFO("Generating reference store ", storefile);
+		// write to a temporary file first as other processes may be mapping the same store
+		std::string tmpfile = storefile + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+		write_store(reffile, refstats.index_parts_stats_vec[idx_num][idx_part].start_part, numseq_part, tmpfile);
+		std::error_code ec;
+		std::filesystem::rename(tmpfile, storefile, ec);
+		if (ec)
+		{
+			ERR("Failed to rename ", tmpfile, " to ", storefile, ": ", ec.message());
+			exit(EXIT_FAILURE);
+		}
+
+		if (!map_file(storefile, numseq_part))
+		{
+			ERR("Failed to map the reference store ", storefile);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	auto header = reinterpret_cast<refs_store_header*>(image);
+	auto recs = reinterpret_cast<refs_store_rec*>(image + header->rec_offset);
+	const char* seqs = image + header->seq_offset;
+	const char* text = image + header->text_offset;
+	buffer.resize(header->num_seq);
+	for (uint32_t i = 0; i < header->num_seq; ++i)
+	{
+		buffer[i].nid = i;
+		buffer[i].header = std::string_view(text + recs[i].header_pos, recs[i].header_len);
+		buffer[i].id = buffer[i].header.substr(recs[i].id_pos, recs[i].id_len);
+		if (!is_ids_only)
+			buffer[i].sequence = std::string_view(seqs + recs[i].seq_pos, recs[i].seq_len);
+	}
+} // ~References::load
 
-	std::ifstream ifs(opts.indexfiles[idx_num].first, std::ios_base::in | std::ios_base::binary); // open reference file
+/**
+ * Read the reference file, extract the part's references, and write them into the binary reference store
+ * skipping the empty lines & spaces
+ */
+void References::write_store(const std::string& reffile, uint64_t start_part, uint32_t numseq_part, const std::string& outfile)
+{
+	std::ifstream ifs(reffile, std::ios_base::in | std::ios_base::binary); // open reference file
 
 	if (!ifs.is_open())
 	{
-		ERR("Could not open file ", opts.indexfiles[idx_num].first);
+		ERR("Could not open file ", reffile);
 		exit(EXIT_FAILURE);
 	}
 
 	// set the file pointer to the first sequence added to the index for this index file section
-	ifs.seekg(refstats.index_parts_stats_vec[idx_num][idx_part].start_part);
+	ifs.seekg(start_part);
 	if (ifs.fail())
 	{
-		ERR("Could not locate the reference file ", opts.indexfiles[idx_num].first, " used to construct the index");
+		ERR("Could not locate the reference file ", reffile, " used to construct the index");
 		exit(EXIT_FAILURE);
 	}
 
-	// load references sequences, skipping the empty lines & spaces
-	size_t num_seq_read = 0; // count of sequences in the reference file
+	std::vector<refs_store_rec> recs;
+	recs.reserve(numseq_part);
+	std::string seqs; // all the sequences one after another
+	std::string text; // all the headers one after another
 	std::string line;
-	References::BaseRecord rec;
+	refs_store_rec rec;
+	bool is_rec = false; // a record is being parsed
 	bool isFastq = true;
 	bool lastRec = false;
 
-	for (int count = 0; num_seq_read != numseq_part; )
+	// ID is the header up to the first space without the leading '>' or '@'
+	auto push_rec = [&]() {
+		std::string_view header(text.data() + rec.header_pos, rec.header_len);
+		auto id = header.substr(0, header.find(' '));
+		auto id_pos = id.find_first_not_of(std::string{ FASTA_HEADER_START, FASTQ_HEADER_START });
+		rec.id_pos = id_pos == std::string_view::npos ? (uint32_t)id.size() : (uint32_t)id_pos;
+		rec.id_len = (uint32_t)id.size() - rec.id_pos;
+		rec.seq_len = (uint32_t)(seqs.size() - rec.seq_pos);
+		recs.push_back(rec);
+	};
+
+	for (int count = 0; recs.size() != numseq_part; )
 	{
 		if (!lastRec) std::getline(ifs, line);
 
@@ -91,40 +191,31 @@ void References::load(uint32_t idx_num, uint32_t idx_part, Runopts & opts, Refst
 
 		if (lastRec)
 		{
-			if (!rec.isEmpty)
-			{
-				rec.id = rec.getId();
-				rec.nid = num_seq_read;
-				buffer.push_back(rec);
-				num_seq_read++;
-			}
+			if (is_rec) push_rec();
 			break;
 		}
 
-		// remove whitespace (removes '\r' too)
-		line.erase(std::find_if(line.rbegin(), line.rend(), [l = std::locale{}](auto ch) { return !std::isspace(ch, l); }).base(), line.end());
-		//line.erase(std::remove_if(begin(line), end(line), [l = std::locale{}](auto ch) { return std::isspace(ch, l); }), end(line));
-		//if (line[line.size() - 1] == '\r') line.erase(line.size() - 1); // remove trailing '\r'
+		// remove trailing whitespace (removes '\r' too)
+		auto len = line.size();
+		while (len > 0 && (line[len - 1] == ' ' || (line[len - 1] >= '\t' && line[len - 1] <= '\r'))) --len;
+		line.resize(len);
 		// fastq: 0(header), 1(seq), 2(+), 3(quality)
 		// fasta: 0(header), 1(seq)
 		if (line[0] == FASTA_HEADER_START || line[0] == FASTQ_HEADER_START)
 		{
-			if (!rec.isEmpty)
+			if (is_rec)
 			{
-				rec.id = rec.getId();
-				rec.nid = num_seq_read;
-				buffer.push_back(rec); // push record created before this current header
-				rec.isEmpty = true;
-				num_seq_read++;
+				push_rec(); // push record created before this current header
 				count = 0;
 			}
 
 			// start new record
-			rec.clear();
 			isFastq = (line[0] == FASTQ_HEADER_START);
-			rec.format = isFastq ? BIO_FORMAT::FASTQ : BIO_FORMAT::FASTA;
-			rec.header = line;
-			rec.isEmpty = false;
+			rec.header_pos = text.size();
+			rec.header_len = (uint32_t)line.size();
+			rec.seq_pos = seqs.size();
+			text += line;
+			is_rec = true;
 		} // ~header or last record
 		else
 		{
@@ -138,18 +229,106 @@ void References::load(uint32_t idx_num, uint32_t idx_part, Runopts & opts, Refst
 
 			if (isFastq && line[0] == '+') continue;
 
-			if (isFastq && count == 3)
-			{
-				rec.quality = line;
-				continue;
-			}
+			if (isFastq && count == 3) continue; // quality
 
-			convert_fix(line);
-			rec.sequence += line;
+			for (auto ch : line)
+				seqs += ch == ' ' ? ch : nt_table[(int)ch]; // numerical form with the ambiguous chars fixed
 		} // ~not header
 		if (ifs.eof()) lastRec = true; // push and break
 	} // ~for
-} // ~References::load
+
+	refs_store_header header;
+	memset(&header, 0, sizeof(refs_store_header));
+	memcpy(header.magic, REFS_STORE_MAGIC, sizeof(header.magic));
+	header.version = REFS_STORE_VERSION;
+	header.num_seq = (uint32_t)recs.size();
+	header.rec_offset = sizeof(refs_store_header);
+	header.seq_offset = header.rec_offset + recs.size() * sizeof(refs_store_rec);
+	header.text_offset = header.seq_offset + seqs.size();
+	header.file_size = header.text_offset + text.size();
+
+	std::ofstream ofs(outfile, std::ios_base::out | std::ios_base::binary);
+	if (!ofs.is_open())
+	{
+		ERR("Failed to open file: ", outfile, " for writing");
+		exit(EXIT_FAILURE);
+	}
+	ofs.write(reinterpret_cast<const char*>(&header), sizeof(refs_store_header));
+	ofs.write(reinterpret_cast<const char*>(recs.data()), recs.size() * sizeof(refs_store_rec));
+	ofs.write(seqs.data(), seqs.size());
+	ofs.write(text.data(), text.size());
+	if (!ofs)
+	{
+		ERR("Failed writing the reference store ", outfile);
+		exit(EXIT_FAILURE);
+	}
+} // ~References::write_store
+
+/*
+ * map the store read-only and shared, so that concurrent processes using the same references share the pages
+ * @return false if the file cannot be mapped or is not a valid reference store of the part
+ */
+bool References::map_file(const std::string& storefile, uint32_t numseq_part)
+{
+	unmap_file();
+#if defined(_WIN32)
+	HANDLE hfile = CreateFileA(storefile.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hfile == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fsize;
+	if (!GetFileSizeEx(hfile, &fsize) || fsize.QuadPart < (LONGLONG)sizeof(refs_store_header))
+	{
+		CloseHandle(hfile);
+		return false;
+	}
+	HANDLE hmap = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hmap != NULL)
+	{
+		image = (char*)MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(hmap);
+	}
+	CloseHandle(hfile);
+	if (image == NULL) return false;
+	image_size = (size_t)fsize.QuadPart;
+#else
+	int fd = open(storefile.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(refs_store_header))
+	{
+		close(fd);
+		return false;
+	}
+	void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) return false;
+	image = (char*)addr;
+	image_size = st.st_size;
+#endif
+
+	auto header = reinterpret_cast<refs_store_header*>(image);
+	if (memcmp(header->magic, REFS_STORE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != REFS_STORE_VERSION
+		|| header->num_seq != numseq_part
+		|| header->file_size != image_size)
+	{
+		WARN("Reference store ", storefile, " is not valid or was generated by a different version");
+		unmap_file();
+		return false;
+	}
+	return true;
+} // ~References::map_file
+
+void References::unmap_file()
+{
+	if (image == NULL) return;
+#if defined(_WIN32)
+	UnmapViewOfFile(image);
+#else
+	munmap(image, image_size);
+#endif
+	image = NULL;
+	image_size = 0;
+} // ~References::unmap_file
 
   // convert sequence to numerical form and fix ambiguous chars
 void References::convert_fix(std::string & seq)
@@ -166,7 +345,7 @@ std::string References::convertChar(int idx)
 	std::stringstream ss;
 	std::string chstr;
 	//const char nt_map[5] = { 'A', 'C', 'G', 'T', 'N' }; // TODO: move to common
-	for (std::string::iterator it = buffer[idx].sequence.begin(); it != buffer[idx].sequence.end(); ++it)
+	for (auto it = buffer[idx].sequence.begin(); it != buffer[idx].sequence.end(); ++it)
 	{
 		if (*it < 5)
 			chstr += nt_map[(int)*it];
@@ -196,5 +375,6 @@ int References::findref(const std::string& id)
 
 void References::unload()
 {
-	buffer.clear(); // TODO: is this enough?
+	buffer.clear();
+	unmap_file();
 } // ~References::clear
@@ -37,6 +37,10 @@
 #include <sstream>
 #include <ios>
 #include <vector>
+#include <array>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #include "sls_alignment_evaluer.hpp" // ../alp/
 
@@ -45,6 +49,148 @@
 #include "options.hpp"
 #include "indexdb.hpp"
 
+namespace {
+	std::mutex gumbel_lock;
+	std::map<std::string, std::pair<double, double>> gumbel_cache; // Gumbel parameters computed or loaded by this process
+
+	/*
+	 * key of the Gumbel parameters: the scoring and the background frequencies, the only inputs
+	 * of the simulation in 'compute_gumbel' (the simulation parameters are constant).
+	 * Hexadecimal floats so that the frequencies are compared and stored exactly.
+	 */
+	std::string gumbel_key(Runopts& opts, const std::array<double, 4>& freq)
+	{
+		std::stringstream ss;
+		ss << opts.match << ' ' << opts.mismatch << ' ' << opts.gap_open << ' ' << opts.gap_extension << std::hexfloat;
+		for (auto f : freq)
+			ss << ' ' << f;
+		return ss.str();
+	}
+
+	/*
+	 * Gumbel parameters cache of an index '<index>.gumbel': a line per key 'key lambda K'
+	 * Written when the parameters are computed, so that the following runs on the same index skip the simulation.
+	 */
+	bool read_gumbel_cache(const std::string& cachefile, const std::string& key, std::pair<double, double>& gumbel)
+	{
+		std::ifstream ifs(cachefile);
+		for (std::string line; std::getline(ifs, line);)
+		{
+			if (line.size() > key.size() && line.compare(0, key.size(), key) == 0 && line[key.size()] == ' ')
+			{
+				std::istringstream ss(line.substr(key.size()));
+				std::string lambda, K; // hexfloat input is not supported by all the standard libraries: use strtod
+				if (ss >> lambda >> K)
+				{
+					gumbel.first = std::strtod(lambda.c_str(), 0);
+					gumbel.second = std::strtod(K.c_str(), 0);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void write_gumbel_cache(const std::string& cachefile, const std::string& key, const std::pair<double, double>& gumbel)
+	{
+		std::ofstream ofs(cachefile, std::ios::app);
+		if (!ofs.good())
+		{
+			WARN("Cannot write the Gumbel parameters cache [", cachefile, "]");
+			return;
+		}
+		std::stringstream ss;
+		ss << key << std::hexfloat << ' ' << gumbel.first << ' ' << gumbel.second << '\n';
+		ofs << ss.str(); // a single write
+	}
+
+	/*
+	 * compute the Gumbel parameters Lambda and K with the ALP simulation
+	 * for the scoring of the run and the given background frequencies
+	 */
+	std::pair<double, double> compute_gumbel(Runopts& opts, const std::array<double, 4>& background_freq_gv)
+	{
+		// create and initialize scoring matrix
+		long alphabetSize = 4;
+		long **scoring_matrix = new long *[alphabetSize];
+
+		for (long i = 0; i < alphabetSize; i++)
+		{
+			scoring_matrix[i] = new long[alphabetSize];
+			for (long j = 0; j < alphabetSize; j++)
+			{
+				if (i == j)
+					scoring_matrix[i][j] = opts.match;
+				else
+					scoring_matrix[i][j] = opts.mismatch;
+			}
+		}
+
+		long **substitutionScoreMatrix = scoring_matrix;
+		long gapOpen1 = opts.gap_open;
+		long gapOpen2 = opts.gap_open;
+		long gapEpen1 = opts.gap_extension;
+		long gapEpen2 = opts.gap_extension;
+		bool insertions_after_deletions = false;
+		double max_time = -1; // required if randomization parameters are set
+		double max_mem = 500;
+		double eps_lambda = 0.001;
+		double eps_K = 0.005;
+		long randomSeed = 182345345;
+		double *letterFreqs1 = new double[alphabetSize];
+		double *letterFreqs2 = new double[alphabetSize];
+		long number_of_samples = 14112; // TODO: where this number comes from?
+		long number_of_samples_for_preliminary_stages = 39; // TODO: where this number comes from?
+
+		for (long i = 0; i < alphabetSize; i++)
+		{
+			// background probabilities for ACGT based on reference file
+			letterFreqs1[i] = background_freq_gv[i];
+			letterFreqs2[i] = background_freq_gv[i];
+		}
+
+		Sls::AlignmentEvaluer gumbelCalculator; // object to store the Gumbel parameters
+
+		// set the randomization parameters
+		// (will yield the same Lamba and K values on subsequent runs with the same input files)
+		gumbelCalculator.set_gapped_computation_parameters_simplified(
+			max_time,
+			number_of_samples,
+			number_of_samples_for_preliminary_stages);
+
+		gumbelCalculator.initGapped(
+			alphabetSize,
+			substitutionScoreMatrix,
+			letterFreqs1,
+			letterFreqs2,
+			gapOpen1,
+			gapEpen1,
+			gapOpen2,
+			gapEpen2,
+			insertions_after_deletions,
+			eps_lambda,
+			eps_K,
+			max_time,
+			max_mem,
+			randomSeed);
+
+		std::pair<double, double> gumbel(gumbelCalculator.parameters().lambda, gumbelCalculator.parameters().K);
+
+		delete[] letterFreqs2;
+		delete[] letterFreqs1;
+
+		// free memory
+		for (long i = 0; i < alphabetSize; i++)
+		{
+			delete[] scoring_matrix[i];
+		};
+
+		delete[] scoring_matrix;
+
+		return gumbel;
+	}
+}
+
 Refstats::Refstats(Runopts & opts, Readstats & readstats)
 	:
 	num_index_parts(opts.indexfiles.size(), 0),
@@ -69,23 +215,8 @@ Refstats::Refstats(Runopts & opts, Readstats & readstats)
  */
 void Refstats::load(Runopts& opts, Readstats& readstats)
 {
-	std::stringstream ss;
-
-	// create and initialize scoring matrix
-	long alphabetSize = 4;
-	long **scoring_matrix = new long *[alphabetSize];
-
-	for (long i = 0; i < alphabetSize; i++)
-	{
-		scoring_matrix[i] = new long[alphabetSize];
-		for (long j = 0; j < alphabetSize; j++)
-		{
-			if (i == j)
-				scoring_matrix[i][j] = opts.match;
-			else
-				scoring_matrix[i][j] = opts.mismatch;
-		}
-	}
+	// A,C,G,T background frequencies of each database to compute the Gumbel parameters lambda and K
+	std::vector<std::array<double, 4>> background_freqs(opts.indexfiles.size());
 
 	// loop through the .stats index files for each database
 	for (uint16_t index_num = 0; index_num < (uint16_t)opts.indexfiles.size(); index_num++)
@@ -108,10 +239,8 @@ void Refstats::load(Runopts& opts, Readstats& readstats)
 		char fastafile_name[2000];
 		stats.read(reinterpret_cast<char*>(fastafile_name), sizeof(char)*fastafile_len);
 
-		// A,C,G,T background frequencies to compute the Gumbel parameters lambda and K
-		double background_freq_gv[4] = { 0 };
 		// A/C/G/T distribution frequencies
-		stats.read(reinterpret_cast<char*>(&background_freq_gv), sizeof(double) * 4);
+		stats.read(reinterpret_cast<char*>(background_freqs[index_num].data()), sizeof(double) * 4);
 		// total length of sequences in the complete database
 		stats.read(reinterpret_cast<char*>(&full_ref[index_num]), sizeof(uint64_t));
 		// sliding window length lnwin & initialize
@@ -145,60 +274,14 @@ void Refstats::load(Runopts& opts, Readstats& readstats)
 
 		index_parts_stats_vec.push_back(hold);
 
-		// Gumbel parameters
-		long **substitutionScoreMatrix = scoring_matrix;
-		long gapOpen1 = opts.gap_open;
-		long gapOpen2 = opts.gap_open;
-		long gapEpen1 = opts.gap_extension;
-		long gapEpen2 = opts.gap_extension;
-		bool insertions_after_deletions = false;
-		double max_time = -1; // required if randomization parameters are set
-		double max_mem = 500;
-		double eps_lambda = 0.001;
-		double eps_K = 0.005;
-		long randomSeed = 182345345;
-		double *letterFreqs1 = new double[alphabetSize];
-		double *letterFreqs2 = new double[alphabetSize];
-		long number_of_samples = 14112; // TODO: where this number comes from?
-		long number_of_samples_for_preliminary_stages = 39; // TODO: where this number comes from?
-
-		for (long i = 0; i < alphabetSize; i++)
-		{
-			// background probabilities for ACGT based on reference file
-			letterFreqs1[i] = background_freq_gv[i];
-			letterFreqs2[i] = background_freq_gv[i];
-		}
-
-		Sls::AlignmentEvaluer gumbelCalculator; // object to store the Gumbel parameters
-
-		// set the randomization parameters
-		// (will yield the same Lamba and K values on subsequent runs with the same input files)
-		gumbelCalculator.set_gapped_computation_parameters_simplified(
-			max_time,
-			number_of_samples,
-			number_of_samples_for_preliminary_stages);
-
-		gumbelCalculator.initGapped(
-			alphabetSize,
-			substitutionScoreMatrix,
-			letterFreqs1,
-			letterFreqs2,
-			gapOpen1,
-			gapEpen1,
-			gapOpen2,
-			gapEpen2,
-			insertions_after_deletions,
-			eps_lambda,
-			eps_K,
-			max_time,
-			max_mem,
-			randomSeed);
+		stats.close();
+	} // ~for loop indices
 
-		gumbel[index_num].first = gumbelCalculator.parameters().lambda;
-		gumbel[index_num].second = gumbelCalculator.parameters().K;
+	load_gumbel(opts, background_freqs);
 
-		delete[] letterFreqs2;
-		delete[] letterFreqs1;
+	for (uint16_t index_num = 0; index_num < (uint16_t)opts.indexfiles.size(); index_num++)
+	{
+		auto const& background_freq_gv = background_freqs[index_num];
 
 		// Shannon's entropy for reference sequence nucleotide distribution
 		double entropy_H_gv =
@@ -224,15 +307,62 @@ void Refstats::load(Runopts& opts, Readstats& readstats)
 					* full_ref[index_num]
 					* full_read[index_num])))
 			/ -(gumbel[index_num].first));
-
-		stats.close();
 	} // ~for loop indices
+} // ~Index::load_stats
+
+/**
+ * Gumbel parameters of each database: computed by the ALP simulation once for a given scoring and background
+ * frequencies, and kept both for the process (Refstats is constructed by every phase of the run) and in the
+ * '<index>.gumbel' cache files for the following runs. The parameters missing from both are computed in
+ * parallel, a thread per database (the simulation is single threaded).
+ */
+void Refstats::load_gumbel(Runopts& opts, std::vector<std::array<double, 4>>& background_freqs)
+{
+	std::vector<std::string> keys;
+	std::vector<std::size_t> misses; // databases to compute the parameters for
 
-	// free memory
-	for (long i = 0; i < alphabetSize; i++)
 	{
-		delete[] scoring_matrix[i];
-	};
+		std::lock_guard<std::mutex> lock(gumbel_lock);
+		for (std::size_t index_num = 0; index_num < opts.indexfiles.size(); ++index_num)
+		{
+			keys.push_back(gumbel_key(opts, background_freqs[index_num]));
+			auto it = gumbel_cache.find(keys.back());
+			if (it != gumbel_cache.end())
+				gumbel[index_num] = it->second;
+			else if (read_gumbel_cache(opts.indexfiles[index_num].second + ".gumbel", keys.back(), gumbel[index_num]))
+				gumbel_cache[keys.back()] = gumbel[index_num];
+			else
+				misses.push_back(index_num);
+		}
+	}
+
+	if (misses.empty()) return;
+
+	// several databases with the same frequencies are computed once
+	std::map<std::string, std::size_t> todo; // key : database to compute
+	for (auto index_num : misses)
+		todo.emplace(keys[index_num], index_num);
 
-	delete[] scoring_matrix;
-} // ~Index::load_stats
\ No newline at end of file
+	std::map<std::string, std::pair<double, double>> computed;
+	for (auto const& key_idx : todo)
+		computed[key_idx.first] = std::pair<double, double>(-1.0, -1.0);
+
+	std::vector<std::thread> threads;
+	for (auto const& key_idx : todo)
+	{
+		auto& result = computed[key_idx.first];
+		auto const& freq = background_freqs[key_idx.second];
+		threads.emplace_back([&opts, &result, &freq]() { result = compute_gumbel(opts, freq); });
+	}
+	for (auto& t : threads)
+		t.join();
+
+	std::lock_guard<std::mutex> lock(gumbel_lock);
+	for (auto const& key_idx : todo)
+		write_gumbel_cache(opts.indexfiles[key_idx.second].second + ".gumbel", key_idx.first, computed[key_idx.first]);
+	for (auto index_num : misses)
+	{
+		gumbel[index_num] = computed[keys[index_num]];
+		gumbel_cache[keys[index_num]] = gumbel[index_num];
+	}
+} // ~Refstats::load_gumbel
\ No newline at end of file
@@ -36,13 +36,13 @@
 #include "common.hpp"
 #include "options.hpp"
 
-Report::Report(Runopts& opts) : pid_str(std::to_string(getpid())), is_zip(false) {}
+Report::Report(Runopts& opts) : pid_str(std::to_string(getpid())), is_zip(false), num_out(1) {}
 Report::~Report() {	closef(); }
 
 void Report::init_zip()
 {
 	// prepare zlib interface for writing split files
-	vzlib_out.resize(fv.size(), Izlib(true, true));
+	vzlib_out.resize(fv.size(), Izlib(true, false));
 	for (auto& zlibm: vzlib_out) {
 		zlibm.init(true);
 	}
@@ -51,48 +51,63 @@ void Report::init_zip()
 	vstate_out.resize(fv.size());
 }
 
-void Report::merge(const uint32_t& num_splits, const uint32_t& num_out, const int& dbg)
+std::size_t Report::pending(const uint32_t& id)
 {
-	for (uint32_t i = 0; i < num_out; ++i) {
-		if (!fsv[i].is_open()) { 
-			openfw(i, dbg);
-		}
-		else {
-			fsv[i].seekp(0); //rewind
+	std::size_t size = 0;
+	for (uint32_t i = id * num_out; i < (id + 1) * num_out; ++i) {
+		size += bufv[i].tellp();
+	}
+	return size;
+} // ~Report::pending
+
+void Report::seal(const uint32_t& id)
+{
+	// the report file is a concatenation of the gzip members. The thread may write more 
+	// in this or the following passes, so a new member is started
+	if (!is_zip) return;
+	for (uint32_t i = id * num_out; i < (id + 1) * num_out; ++i) {
+		if (vzlib_out[i].is_pending()) {
+			vzlib_out[i].finish_deflate(bufv[i]);
+			vzlib_out[i].init(true);
 		}
+	}
+} // ~Report::seal
 
-		for (uint32_t j = 1; j < num_splits; ++j) {
-			uint32_t idx = i + j * num_out;
-			auto fsz = std::filesystem::file_size(fv[idx]);
-			if (dbg > 1) {
-				INFO("input file idx: ", idx, " size: ", fsz);
-				if (fsz == 0)
-					INFO("skipping empty file at idx: ", idx);
+void Report::write(const uint32_t& id)
+{
+	for (uint32_t i = 0; i < num_out; ++i) {
+		auto& buf = bufv[id * num_out + i];
+		if (buf.tellp() > 0) {
+			fsv[i] << buf.rdbuf();
+			if (!fsv[i].good()) {
+				ERR("Failed writing to the report file ", fv[i]);
+				exit(EXIT_FAILURE);
 			}
-			if (fsz > 0) {
-				if (!fsv[idx].is_open()) {
-					openfr(idx);
-				}
-				else {
-					fsv[idx].seekg(0);
-				}
-				if (dbg > 1) {
-					INFO("merging ifs@idx: ", idx);
-				}
-				fsv[i] << fsv[idx].rdbuf();
-				INFO("merged ", fv[idx], " -> ", fv[i]);
-				if (dbg > 1) {
-					INFO("merged ifs@idx: ", idx, " ifs bad: ", fsv[idx].bad(), " end ifs pos: ", fsv[idx].tellg(), " to ofs@idx: ", i, " ofs bad: ", fsv[i].bad());
-				}
-				fsv[idx].close();
+		}
+		buf.str("");
+		buf.clear();
+	}
+} // ~Report::write
+
+void Report::finish(const int& dbg)
+{
+	// all the threads are joined. End the gzip streams without starting new members
+	for (uint32_t id = 0; id * num_out < bufv.size(); ++id) {
+		if (is_zip) {
+			for (uint32_t i = id * num_out; i < (id + 1) * num_out; ++i) {
+				if (vzlib_out[i].is_pending())
+					vzlib_out[i].finish_deflate(bufv[i]);
+				else
+					vzlib_out[i].reset_deflate();
 			}
-			std::filesystem::remove(fv[idx]);
-			INFO("deleted ", fv[idx]);
 		}
-		fsv[i].close();
+		write(id);
+	}
+	closef(dbg);
+	for (uint32_t i = 0; i < num_out; ++i) {
 		strip_path_sfx(fv[i]);
 	}
-} // ~Report::merge
+} // ~Report::finish
 
 void Report::openfw(const uint32_t& idx, const int& dbg)
 {
@@ -111,23 +126,11 @@ void Report::openfw(const uint32_t& idx, const int& dbg)
 
 void Report::openfw(const int& dbg)
 {
-	for (size_t i = 0; i < fv.size(); ++i) {
+	fsv.resize(num_out);
+	for (uint32_t i = 0; i < num_out; ++i) {
 		openfw(i, dbg);
 	}
-}
-
-void Report::openfr(unsigned idx)
-{
-	if (!fsv[idx].is_open()) {
-		fsv[idx].open(fv[idx], std::ios::binary | std::ios::in);
-	}
-	if (!fsv[idx].good()) {
-		ERR("Could not open output file [", fv[idx], "] for reading.");
-		exit(EXIT_FAILURE);
-	}
-	else {
-		INFO("Opened output file ", fv[idx], " for reading.");
-	}
+	bufv.resize(fv.size());
 }
 
 void Report::closef(const uint32_t& idx, const int& dbg)
@@ -147,17 +150,6 @@ void Report::closef(const int& dbg)
 	}
 }
 
-int Report::finish_deflate()
-{
-	int ret = 0;
-	if (is_zip) {
-		for (unsigned i = 0; i < vzlib_out.size(); ++i) {
-			ret += vzlib_out[i].finish_deflate(fsv[i]);
-		}
-	}
-	return ret;
-}
-
 void Report::strip_path_sfx(std::string& path, std::string sfx)
 {
 	auto fnb = std::filesystem::path(path).filename().string();
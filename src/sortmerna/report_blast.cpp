@@ -48,7 +48,6 @@ ReportBlast::ReportBlast(Readfeed& readfeed, Runopts& opts)	: ReportBlast(opts)
 void ReportBlast::init(Readfeed& readfeed, Runopts& opts) 
 {
 	fv.resize(readfeed.num_splits);
-	fsv.resize(readfeed.num_splits);
 	is_zip = readfeed.orig_files[0].isZip;
 	// WORKDIR/out/aligned_0_PID.blast
 	for (uint32_t i = 0; i < readfeed.num_splits; ++i) {
@@ -56,8 +55,8 @@ void ReportBlast::init(Readfeed& readfeed, Runopts& opts)
 		std::string sfx2 = opts.is_pid ? "_" + pid_str : "";
 		std::string gz = is_zip ? ".gz" : "";
 		fv[i] = opts.aligned_pfx.string() + sfx1 + sfx2 + ext + gz;
-		openfw(i, opts.dbg_level);
 	}
+	openfw(opts.dbg_level);
 	if (is_zip) init_zip();
 }
 
@@ -92,8 +91,8 @@ void ReportBlast::append(const uint32_t& id, Read& read, References& refs, Refst
 				* refstats.full_read[refs.num]
 				* std::exp(-refstats.gumbel[refs.num].first * align.score1);
 
-			std::string refseq = refs.buffer[align.ref_num].sequence;
-			std::string ref_id = refs.buffer[align.ref_num].id;
+			auto const& refseq = refs.buffer[align.ref_num].sequence;
+			auto const& ref_id = refs.buffer[align.ref_num].id;
 
 			strandmark = align.strand ? '+' : '-';
 
@@ -240,10 +239,9 @@ void ReportBlast::append(const uint32_t& id, Read& read, References& refs, Refst
 					return;
 				}
 
-				auto miss_gap_match = read.calc_miss_gap_match(refs, align);
 				if (opts.dbg_level == 2) {
-					auto idr = floor(std::get<3>(miss_gap_match) * 1000.0 + 0.5) / 1000.0;
-					auto covr = floor(std::get<4>(miss_gap_match) * 1000.0 + 0.5) / 1000.0;
+					auto idr = floor(align.id() * 1000.0 + 0.5) / 1000.0;
+					auto covr = floor(align.cov() * 1000.0 + 0.5) / 1000.0;
 					auto is_id = idr >= opts.min_id;
 					auto is_cov = covr >= opts.min_cov;
 					if (is_id && is_cov)
@@ -262,13 +260,13 @@ void ReportBlast::append(const uint32_t& id, Read& read, References& refs, Refst
 				ss << ref_id << "\t";
 				// (3) %id
 				ss.precision(3);
-				ss << std::get<3>(miss_gap_match) * 100 << "\t";
+				ss << align.id() * 100 << "\t";
 				// (4) alignment length
 				ss << (align.read_end1 - align.read_begin1 + 1) << "\t";
 				// (5) mismatches
-				ss << std::get<0>(miss_gap_match) << "\t";
+				ss << align.n_miss << "\t";
 				// (6) gap openings
-				ss << std::get<1>(miss_gap_match) << "\t";
+				ss << align.n_gap << "\t";
 				// (7) q.start
 				ss << align.read_begin1 + 1 << "\t";
 				// (8) q.end
@@ -309,7 +307,7 @@ void ReportBlast::append(const uint32_t& id, Read& read, References& refs, Refst
 						// output % query coverage
 						ss << "\t";
 						ss.precision(3);
-						ss << std::get<4>(miss_gap_match) * 100;
+						ss << align.cov() * 100;
 					}
 					else if (opts.blastops[l].compare("qstrand") == 0)
 					{
@@ -323,12 +321,12 @@ void ReportBlast::append(const uint32_t& id, Read& read, References& refs, Refst
 		}
 	} // ~iterate all alignments
 	if (is_zip) {
-		auto ret = vzlib_out[id].defstr(ss.str(), fsv[id]); // Z_STREAM_END | Z_OK - ok
+		auto ret = vzlib_out[id].defstr(ss.str(), bufv[id]); // Z_STREAM_END | Z_OK - ok
 		if (ret < Z_OK || ret > Z_STREAM_END) {
 			ERR("Failed deflating readstring: ", ss.str(), " zlib status: ", ret);
 		}
 	}
 	else {
-		fsv[id] << ss.str();
+		bufv[id] << ss.str();
 	}
 } // ~ ReportBlast::append
\ No newline at end of file
@@ -50,10 +50,9 @@ void ReportFxBase::init(Runopts& opts)
 	set_num_out(opts);
 }
 
-void ReportFxBase::init(Readfeed& readfeed, Runopts& opts, std::vector<std::string>& fv, std::vector<std::fstream>& fsv, const std::string& fpfx, const std::string& pid_str)
+void ReportFxBase::init(Readfeed& readfeed, Runopts& opts, std::vector<std::string>& fv, const std::string& fpfx, const std::string& pid_str)
 {
 	unsigned num_split = readfeed.num_splits * num_out;
-	fsv.resize(num_split);
 	fv.resize(num_split);
 	// fasta/q output  WORKDIR/out/aligned_paired_fwd_0_PID.fq
 	//                              pfx + sfx1 + sfx2 + sfx3 + sfx4 + ext
@@ -39,7 +39,8 @@ ReportFxOther::ReportFxOther(Readfeed& readfeed, Runopts& opts) : ReportFxOther(
 void ReportFxOther::init(Readfeed& readfeed, Runopts& opts)
 {
 	base.init(opts);
-	base.init(readfeed, opts, fv, fsv, opts.other_pfx.string(), pid_str);
+	base.init(readfeed, opts, fv, opts.other_pfx.string(), pid_str);
+	num_out = base.num_out;
 	openfw(opts.dbg_level); // open output files for writing
 	is_zip = readfeed.orig_files[0].isZip;
 	if (is_zip)	init_zip();
@@ -105,9 +106,9 @@ void ReportFxOther::append(const uint32_t& id, std::vector<Read>& reads, const R
 			}
 
 			if (is_zip)
-				base.write_a_read(fsv[idx], reads[i], vstate_out[idx], vzlib_out[idx], is_last, opts.dbg_level);
+				base.write_a_read(bufv[idx], reads[i], vstate_out[idx], vzlib_out[idx], is_last, opts.dbg_level);
 			else
-				base.write_a_read(fsv[idx], reads[i], opts.dbg_level);
+				base.write_a_read(bufv[idx], reads[i], opts.dbg_level);
 		}
 	}//~if paired
 	// non-paired
@@ -116,9 +117,9 @@ void ReportFxOther::append(const uint32_t& id, std::vector<Read>& reads, const R
 		if (!reads[0].is_hit)
 		{
 			if (is_zip)
-				base.write_a_read(fsv[id], reads[0], vstate_out[id], vzlib_out[id], is_last, opts.dbg_level);
+				base.write_a_read(bufv[id], reads[0], vstate_out[id], vzlib_out[id], is_last, opts.dbg_level);
 			else
-				base.write_a_read(fsv[id], reads[0], opts.dbg_level);
+				base.write_a_read(bufv[id], reads[0], opts.dbg_level);
 		}
 	}
 } // ~ReportFxOther::append
@@ -46,7 +46,6 @@ ReportSam::ReportSam(Readfeed& readfeed, Runopts& opts) : ReportSam(opts)
 void ReportSam::init(Readfeed& readfeed, Runopts& opts)
 {
 	fv.resize(readfeed.num_splits);
-	fsv.resize(readfeed.num_splits);
 	is_zip = readfeed.orig_files[0].isZip;
 	// WORKDIR/out/aligned_0_PID.sam
 	for (uint32_t i = 0; i < readfeed.num_splits; ++i) {
@@ -54,8 +53,8 @@ void ReportSam::init(Readfeed& readfeed, Runopts& opts)
 		std::string sfx2 = opts.is_pid ? "_" + pid_str : "";
 		std::string gz = is_zip ? ".gz" : "";
 		fv[i] = opts.aligned_pfx.string() + sfx1 + sfx2 + ext + gz;
-		openfw(i);
 	}
+	openfw();
 	if (is_zip) init_zip();
 }
 
@@ -134,18 +133,17 @@ void ReportSam::append(const uint32_t& id, Read& read, References& refs, Runopts
 			// (12) OPTIONAL FIELD: SW alignment score generated by aligner
 			ss << "\tAS:i:" << align.score1;
 			// (13) OPTIONAL FIELD: edit distance to the reference
-			auto miss_gap_mat = read.calc_miss_gap_match(refs, align);
-			ss << "\tNM:i:" << std::get<0>(miss_gap_mat) + std::get<1>(miss_gap_mat) << "\n";
+			ss << "\tNM:i:" << align.n_miss + align.n_gap << "\n";
 		}
 	} // ~for read.alignments
 	if (is_zip) {
-		auto ret = vzlib_out[id].defstr(ss.str(), fsv[id]); // Z_STREAM_END | Z_OK - ok
+		auto ret = vzlib_out[id].defstr(ss.str(), bufv[id]); // Z_STREAM_END | Z_OK - ok
 		if (ret < Z_OK || ret > Z_STREAM_END) {
 			ERR("Failed deflating readstring: ", ss.str(), " zlib status: ", ret);
 		}
 	}
 	else {
-		fsv[id] << ss.str();
+		bufv[id] << ss.str();
 	}
 } // ~ReportSam::append
 
@@ -199,11 +197,14 @@ void ReportSam::write_header(Runopts& opts)
 	}
 	ss << "@PG\tID:sortmerna\tVN:1.0\tCL:" << opts.cmdline << std::endl;
 	if (is_zip) {
-		auto ret = vzlib_out[0].defstr(ss.str(), fsv[0]); // Z_STREAM_END | Z_OK - ok
+		auto ret = vzlib_out[0].defstr(ss.str(), bufv[0]); // Z_STREAM_END | Z_OK - ok
 		if (ret < Z_OK || ret > Z_STREAM_END) {
 			ERR("Failed deflating readstring: ", ss.str(), " zlib status: ", ret);
 		}
 	}
 	else
-		fsv[0] << ss.str();
+		bufv[0] << ss.str();
+	// the header goes first, before the report threads start
+	seal(0);
+	write(0);
 } // ~ReportSam::write_header
\ No newline at end of file
@@ -0,0 +1,301 @@
+/*
+ @copyright 2016-2021  Clarity Genomics BVBA
+ @copyright 2012-2016  Bonsai Bioinformatics Research Group
+ @copyright 2014-2016  Knight Lab, Department of Pediatrics, UCSD, La Jolla
+
+ @parblock
+ SortMeRNA - next-generation reads filter for metatranscriptomic or total RNA
+ This is a free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SortMeRNA is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with SortMeRNA. If not, see <http://www.gnu.org/licenses/>.
+ @endparblock
+
+ @contributors Jenya Kopylova   jenya.kopylov@gmail.com
+			   Laurent No      laurent.noe@lifl.fr
+			   Pierre Pericard  pierre.pericard@lifl.fr
+			   Daniel McDonald  wasade@gmail.com
+			   Mikal Salson    mikael.salson@lifl.fr
+			   Hlne Touzet    helene.touzet@lifl.fr
+			   Rob Knight       robknight@ucsd.edu
+*/
+
+/* 
+ * FILE: resultstore.cpp
+ * Created: Oct 16, 2026
+ */
+#include <fstream>
+#include <charconv>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#if defined(_WIN32)
+#  include "windows.h"
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "resultstore.hpp"
+#include "common.hpp"
+
+namespace {
+	const std::size_t SLOTS_SEG_SIZE = (std::size_t(1) << Resultstore::SLOT_SEG_BITS) * 16; // sizeof(Slot)
+	const std::size_t HEAP_SEG_SIZE = std::size_t(1) << Resultstore::HEAP_SEG_BITS;
+	const std::string META_FILE = "results.meta";
+
+	std::atomic<unsigned> num_stores(0);
+
+	// the last segment used by the thread. The reads are processed sequentially, so mostly a hit.
+	struct SegmentCache {
+		unsigned store_id;
+		uint64_t seg_key;
+		char* addr;
+	};
+	thread_local SegmentCache seg_cache[2] = { {0, 0, nullptr}, {0, 0, nullptr} }; // [0] slots, [1] heap
+
+	/* split the read ID 'readsfile_readnumber' into the numbers. False if the key is not a read ID */
+	bool parse_id(const std::string& key, uint64_t& file, uint64_t& num)
+	{
+		auto sep = key.find('_');
+		if (sep == std::string::npos) return false;
+		auto end = key.data() + key.size();
+		auto res = std::from_chars(key.data(), key.data() + sep, file);
+		if (res.ec != std::errc() || res.ptr != key.data() + sep) return false;
+		res = std::from_chars(key.data() + sep + 1, end, num);
+		return res.ec == std::errc() && res.ptr == end;
+	}
+}
+
+Resultstore::Resultstore(const std::filesystem::path& dir) : dir(dir), store_id(++num_stores), heap_tail(0)
+{
+	load_meta();
+	load_tail();
+}
+
+Resultstore::~Resultstore()
+{
+	store_meta();
+	for (auto const& seg : segments) {
+		auto size = seg.first & SLOTS_KEY ? SLOTS_SEG_SIZE : HEAP_SEG_SIZE;
+#if defined(_WIN32)
+		UnmapViewOfFile(seg.second);
+#else
+		munmap(seg.second, size);
+#endif
+	}
+}
+
+void Resultstore::put(const std::string& key, const std::string& val)
+{
+	uint64_t file = 0, num = 0;
+	if (!parse_id(key, file, num)) {
+		std::lock_guard<std::mutex> lock(meta_lock);
+		meta[key] = val;
+		store_meta();
+		return;
+	}
+
+	auto slot = reinterpret_cast<Slot*>(find_segment(SLOTS_KEY | file << 40 | num >> SLOT_SEG_BITS, true))
+		+ (num & ((1ULL << SLOT_SEG_BITS) - 1));
+	if (val.size() > HEAP_SEG_SIZE) {
+		ERR("The result of the read ", key, " of size ", val.size(), " exceeds the heap segment size ", HEAP_SEG_SIZE);
+		exit(EXIT_FAILURE);
+	}
+	if (val.size() > slot->capacity) {
+		auto capacity = (uint32_t)std::min((val.size() + 63) & ~std::size_t(63), HEAP_SEG_SIZE); // room to grow in place
+		slot->offset = alloc(capacity);
+		slot->capacity = capacity;
+	}
+	if (val.size() > 0) {
+		auto heap = find_segment(slot->offset >> HEAP_SEG_BITS, true);
+		std::memcpy(heap + (slot->offset & (HEAP_SEG_SIZE - 1)), val.data(), val.size());
+	}
+	slot->size = (uint32_t)val.size();
+} // ~Resultstore::put
+
+/*
+ * @return the stored value, or empty string if the key is not found - same as 'KeyValueDatabase::get'
+ */
+std::string Resultstore::get(const std::string& key)
+{
+	uint64_t file = 0, num = 0;
+	if (!parse_id(key, file, num)) {
+		std::lock_guard<std::mutex> lock(meta_lock);
+		auto it = meta.find(key);
+		return it == meta.end() ? "" : it->second;
+	}
+
+	auto slots = reinterpret_cast<Slot*>(find_segment(SLOTS_KEY | file << 40 | num >> SLOT_SEG_BITS, false));
+	if (slots == nullptr) return "";
+	auto const& slot = slots[num & ((1ULL << SLOT_SEG_BITS) - 1)];
+	if (slot.size == 0) return "";
+	auto heap = find_segment(slot.offset >> HEAP_SEG_BITS, false);
+	if (heap == nullptr) return "";
+	return std::string(heap + (slot.offset & (HEAP_SEG_SIZE - 1)), slot.size);
+} // ~Resultstore::get
+
+/*
+ * @param seg_key  heap segment number, or SLOTS_KEY | reads file << 40 | slots segment number
+ * @param is_create  create the segment file if it does not exist
+ * @return address of the mapped segment, or null if the segment file does not exist and 'is_create' is false
+ */
+char* Resultstore::find_segment(uint64_t seg_key, bool is_create)
+{
+	auto is_slots = (seg_key & SLOTS_KEY) != 0;
+	auto& cache = seg_cache[is_slots ? 0 : 1];
+	if (cache.store_id == store_id && cache.seg_key == seg_key)
+		return cache.addr;
+
+	char* addr = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(seg_lock);
+		auto it = segments.find(seg_key);
+		if (it != segments.end()) {
+			addr = it->second;
+		}
+		else {
+			auto fname = is_slots
+				? "slots_" + std::to_string((seg_key & ~SLOTS_KEY) >> 40) + "_" + std::to_string(seg_key & ((1ULL << 40) - 1)) + ".dat"
+				: "heap_" + std::to_string(seg_key) + ".dat";
+			addr = map_segment(dir / fname, is_slots ? SLOTS_SEG_SIZE : HEAP_SEG_SIZE, is_create);
+			if (addr != nullptr) segments[seg_key] = addr;
+		}
+	}
+	if (addr != nullptr) cache = { store_id, seg_key, addr };
+	return addr;
+} // ~Resultstore::find_segment
+
+/*
+ * map the file read-write and shared. The file is extended with zeros to the given size i.e. the new slots are empty
+ */
+char* Resultstore::map_segment(const std::filesystem::path& file, std::size_t size, bool is_create)
+{
+	char* addr = nullptr;
+#if defined(_WIN32)
+	HANDLE hfile = CreateFileA(file.string().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, is_create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hfile == INVALID_HANDLE_VALUE && !is_create) return nullptr;
+	if (hfile != INVALID_HANDLE_VALUE)
+	{
+		HANDLE hmap = CreateFileMappingA(hfile, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+		if (hmap != NULL)
+		{
+			addr = (char*)MapViewOfFile(hmap, FILE_MAP_ALL_ACCESS, 0, 0, size);
+			CloseHandle(hmap);
+		}
+		CloseHandle(hfile);
+	}
+#else
+	int fd = open(file.c_str(), is_create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+	if (fd == -1 && !is_create) return nullptr;
+	struct stat st;
+	if (fd != -1 && fstat(fd, &st) == 0 && (st.st_size >= (off_t)size || ftruncate(fd, size) == 0))
+	{
+		void* res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (res != MAP_FAILED) addr = (char*)res;
+	}
+	if (fd != -1) close(fd);
+#endif
+	if (addr == nullptr) {
+		ERR("Failed to map the results file ", file);
+		exit(EXIT_FAILURE);
+	}
+	return addr;
+} // ~Resultstore::map_segment
+
+/*
+ * reserve a heap record. A record never spans two heap segments
+ */
+uint64_t Resultstore::alloc(uint32_t size)
+{
+	auto offset = heap_tail.load(std::memory_order_relaxed);
+	for (;;) {
+		auto start = offset;
+		if ((start & (HEAP_SEG_SIZE - 1)) + size > HEAP_SEG_SIZE)
+			start = (start | (HEAP_SEG_SIZE - 1)) + 1; // start of the next segment
+		if (heap_tail.compare_exchange_weak(offset, start + size, std::memory_order_relaxed))
+			return start;
+	}
+} // ~Resultstore::alloc
+
+/*
+ * results.meta: heap tail, number of entries, then for each entry: key size, key, value size, value
+ */
+void Resultstore::load_meta()
+{
+	std::ifstream ifs(dir / META_FILE, std::ios::binary);
+	if (!ifs.good()) return;
+	uint64_t tail = 0, count = 0;
+	ifs.read(reinterpret_cast<char*>(&tail), sizeof(tail));
+	ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
+	for (uint64_t i = 0; i < count && ifs.good(); ++i) {
+		std::string key, val;
+		uint64_t len = 0;
+		ifs.read(reinterpret_cast<char*>(&len), sizeof(len));
+		key.resize(len);
+		ifs.read(&key[0], len);
+		ifs.read(reinterpret_cast<char*>(&len), sizeof(len));
+		val.resize(len);
+		ifs.read(&val[0], len);
+		meta[key] = val;
+	}
+	heap_tail = tail;
+} // ~Resultstore::load_meta
+
+/*
+ * 'results.meta' is stored on exit, so after a killed run its heap tail can be stale. 
+ * The tail is set past the end of the last record referenced by the slots
+ */
+void Resultstore::load_tail()
+{
+	std::error_code ec;
+	if (!std::filesystem::is_directory(dir, ec)) return;
+	uint64_t tail = heap_tail.load();
+	std::vector<Slot> slots(std::size_t(1) << 16);
+	for (auto const& entry : std::filesystem::directory_iterator(dir, ec)) {
+		if (entry.path().filename().string().rfind("slots_", 0) != 0) continue;
+		std::ifstream ifs(entry.path(), std::ios::binary);
+		for (; ifs.good();) {
+			ifs.read(reinterpret_cast<char*>(slots.data()), slots.size() * sizeof(Slot));
+			auto num = (std::size_t)ifs.gcount() / sizeof(Slot);
+			for (std::size_t i = 0; i < num; ++i) {
+				if (slots[i].capacity > 0)
+					tail = std::max<uint64_t>(tail, slots[i].offset + slots[i].capacity);
+			}
+		}
+	}
+	heap_tail = tail;
+} // ~Resultstore::load_tail
+
+void Resultstore::store_meta()
+{
+	std::ofstream ofs(dir / META_FILE, std::ios::binary | std::ios::trunc);
+	uint64_t tail = heap_tail.load();
+	uint64_t count = meta.size();
+	ofs.write(reinterpret_cast<const char*>(&tail), sizeof(tail));
+	ofs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	for (auto const& entry : meta) {
+		uint64_t len = entry.first.size();
+		ofs.write(reinterpret_cast<const char*>(&len), sizeof(len));
+		ofs.write(entry.first.data(), len);
+		len = entry.second.size();
+		ofs.write(reinterpret_cast<const char*>(&len), sizeof(len));
+		ofs.write(entry.second.data(), len);
+	}
+	if (!ofs.good()) {
+		ERR("Failed writing ", dir / META_FILE);
+		exit(EXIT_FAILURE);
+	}
+} // ~Resultstore::store_meta
@@ -47,11 +47,26 @@
 #include <stdint.h>
 #include <string.h>
 #include <emmintrin.h>
+#include <immintrin.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <math.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
 
 #include "ssw.h"
 
+/* AVX2 and AVX-512 kernels are compiled for their instruction set only, and selected at runtime (see ssw_simd_supported) */
+#ifdef __GNUC__
+#define SSW_TARGET_AVX2 __attribute__((target("avx2")))
+#define SSW_TARGET_AVX512 __attribute__((target("avx512bw")))
+#else
+#define SSW_TARGET_AVX2
+#define SSW_TARGET_AVX512
+#endif
+
 #ifdef __GNUC__
 #define LIKELY(x) __builtin_expect((x),1)
 #define UNLIKELY(x) __builtin_expect((x),0)
@@ -85,15 +100,43 @@ typedef struct {
 } cigar;
 
 struct _profile {
-	__m128i* profile_byte;	// 0: none
-	__m128i* profile_word;	// 0: none
+	void* profile_byte;	// 0: none. Layout depends on 'simd'
+	void* profile_word;	// 0: none. Layout depends on 'simd'
 	const int8_t* read;
 	const int8_t* mat;
 	int32_t readLen;
 	int32_t n;
 	uint8_t bias;
+	int simd; // SSW_SSE2 | SSW_AVX2 | SSW_AVX512 kernels the profile was built for
 };
 
+/* vector buffers aligned for the widest register (64 bytes), zero initialized */
+static void* ssw_calloc_aligned(size_t num, size_t size)
+{
+	void* p = 0;
+#ifdef _MSC_VER
+	p = _aligned_malloc(num * size, 64);
+#else
+	if (posix_memalign(&p, 64, num * size) != 0) p = 0;
+#endif
+	if (p == NULL)
+	{
+		fprintf(stderr, "    %sERROR%s: could not allocate memory for alignment (ssw.c)\n", "\033[0;31m", "\033[0m");
+		exit(EXIT_FAILURE);
+	}
+	memset(p, 0, num * size);
+	return p;
+}
+
+static void ssw_free_aligned(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
 // TODO: remove - never referenced
 int8_t rc_table[128] = {
 	4, 4,  4, 4,  4,  4,  4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
@@ -107,466 +150,297 @@ int8_t rc_table[128] = {
 };
 
 
-/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch. */
-__m128i* qP_byte(const int8_t* read_num,
-	const int8_t* mat,
-	const int32_t readLen,
-	const int32_t n,	/* the edge length of the square matrix mat */
-	uint8_t bias) {
-
-	int32_t segLen = (readLen + 15) / 16; /* Split the 128 bit register into 16 pieces.
-									 Each piece is 8 bit. Split the read into 16 segments.
-									 Calculate 16 segments in parallel.
-								   */
-	__m128i* vProfile = (__m128i*)malloc(n * segLen * sizeof(__m128i));
-	int8_t* t = (int8_t*)vProfile;
-	int32_t nt, i, j, segNum;
-
-	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
-	for (nt = 0; LIKELY(nt < n); nt++) {
-		for (i = 0; i < segLen; i++) {
-			j = i;
-			for (segNum = 0; LIKELY(segNum < 16); segNum++) {
-				*t++ = j >= readLen ? bias : mat[nt * n + read_num[j]] + bias;
-				j += segLen;
-			}
-		}
-	}
-	return vProfile;
+/*
+ * Striped Smith-Waterman kernels, instantiated from ssw_kernel.h for every instruction set.
+ * All the kernels give the same results, the widest supported by the CPU is used (see ssw_simd_supported).
+ */
+
+/* SSE2 kernels: 16 lanes of 8 bits or 8 lanes of 16 bits */
+static inline uint8_t hmax_epu8_sse2(__m128i m)
+{
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+	return (uint8_t)_mm_extract_epi16(m, 0);
 }
 
-/* Striped Smith-Waterman
-   Record the highest score of each reference position.
-   Return the alignment score and ending position of the best alignment, 2nd best alignment, etc.
-   Gap begin and gap extension are different.
-   wight_match > 0, all other weights < 0.
-   The returned positions are 0-based.
- */
-alignment_end* sw_sse2_byte(const int8_t* ref,
-	int8_t ref_dir,	// 0: forward ref; 1: reverse ref
-	int32_t refLen,
-	int32_t readLen,
-	const uint8_t weight_gapO, /* will be used as - */
-	const uint8_t weight_gapE, /* will be used as - */
-	__m128i* vProfile,
-	uint8_t terminate,	/* the best alignment score: used to terminate
-						  the matrix calculation when locating the
-						  alignment beginning point. If this score
-						  is set to 0, it will not be used */
-	uint8_t bias,  /* Shift 0 point to a positive value. */
-	int32_t maskLen) {
-
-#define max16(m, vm) (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 8)); \
-					  (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 4)); \
-					  (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 2)); \
-					  (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 1)); \
-					  (m) = _mm_extract_epi16((vm), 0)
-
-	uint8_t max = 0;		                     /* the max alignment score */
-	int32_t end_read = readLen - 1;
-	int32_t end_ref = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
-	int32_t segLen = (readLen + 15) / 16; /* number of segment */
-
-	/* array to record the largest score of each reference position */
-	uint8_t* maxColumn = (uint8_t*)calloc(refLen, 1);
-
-	/* array to record the alignment read ending position of the largest score of each reference position */
-	int32_t* end_read_column = (int32_t*)calloc(refLen, sizeof(int32_t));
-
-	/* Define 16 byte 0 vector. */
-	__m128i vZero = _mm_set1_epi32(0);
-
-	__m128i* pvHStore = (__m128i*) calloc(segLen, sizeof(__m128i));
-	__m128i* pvHLoad = (__m128i*) calloc(segLen, sizeof(__m128i));
-	__m128i* pvE = (__m128i*) calloc(segLen, sizeof(__m128i));
-	__m128i* pvHmax = (__m128i*) calloc(segLen, sizeof(__m128i));
-
-	int32_t i, j;
-	/* 16 byte insertion begin vector */
-	__m128i vGapO = _mm_set1_epi8(weight_gapO);
-
-	/* 16 byte insertion extension vector */
-	__m128i vGapE = _mm_set1_epi8(weight_gapE);
-
-	/* 16 byte bias vector */
-	__m128i vBias = _mm_set1_epi8(bias);
-
-	__m128i vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
-	__m128i vMaxMark = vZero; /* Trace the highest score till the previous column. */
-	__m128i vTemp;
-	int32_t edge, begin = 0, end = refLen, step = 1;
-	//	int32_t distance = readLen * 2 / 3;
-	//	int32_t distance = readLen / 2;
-	//	int32_t distance = readLen;
-
-		/* outer loop to process the reference sequence */
-	if (ref_dir == 1) {
-		begin = refLen - 1;
-		end = -1;
-		step = -1;
-	}
-	for (i = begin; LIKELY(i != end); i += step) {
-		int32_t cmp;
-		__m128i e = vZero, vF = vZero, vMaxColumn = vZero; /* Initialize F value to 0.
-							   Any errors to vH values will be corrected in the Lazy_F loop.
-							 */
-							 //		max16(maxColumn[i], vMaxColumn);
-							 //		fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
-
-		__m128i vH = pvHStore[segLen - 1];
-		vH = _mm_slli_si128(vH, 1); /* Shift the 128-bit value in vH left by 1 byte. */
-		__m128i* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
-
-		/* Swap the 2 H buffers. */
-		__m128i* pv = pvHLoad;
-		pvHLoad = pvHStore;
-		pvHStore = pv;
-
-		/* inner loop to process the query sequence */
-		for (j = 0; LIKELY(j < segLen); ++j) {
-			vH = _mm_adds_epu8(vH, _mm_load_si128(vP + j));
-			vH = _mm_subs_epu8(vH, vBias); /* vH will be always > 0 */
-	//	max16(maxColumn[i], vH);
-	//	fprintf(stderr, "H[%d]: %d\n", i, maxColumn[i]);
-//	int8_t* t;
-//	int32_t ti;
-//for (t = (int8_t*)&vH, ti = 0; ti < 16; ++ti) fprintf(stderr, "%d\t", *t++);
-
-			/* Get max from vH, vE and vF. */
-			e = _mm_load_si128(pvE + j);
-			vH = _mm_max_epu8(vH, e);
-			vH = _mm_max_epu8(vH, vF);
-			vMaxColumn = _mm_max_epu8(vMaxColumn, vH);
-
-			//	max16(maxColumn[i], vMaxColumn);
-			//	fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
-		//	for (t = (int8_t*)&vMaxColumn, ti = 0; ti < 16; ++ti) fprintf(stderr, "%d\t", *t++);
-
-					/* Save vH values. */
-			_mm_store_si128(pvHStore + j, vH);
-
-			/* Update vE value. */
-			vH = _mm_subs_epu8(vH, vGapO); /* saturation arithmetic, result >= 0 */
-			e = _mm_subs_epu8(e, vGapE);
-			e = _mm_max_epu8(e, vH);
-			_mm_store_si128(pvE + j, e);
-
-			/* Update vF value. */
-			vF = _mm_subs_epu8(vF, vGapE);
-			vF = _mm_max_epu8(vF, vH);
-
-			/* Load the next vH. */
-			vH = _mm_load_si128(pvHLoad + j);
-		}
+static inline uint16_t hmax_epi16_sse2(__m128i m)
+{
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+	return (uint16_t)_mm_extract_epi16(m, 0);
+}
 
-		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
-		/* reset pointers to the start of the saved data */
-		j = 0;
-		vH = _mm_load_si128(pvHStore + j);
-
-		/*  the computed vF value is for the given column.  since */
-		/*  we are at the end, we need to shift the vF value over */
-		/*  to the next column. */
-		vF = _mm_slli_si128(vF, 1);
-		vTemp = _mm_subs_epu8(vH, vGapO);
-		vTemp = _mm_subs_epu8(vF, vTemp);
-		vTemp = _mm_cmpeq_epi8(vTemp, vZero);
-		cmp = _mm_movemask_epi8(vTemp);
-
-		while (cmp != 0xffff)
-		{
-			vH = _mm_max_epu8(vH, vF);
-			vMaxColumn = _mm_max_epu8(vMaxColumn, vH);
-			_mm_store_si128(pvHStore + j, vH);
-			vF = _mm_subs_epu8(vF, vGapE);
-			j++;
-			if (j >= segLen)
-			{
-				j = 0;
-				vF = _mm_slli_si128(vF, 1);
-			}
-			vH = _mm_load_si128(pvHStore + j);
+/* prefix max over the lanes decreasing by 'd' per lane: lane k = max(v[m] - (k - m) * d), m <= k */
+static inline __m128i carry_epu8_sse2(__m128i v, __m128i d)
+{
+	v = _mm_max_epu8(v, _mm_subs_epu8(_mm_slli_si128(v, 1), d));
+	d = _mm_adds_epu8(d, d);
+	v = _mm_max_epu8(v, _mm_subs_epu8(_mm_slli_si128(v, 2), d));
+	d = _mm_adds_epu8(d, d);
+	v = _mm_max_epu8(v, _mm_subs_epu8(_mm_slli_si128(v, 4), d));
+	d = _mm_adds_epu8(d, d);
+	return _mm_max_epu8(v, _mm_subs_epu8(_mm_slli_si128(v, 8), d));
+}
 
-			vTemp = _mm_subs_epu8(vH, vGapO);
-			vTemp = _mm_subs_epu8(vF, vTemp);
-			vTemp = _mm_cmpeq_epi8(vTemp, vZero);
-			cmp = _mm_movemask_epi8(vTemp);
-		}
+static inline __m128i carry_epu16_sse2(__m128i v, __m128i d)
+{
+	v = _mm_max_epi16(v, _mm_subs_epu16(_mm_slli_si128(v, 2), d));
+	d = _mm_adds_epu16(d, d);
+	v = _mm_max_epi16(v, _mm_subs_epu16(_mm_slli_si128(v, 4), d));
+	d = _mm_adds_epu16(d, d);
+	return _mm_max_epi16(v, _mm_subs_epu16(_mm_slli_si128(v, 8), d));
+}
 
-		vMaxScore = _mm_max_epu8(vMaxScore, vMaxColumn);
-		vTemp = _mm_cmpeq_epi8(vMaxMark, vMaxScore);
-		cmp = _mm_movemask_epi8(vTemp);
-		if (cmp != 0xffff) {
-			uint8_t temp;
-			vMaxMark = vMaxScore;
-			max16(temp, vMaxScore);
-			vMaxScore = vMaxMark;
+#define SSW_SUFFIX _sse2
+#define SSW_TARGET
+#define SSW_VEC __m128i
+#define SSW_BYTES 16
+#define v_zero() _mm_setzero_si128()
+#define v_set1_epi8(x) _mm_set1_epi8(x)
+#define v_set1_epi16(x) _mm_set1_epi16(x)
+#define v_load(p) _mm_load_si128(p)
+#define v_store(p, v) _mm_store_si128((p), (v))
+#define v_adds_epu8 _mm_adds_epu8
+#define v_subs_epu8 _mm_subs_epu8
+#define v_max_epu8 _mm_max_epu8
+#define v_adds_epi16 _mm_adds_epi16
+#define v_subs_epu16 _mm_subs_epu16
+#define v_max_epi16 _mm_max_epi16
+#define v_slli(v, n) _mm_slli_si128((v), (n))
+#define v_hmax_epu8(v) hmax_epu8_sse2(v)
+#define v_hmax_epi16(v) hmax_epi16_sse2(v)
+#define v_all_eq(a, b) (_mm_movemask_epi8(_mm_cmpeq_epi8((a), (b))) == 0xffff)
+#define v_any_gt_epi16(a, b) (_mm_movemask_epi8(_mm_cmpgt_epi16((a), (b))) != 0)
+#define v_carry_epu8(v, d) carry_epu8_sse2((v), (d))
+#define v_carry_epu16(v, d) carry_epu16_sse2((v), (d))
+#include "ssw_kernel.h"
+
+/* AVX2 kernels: 32 lanes of 8 bits or 16 lanes of 16 bits */
+static inline SSW_TARGET_AVX2 uint8_t hmax_epu8_avx2(__m256i v)
+{
+	return hmax_epu8_sse2(_mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
 
-			if (LIKELY(temp > max)) {
-				max = temp;
-				if (max + bias >= 255) break; //overflow
+static inline SSW_TARGET_AVX2 uint16_t hmax_epi16_avx2(__m256i v)
+{
+	return hmax_epi16_sse2(_mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
 
-				end_ref = i;
+/* shift left by 'n' bytes, n < 16. The 128-bit lanes are shifted separately: carry the top bytes of the low lane into the high one */
+#define slli_avx2(v, n) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 16 - (n))
 
-				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
-				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
-			}
-		}
+static inline SSW_TARGET_AVX2 __m256i carry_epu8_avx2(__m256i v, __m256i d)
+{
+	v = _mm256_max_epu8(v, _mm256_subs_epu8(slli_avx2(v, 1), d));
+	d = _mm256_adds_epu8(d, d);
+	v = _mm256_max_epu8(v, _mm256_subs_epu8(slli_avx2(v, 2), d));
+	d = _mm256_adds_epu8(d, d);
+	v = _mm256_max_epu8(v, _mm256_subs_epu8(slli_avx2(v, 4), d));
+	d = _mm256_adds_epu8(d, d);
+	v = _mm256_max_epu8(v, _mm256_subs_epu8(slli_avx2(v, 8), d));
+	d = _mm256_adds_epu8(d, d);
+	return _mm256_max_epu8(v, _mm256_subs_epu8(_mm256_permute2x128_si256(v, v, 0x08), d)); // 16 bytes
+}
 
-		/* Record the max score of current column. */
-		max16(maxColumn[i], vMaxColumn);
-		//		fprintf(stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]);
-		if (maxColumn[i] == terminate) break;
-	}
+static inline SSW_TARGET_AVX2 __m256i carry_epu16_avx2(__m256i v, __m256i d)
+{
+	v = _mm256_max_epi16(v, _mm256_subs_epu16(slli_avx2(v, 2), d));
+	d = _mm256_adds_epu16(d, d);
+	v = _mm256_max_epi16(v, _mm256_subs_epu16(slli_avx2(v, 4), d));
+	d = _mm256_adds_epu16(d, d);
+	v = _mm256_max_epi16(v, _mm256_subs_epu16(slli_avx2(v, 8), d));
+	d = _mm256_adds_epu16(d, d);
+	return _mm256_max_epi16(v, _mm256_subs_epu16(_mm256_permute2x128_si256(v, v, 0x08), d)); // 16 bytes
+}
 
-	/* Trace the alignment ending position on read. */
-	uint8_t *t = (uint8_t*)pvHmax;
-	int32_t column_len = segLen * 16;
-	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
-		int32_t temp;
-		if (*t == max) {
-			temp = i / 16 + i % 16 * segLen;
-			if (temp < end_read) end_read = temp;
-		}
-	}
+#define SSW_SUFFIX _avx2
+#define SSW_TARGET SSW_TARGET_AVX2
+#define SSW_VEC __m256i
+#define SSW_BYTES 32
+#define v_zero() _mm256_setzero_si256()
+#define v_set1_epi8(x) _mm256_set1_epi8(x)
+#define v_set1_epi16(x) _mm256_set1_epi16(x)
+#define v_load(p) _mm256_load_si256(p)
+#define v_store(p, v) _mm256_store_si256((p), (v))
+#define v_adds_epu8 _mm256_adds_epu8
+#define v_subs_epu8 _mm256_subs_epu8
+#define v_max_epu8 _mm256_max_epu8
+#define v_adds_epi16 _mm256_adds_epi16
+#define v_subs_epu16 _mm256_subs_epu16
+#define v_max_epi16 _mm256_max_epi16
+#define v_slli(v, n) slli_avx2(v, n)
+#define v_hmax_epu8(v) hmax_epu8_avx2(v)
+#define v_hmax_epi16(v) hmax_epi16_avx2(v)
+#define v_all_eq(a, b) (_mm256_movemask_epi8(_mm256_cmpeq_epi8((a), (b))) == -1)
+#define v_any_gt_epi16(a, b) (_mm256_movemask_epi8(_mm256_cmpgt_epi16((a), (b))) != 0)
+#define v_carry_epu8(v, d) carry_epu8_avx2((v), (d))
+#define v_carry_epu16(v, d) carry_epu16_avx2((v), (d))
+#include "ssw_kernel.h"
+
+/* AVX-512 kernels: 64 lanes of 8 bits or 32 lanes of 16 bits */
+static inline SSW_TARGET_AVX512 uint8_t hmax_epu8_avx512(__m512i v)
+{
+	return hmax_epu8_avx2(_mm256_max_epu8(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1)));
+}
 
-	free(pvHmax);
-	free(pvE);
-	free(pvHLoad);
-	free(pvHStore);
-
-	/* Find the most possible 2nd best alignment. */
-	alignment_end* bests = (alignment_end*)calloc(2, sizeof(alignment_end));
-	bests[0].score = max + bias >= 255 ? 255 : max;
-	bests[0].ref = end_ref;
-	bests[0].read = end_read;
-
-	bests[1].score = 0;
-	bests[1].ref = 0;
-	bests[1].read = 0;
-
-	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
-	for (i = 0; i < edge; i++) {
-		//			fprintf (stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]); 
-		if (maxColumn[i] > bests[1].score) {
-			bests[1].score = maxColumn[i];
-			bests[1].ref = i;
-		}
-	}
-	edge = (end_ref + maskLen) > refLen ? refLen : (end_ref + maskLen);
-	for (i = edge + 1; i < refLen; i++) {
-		//			fprintf (stderr, "refLen: %d\tmaxColumn[%d]: %d\n", refLen, i, maxColumn[i]);
-		if (maxColumn[i] > bests[1].score) {
-			bests[1].score = maxColumn[i];
-			bests[1].ref = i;
-		}
-	}
+static inline SSW_TARGET_AVX512 uint16_t hmax_epi16_avx512(__m512i v)
+{
+	return hmax_epi16_avx2(_mm256_max_epi16(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1)));
+}
+
+/* shift left by 'n' bytes, n < 16. The 128-bit lanes are shifted separately: carry the top bytes of each lane into the next one */
+#define slli_avx512(v, n) _mm512_alignr_epi8((v), _mm512_alignr_epi32((v), _mm512_setzero_si512(), 12), 16 - (n))
 
-	free(maxColumn);
-	free(end_read_column);
-	return bests;
+static inline SSW_TARGET_AVX512 __m512i carry_epu8_avx512(__m512i v, __m512i d)
+{
+	v = _mm512_max_epu8(v, _mm512_subs_epu8(slli_avx512(v, 1), d));
+	d = _mm512_adds_epu8(d, d);
+	v = _mm512_max_epu8(v, _mm512_subs_epu8(slli_avx512(v, 2), d));
+	d = _mm512_adds_epu8(d, d);
+	v = _mm512_max_epu8(v, _mm512_subs_epu8(slli_avx512(v, 4), d));
+	d = _mm512_adds_epu8(d, d);
+	v = _mm512_max_epu8(v, _mm512_subs_epu8(slli_avx512(v, 8), d));
+	d = _mm512_adds_epu8(d, d);
+	v = _mm512_max_epu8(v, _mm512_subs_epu8(_mm512_alignr_epi32(v, _mm512_setzero_si512(), 12), d)); // 16 bytes
+	d = _mm512_adds_epu8(d, d);
+	return _mm512_max_epu8(v, _mm512_subs_epu8(_mm512_alignr_epi32(v, _mm512_setzero_si512(), 8), d)); // 32 bytes
 }
 
-__m128i* qP_word(const int8_t* read_num,
-	const int8_t* mat,
-	const int32_t readLen,
-	const int32_t n) {
-
-	int32_t segLen = (readLen + 7) / 8;
-	__m128i* vProfile = (__m128i*)malloc(n * segLen * sizeof(__m128i));
-	int16_t* t = (int16_t*)vProfile;
-	int32_t nt, i, j;
-	int32_t segNum;
-
-	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
-	for (nt = 0; LIKELY(nt < n); nt++) {
-		for (i = 0; i < segLen; i++) {
-			j = i;
-			for (segNum = 0; LIKELY(segNum < 8); segNum++) {
-				*t++ = j >= readLen ? 0 : mat[nt * n + read_num[j]];
-				j += segLen;
-			}
+static inline SSW_TARGET_AVX512 __m512i carry_epu16_avx512(__m512i v, __m512i d)
+{
+	v = _mm512_max_epi16(v, _mm512_subs_epu16(slli_avx512(v, 2), d));
+	d = _mm512_adds_epu16(d, d);
+	v = _mm512_max_epi16(v, _mm512_subs_epu16(slli_avx512(v, 4), d));
+	d = _mm512_adds_epu16(d, d);
+	v = _mm512_max_epi16(v, _mm512_subs_epu16(slli_avx512(v, 8), d));
+	d = _mm512_adds_epu16(d, d);
+	v = _mm512_max_epi16(v, _mm512_subs_epu16(_mm512_alignr_epi32(v, _mm512_setzero_si512(), 12), d)); // 16 bytes
+	d = _mm512_adds_epu16(d, d);
+	return _mm512_max_epi16(v, _mm512_subs_epu16(_mm512_alignr_epi32(v, _mm512_setzero_si512(), 8), d)); // 32 bytes
+}
+
+#define SSW_SUFFIX _avx512
+#define SSW_TARGET SSW_TARGET_AVX512
+#define SSW_VEC __m512i
+#define SSW_BYTES 64
+#define v_zero() _mm512_setzero_si512()
+#define v_set1_epi8(x) _mm512_set1_epi8(x)
+#define v_set1_epi16(x) _mm512_set1_epi16(x)
+#define v_load(p) _mm512_load_si512(p)
+#define v_store(p, v) _mm512_store_si512((p), (v))
+#define v_adds_epu8 _mm512_adds_epu8
+#define v_subs_epu8 _mm512_subs_epu8
+#define v_max_epu8 _mm512_max_epu8
+#define v_adds_epi16 _mm512_adds_epi16
+#define v_subs_epu16 _mm512_subs_epu16
+#define v_max_epi16 _mm512_max_epi16
+#define v_slli(v, n) slli_avx512(v, n)
+#define v_hmax_epu8(v) hmax_epu8_avx512(v)
+#define v_hmax_epi16(v) hmax_epi16_avx512(v)
+#define v_all_eq(a, b) (_mm512_cmpneq_epi8_mask((a), (b)) == 0)
+#define v_any_gt_epi16(a, b) (_mm512_cmpgt_epi16_mask((a), (b)) != 0)
+#define v_carry_epu8(v, d) carry_epu8_avx512((v), (d))
+#define v_carry_epu16(v, d) carry_epu16_avx512((v), (d))
+#include "ssw_kernel.h"
+
+static int ssw_simd = -1; /* kernels set with 'ssw_simd_select'. -1: the best supported by the CPU */
+
+int ssw_simd_supported(void)
+{
+#if defined(__GNUC__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw")) return SSW_AVX512;
+	if (__builtin_cpu_supports("avx2")) return SSW_AVX2;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuidex(info, 1, 0);
+		/* OSXSAVE and AVX, and the OS saves the YMM registers */
+		if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)))
+		{
+			unsigned long long xcr0 = _xgetbv(0);
+			__cpuidex(info, 7, 0);
+			/* AVX512F, AVX512BW, and the OS saves the opmask and ZMM registers */
+			if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) && (info[1] & (1 << 30))) return SSW_AVX512;
+			if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5))) return SSW_AVX2;
 		}
 	}
-	return vProfile;
+#endif
+	return SSW_SSE2;
 }
 
-alignment_end* sw_sse2_word(const int8_t* ref,
-	int8_t ref_dir,	// 0: forward ref; 1: reverse ref
-	int32_t refLen,
-	int32_t readLen,
-	const uint8_t weight_gapO, /* will be used as - */
-	const uint8_t weight_gapE, /* will be used as - */
-	__m128i* vProfile,
-	uint16_t terminate,
-	int32_t maskLen) {
-
-#define max8(m, vm) (vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 8)); \
-					(vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 4)); \
-					(vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 2)); \
-					(m) = _mm_extract_epi16((vm), 0)
-
-	uint16_t max = 0;		                     /* the max alignment score */
-	int32_t end_read = readLen - 1;
-	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
-	int32_t segLen = (readLen + 7) / 8; /* number of segment */
-
-	/* array to record the largest score of each reference position */
-	uint16_t* maxColumn = (uint16_t*)calloc(refLen, 2);
-
-	/* array to record the alignment read ending position of the largest score of each reference position */
-	int32_t* end_read_column = (int32_t*)calloc(refLen, sizeof(int32_t));
-
-	/* Define 16 byte 0 vector. */
-	__m128i vZero = _mm_set1_epi32(0);
-
-	__m128i* pvHStore = (__m128i*) calloc(segLen, sizeof(__m128i));
-	__m128i* pvHLoad = (__m128i*) calloc(segLen, sizeof(__m128i));
-	__m128i* pvE = (__m128i*) calloc(segLen, sizeof(__m128i));
-	__m128i* pvHmax = (__m128i*) calloc(segLen, sizeof(__m128i));
-
-	int32_t i, j, k;
-	/* 16 byte insertion begin vector */
-	__m128i vGapO = _mm_set1_epi16(weight_gapO);
-
-	/* 16 byte insertion extension vector */
-	__m128i vGapE = _mm_set1_epi16(weight_gapE);
-
-	/* 16 byte bias vector */
-	__m128i vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
-	__m128i vMaxMark = vZero; /* Trace the highest score till the previous column. */
-	__m128i vTemp;
-	int32_t edge, begin = 0, end = refLen, step = 1;
-
-	/* outer loop to process the reference sequence */
-	if (ref_dir == 1) {
-		begin = refLen - 1;
-		end = -1;
-		step = -1;
-	}
-	for (i = begin; LIKELY(i != end); i += step) {
-		int32_t cmp;
-		__m128i e = vZero, vF = vZero; /* Initialize F value to 0.
-							   Any errors to vH values will be corrected in the Lazy_F loop.
-							 */
-		__m128i vH = pvHStore[segLen - 1];
-		vH = _mm_slli_si128(vH, 2); /* Shift the 128-bit value in vH left by 2 byte. */
-
-		/* Swap the 2 H buffers. */
-		__m128i* pv = pvHLoad;
-
-		__m128i vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
-
-		__m128i* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
-		pvHLoad = pvHStore;
-		pvHStore = pv;
-
-		/* inner loop to process the query sequence */
-		for (j = 0; LIKELY(j < segLen); j++) {
-			vH = _mm_adds_epi16(vH, _mm_load_si128(vP + j));
-
-			/* Get max from vH, vE and vF. */
-			e = _mm_load_si128(pvE + j);
-			vH = _mm_max_epi16(vH, e);
-			vH = _mm_max_epi16(vH, vF);
-			vMaxColumn = _mm_max_epi16(vMaxColumn, vH);
-
-			/* Save vH values. */
-			_mm_store_si128(pvHStore + j, vH);
-
-			/* Update vE value. */
-			vH = _mm_subs_epu16(vH, vGapO); /* saturation arithmetic, result >= 0 */
-			e = _mm_subs_epu16(e, vGapE);
-			e = _mm_max_epi16(e, vH);
-			_mm_store_si128(pvE + j, e);
-
-			/* Update vF value. */
-			vF = _mm_subs_epu16(vF, vGapE);
-			vF = _mm_max_epi16(vF, vH);
-
-			/* Load the next vH. */
-			vH = _mm_load_si128(pvHLoad + j);
-		}
+void ssw_simd_select(int simd)
+{
+	int supported = ssw_simd_supported();
+	ssw_simd = simd < 0 || simd > supported ? supported : simd;
+}
 
-		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
-		for (k = 0; LIKELY(k < 8); ++k) {
-			vF = _mm_slli_si128(vF, 2);
-			for (j = 0; LIKELY(j < segLen); ++j) {
-				vH = _mm_load_si128(pvHStore + j);
-				vH = _mm_max_epi16(vH, vF);
-				_mm_store_si128(pvHStore + j, vH);
-				vH = _mm_subs_epu16(vH, vGapO);
-				vF = _mm_subs_epu16(vF, vGapE);
-				if (UNLIKELY(!_mm_movemask_epi8(_mm_cmpgt_epi16(vF, vH)))) goto end;
-			}
-		}
+int ssw_simd_selected(void)
+{
+	return ssw_simd < 0 ? ssw_simd_supported() : ssw_simd;
+}
 
-	end:
-		vMaxScore = _mm_max_epi16(vMaxScore, vMaxColumn);
-		vTemp = _mm_cmpeq_epi16(vMaxMark, vMaxScore);
-		cmp = _mm_movemask_epi8(vTemp);
-		if (cmp != 0xffff) {
-			uint16_t temp;
-			vMaxMark = vMaxScore;
-			max8(temp, vMaxScore);
-			vMaxScore = vMaxMark;
-
-			if (LIKELY(temp > max)) {
-				max = temp;
-				end_ref = i;
-				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
-			}
-		}
+static void* qP_byte_simd(int simd, const int8_t* read_num, const int8_t* mat, const int32_t readLen, const int32_t n, uint8_t bias)
+{
+	switch (simd) {
+	case SSW_AVX512: return qP_byte_avx512(read_num, mat, readLen, n, bias);
+	case SSW_AVX2: return qP_byte_avx2(read_num, mat, readLen, n, bias);
+	default: return qP_byte_sse2(read_num, mat, readLen, n, bias);
+	}
+}
 
-		/* Record the max score of current column. */
-		max8(maxColumn[i], vMaxColumn);
-		if (maxColumn[i] == terminate) break;
+static void* qP_word_simd(int simd, const int8_t* read_num, const int8_t* mat, const int32_t readLen, const int32_t n)
+{
+	switch (simd) {
+	case SSW_AVX512: return qP_word_avx512(read_num, mat, readLen, n);
+	case SSW_AVX2: return qP_word_avx2(read_num, mat, readLen, n);
+	default: return qP_word_sse2(read_num, mat, readLen, n);
 	}
+}
 
-	/* Trace the alignment ending position on read. */
-	uint16_t *t = (uint16_t*)pvHmax;
-	int32_t column_len = segLen * 8;
-	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
-		int32_t temp;
-		if (*t == max) {
-			temp = i / 8 + i % 8 * segLen;
-			if (temp < end_read) end_read = temp;
-		}
+static alignment_end* sw_byte_simd(int simd, const int8_t* ref, int8_t ref_dir, int32_t refLen, int32_t readLen,
+	const uint8_t weight_gapO, const uint8_t weight_gapE, void* vProfile, uint8_t terminate, uint8_t bias, int32_t maskLen)
+{
+	switch (simd) {
+	case SSW_AVX512: return sw_byte_avx512(ref, ref_dir, refLen, readLen, weight_gapO, weight_gapE, (__m512i*)vProfile, terminate, bias, maskLen);
+	case SSW_AVX2: return sw_byte_avx2(ref, ref_dir, refLen, readLen, weight_gapO, weight_gapE, (__m256i*)vProfile, terminate, bias, maskLen);
+	default: return sw_byte_sse2(ref, ref_dir, refLen, readLen, weight_gapO, weight_gapE, (__m128i*)vProfile, terminate, bias, maskLen);
 	}
+}
 
-	free(pvHmax);
-	free(pvE);
-	free(pvHLoad);
-	free(pvHStore);
-
-	/* Find the most possible 2nd best alignment. */
-	alignment_end* bests = (alignment_end*)calloc(2, sizeof(alignment_end));
-	bests[0].score = max;
-	bests[0].ref = end_ref;
-	bests[0].read = end_read;
-
-	bests[1].score = 0;
-	bests[1].ref = 0;
-	bests[1].read = 0;
-
-	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
-	for (i = 0; i < edge; i++) {
-		if (maxColumn[i] > bests[1].score) {
-			bests[1].score = maxColumn[i];
-			bests[1].ref = i;
-		}
+static alignment_end* sw_word_simd(int simd, const int8_t* ref, int8_t ref_dir, int32_t refLen, int32_t readLen,
+	const uint8_t weight_gapO, const uint8_t weight_gapE, void* vProfile, uint16_t terminate, int32_t maskLen)
+{
+	switch (simd) {
+	case SSW_AVX512: return sw_word_avx512(ref, ref_dir, refLen, readLen, weight_gapO, weight_gapE, (__m512i*)vProfile, terminate, maskLen);
+	case SSW_AVX2: return sw_word_avx2(ref, ref_dir, refLen, readLen, weight_gapO, weight_gapE, (__m256i*)vProfile, terminate, maskLen);
+	default: return sw_word_sse2(ref, ref_dir, refLen, readLen, weight_gapO, weight_gapE, (__m128i*)vProfile, terminate, maskLen);
 	}
-	edge = (end_ref + maskLen) > refLen ? refLen : (end_ref + maskLen);
-	for (i = edge; i < refLen; i++) {
-		if (maxColumn[i] > bests[1].score) {
-			bests[1].score = maxColumn[i];
-			bests[1].ref = i;
+}
+
+void ssw_score_batch(const s_profile* prof,
+	const int8_t** refs,
+	const int32_t* refLens,
+	int32_t num_refs,
+	const uint8_t weight_gapO,
+	const uint8_t weight_gapE,
+	uint16_t* scores)
+{
+	int32_t lanes = prof->simd == SSW_AVX512 ? 32 : prof->simd == SSW_AVX2 ? 16 : 8; /* word lanes */
+	int32_t i, num;
+	for (i = 0; i < num_refs; i += lanes) {
+		num = num_refs - i < lanes ? num_refs - i : lanes;
+		switch (prof->simd) {
+		case SSW_AVX512: sw_batch_avx512(prof->read, prof->readLen, prof->mat, prof->n, refs + i, refLens + i, num, weight_gapO, weight_gapE, scores + i); break;
+		case SSW_AVX2: sw_batch_avx2(prof->read, prof->readLen, prof->mat, prof->n, refs + i, refLens + i, num, weight_gapO, weight_gapE, scores + i); break;
+		default: sw_batch_sse2(prof->read, prof->readLen, prof->mat, prof->n, refs + i, refLens + i, num, weight_gapO, weight_gapE, scores + i);
 		}
 	}
-
-	free(maxColumn);
-	free(end_read_column);
-	return bests;
 }
 
 cigar* banded_sw(const int8_t* ref,
@@ -790,6 +664,7 @@ s_profile* ssw_init(const int8_t* read, const int32_t readLen, const int8_t* mat
 	p->profile_byte = 0;
 	p->profile_word = 0;
 	p->bias = 0;
+	p->simd = ssw_simd_selected();
 
 	if (score_size == 0 || score_size == 2) {
 		/* Find the bias to use in the substitution matrix */
@@ -798,9 +673,9 @@ s_profile* ssw_init(const int8_t* read, const int32_t readLen, const int8_t* mat
 		bias = abs(bias);
 
 		p->bias = bias;
-		p->profile_byte = qP_byte(read, mat, readLen, n, bias);
+		p->profile_byte = qP_byte_simd(p->simd, read, mat, readLen, n, bias);
 	}
-	if (score_size == 1 || score_size == 2) p->profile_word = qP_word(read, mat, readLen, n);
+	if (score_size == 1 || score_size == 2) p->profile_word = qP_word_simd(p->simd, read, mat, readLen, n);
 	p->read = read;
 	p->mat = mat;
 	p->readLen = readLen;
@@ -811,12 +686,12 @@ s_profile* ssw_init(const int8_t* read, const int32_t readLen, const int8_t* mat
 void init_destroy(s_profile** p) {
 	if ((*p)->profile_byte != NULL)
 	{
-		free((*p)->profile_byte);
+		ssw_free_aligned((*p)->profile_byte);
 		(*p)->profile_byte = NULL;
 	}
 	if ((*p)->profile_word != NULL)
 	{
-		free((*p)->profile_word);
+		ssw_free_aligned((*p)->profile_word);
 		(*p)->profile_word = NULL;
 	}
 	if (*p != NULL)
@@ -838,7 +713,7 @@ s_align* ssw_align(
 	const int32_t maskLen
 ) {
 	alignment_end* bests = 0, *bests_reverse = 0;
-	__m128i* vP = 0;
+	void* vP = 0;
 	int32_t word = 0, band_width = 0, readLen = prof->readLen;
 	int8_t* read_reverse = 0;
 	cigar* path;
@@ -854,12 +729,12 @@ s_align* ssw_align(
 	// Find the alignment scores and ending positions
 	if (prof->profile_byte) {
 
-		bests = sw_sse2_byte(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen);
+		bests = sw_byte_simd(prof->simd, ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen);
 
 		if (prof->profile_word && bests[0].score == 255) {
 			free(bests);
 			bests = NULL;
-			bests = sw_sse2_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
+			bests = sw_word_simd(prof->simd, ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
 			word = 1;
 		}
 		else if (bests[0].score == 255) {
@@ -868,7 +743,7 @@ s_align* ssw_align(
 		}
 	}
 	else if (prof->profile_word) {
-		bests = sw_sse2_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
+		bests = sw_word_simd(prof->simd, ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
 		word = 1;
 	}
 	else {
@@ -895,14 +770,14 @@ s_align* ssw_align(
 	// Find the beginning position of the best alignment.
 	read_reverse = seq_reverse(prof->read, r->read_end1);
 	if (word == 0) {
-		vP = qP_byte(read_reverse, prof->mat, r->read_end1 + 1, prof->n, prof->bias);
-		bests_reverse = sw_sse2_byte(ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, prof->bias, maskLen);
+		vP = qP_byte_simd(prof->simd, read_reverse, prof->mat, r->read_end1 + 1, prof->n, prof->bias);
+		bests_reverse = sw_byte_simd(prof->simd, ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, prof->bias, maskLen);
 	}
 	else {
-		vP = qP_word(read_reverse, prof->mat, r->read_end1 + 1, prof->n);
-		bests_reverse = sw_sse2_word(ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, maskLen); //jenya
+		vP = qP_word_simd(prof->simd, read_reverse, prof->mat, r->read_end1 + 1, prof->n);
+		bests_reverse = sw_word_simd(prof->simd, ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, maskLen); //jenya
 	}
-	free(vP);
+	ssw_free_aligned(vP);
 	vP = NULL;
 	free(read_reverse);
 	read_reverse = NULL;
@@ -149,7 +149,7 @@ void traversetrie_align(
 				// (1) the node element holds a pointer to another trie node
 				if (value == 1)
 				{
-					traversetrie_align(trie_t->nodetype.trie,
+					traversetrie_align(trie_child(trie_t),
 						lev_t,
 						++depth,
 						win_k1_ptr,
@@ -181,7 +181,7 @@ void traversetrie_align(
 					// number of characters per entry
 					uint32_t s = partialwin - depth;
 
-					unsigned char* start_bucket = (unsigned char*)trie_t->nodetype.bucket;
+					unsigned char* start_bucket = trie_bucket(trie_t);
 					if (start_bucket == NULL)
 					{
 						fprintf(stderr, "  ERROR: pointer start_bucket == NULL (paralleltraversal.cpp)\n");
@@ -319,7 +319,7 @@ void traversetrie_debug(NodeElement* trie_node, uint32_t depth, uint32_t &total_
 		if (value == 1)
 		{
 			kmer_keep.push_back((char)get_char[i]); //TESTING
-			traversetrie_debug(trie_node->nodetype.trie, ++depth, total_entries, kmer_keep, partialwin);
+			traversetrie_debug(trie_child(trie_node), ++depth, total_entries, kmer_keep, partialwin);
 			kmer_keep.pop_back();
 			--depth;
 		}
@@ -329,7 +329,7 @@ void traversetrie_debug(NodeElement* trie_node, uint32_t depth, uint32_t &total_
 		{
 			kmer_keep.push_back((char)get_char[i]); //TESTING
 
-			unsigned char* start_bucket = (unsigned char*)trie_node->nodetype.bucket;
+			unsigned char* start_bucket = trie_bucket(trie_node);
 			if (start_bucket == NULL)
 			{
 				fprintf(stderr, "  ERROR: pointer start_bucket == NULL (paralleltraversal.cpp)\n");
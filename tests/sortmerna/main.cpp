@@ -34,7 +34,13 @@
  */
 #include <string>
 #include <vector>
+#include <random>
 #include <iomanip> // setprecision
+#include <ctime> // std::clock
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <filesystem>
 
 #include "readfeed.hpp"
 #include "ThreadPool.hpp"
@@ -44,6 +50,10 @@
 #include "refstats.hpp"
 #include "references.hpp"
 #include "read.hpp"
+#include "alignment.hpp"
+#include "readsqueue.hpp"
+#include "kvdb.hpp"
+#include "output.hpp"
 
 // forward
 void kvdb_clear();
@@ -221,8 +231,735 @@ void test_3(int argc, char** argv)
 	//char** ptrToCstr = &cstr;
 }
 
+/*
+ * Positions table benchmark
+ * For each index part run the two scans of the 19-mer positions done by 'compute_lis_alignment' 
+ * (count the hits per reference, collect the hits on the best reference) for randomly selected 19-mer ids.
+ * Compares the flat (CSR) positions table with a copy of it using a separate heap array per 19-mer id.
+ * Fails if the positions of any 19-mer id differ between the two, or the scans give different results.
+ *
+ * test.exe 4 -ref silva-bac-16s-id90.fasta -reads SRR1635864_1.fastq -workdir ...
+ */
+bool test_4(int argc, char** argv)
+{
+	bool is_ok = true;
+	std::chrono::duration<double> diff(0);
+	Runopts opts(argc, argv);
+	KeyValueDatabase kvdb(opts.kvdbdir.string());
+	Readfeed readfeed(opts.feed_type, opts.readfiles, opts.num_proc_thread, opts.readb_dir, opts.is_paired);
+	Readstats readstats(readfeed.num_reads_tot, readfeed.length_all, readfeed.min_read_len, readfeed.max_read_len, kvdb, opts);
+	Index index(opts);
+	Refstats refstats(opts, readstats);
+
+	// count the hits on the references of each id and collect the hits on the most frequent reference
+	auto scan = [](std::vector<uint32_t>& ids, auto begin, auto end) {
+		uint64_t checksum = 0;
+		std::vector<uint32_t> hits;
+		for (auto id : ids)
+		{
+			uint32_t max_ref = 0;
+			for (auto p = begin(id); p != end(id); ++p)
+				max_ref = std::max(max_ref, p->seq);
+			for (auto p = begin(id); p != end(id); ++p)
+				if (p->seq == max_ref) hits.push_back(p->pos);
+			checksum += hits.size();
+			hits.clear();
+		}
+		return checksum;
+	};
+
+	for (size_t index_num = 0; index_num < opts.indexfiles.size(); ++index_num)
+	{
+		for (uint16_t idx_part = 0; idx_part < refstats.num_index_parts[index_num]; ++idx_part)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			index.load(index_num, idx_part, opts.indexfiles, refstats);
+			diff = std::chrono::high_resolution_clock::now() - start;
+			PRN_MEM_TIME("Index loaded.", diff.count());
+
+			uint32_t num_ids = index.number_elements;
+			std::vector<uint32_t> ids(num_ids);
+			std::mt19937 gen(1);
+			std::uniform_int_distribution<uint32_t> dis(0, num_ids - 1);
+			for (auto& id : ids) id = dis(gen);
+
+			start = std::chrono::high_resolution_clock::now();
+			auto csr_sum = scan(ids,
+				[&](uint32_t id) { return index.positions_tbl.begin(id); },
+				[&](uint32_t id) { return index.positions_tbl.end(id); });
+			std::chrono::duration<double> csr_time = std::chrono::high_resolution_clock::now() - start;
+
+			// a heap array per id as the positions table was stored before
+			std::vector<seq_pos*> arrs(num_ids);
+			for (uint32_t id = 0; id < num_ids; ++id)
+			{
+				arrs[id] = new seq_pos[index.positions_tbl.size(id)];
+				std::copy(index.positions_tbl.begin(id), index.positions_tbl.end(id), arrs[id]);
+			}
+
+			start = std::chrono::high_resolution_clock::now();
+			auto heap_sum = scan(ids,
+				[&](uint32_t id) { return arrs[id]; },
+				[&](uint32_t id) { return arrs[id] + index.positions_tbl.size(id); });
+			std::chrono::duration<double> heap_time = std::chrono::high_resolution_clock::now() - start;
+
+			// the same positions in the same order for every id, not only the sampled ones
+			bool is_same = csr_sum == heap_sum;
+			for (uint32_t id = 0; is_same && id < num_ids; ++id)
+				is_same = std::equal(index.positions_tbl.begin(id), index.positions_tbl.end(id), arrs[id],
+					[](const seq_pos& a, const seq_pos& b) { return a.pos == b.pos && a.seq == b.seq; });
+
+			for (auto arr : arrs) delete[] arr;
+			index.unload();
+
+			std::cout << "index: " << index_num << " part: " << idx_part << " ids: " << num_ids
+				<< " CSR: " << csr_time.count() << " sec  heap arrays: " << heap_time.count() << " sec" << std::endl;
+			if (!is_same) {
+				std::cout << "ERROR: the positions differ between the CSR table and the heap arrays" << std::endl;
+				is_ok = false;
+			}
+		}
+	}
+	std::cout << (is_ok ? "OK" : "ERROR") << std::endl;
+	return is_ok;
+} // ~test_4
+
+/*
+ * Candidate references counting benchmark
+ * Counts the k-mer hits per reference as done by 'compute_lis_alignment' using std::map
+ * (previous implementation) and RefHitCounter.
+ * Fails if the two give a different list of [reference : hits] for any read.
+ *
+ * test.exe 5 <number of hits per read e.g. 20000> [number of references hit (2000)] [number of reads (1000)]
+ */
+bool test_5(uint32_t num_hits, uint32_t num_refs, uint32_t num_reads)
+{
+	uint32_t min_hits = 2;
+	std::mt19937 gen(1);
+	// conserved seeds: few references get most of the hits
+	std::geometric_distribution<uint32_t> dis(10.0 / num_refs);
+	std::vector<std::vector<uint32_t>> reads(num_reads);
+	for (auto& hits : reads)
+		for (uint32_t i = 0; i < num_hits; ++i)
+			hits.push_back(dis(gen) % num_refs * 37);
+
+	// the previous implementation
+	auto map_count = [min_hits](const std::vector<uint32_t>& hits, std::vector<uint32pair>& refs_kmer_count_vec) {
+		std::map<uint32_t, uint32_t> refs_kmer_count_map;
+		refs_kmer_count_vec.clear();
+		for (auto seq : hits)
+		{
+			auto map_it = refs_kmer_count_map.find(seq);
+			if (map_it != refs_kmer_count_map.end())
+				map_it->second++;
+			else
+				refs_kmer_count_map[seq] = 1;
+		}
+		for (auto const& freq_pair : refs_kmer_count_map)
+			if (freq_pair.second >= min_hits)
+				refs_kmer_count_vec.push_back(freq_pair);
+		std::sort(refs_kmer_count_vec.begin(), refs_kmer_count_vec.end(), [](uint32pair e1, uint32pair e2) {
+			if (e1.second == e2.second)
+				return e1.first < e2.first;
+			return e1.second > e2.second;
+		});
+	};
+
+	uint64_t map_sum = 0;
+	std::vector<uint32pair> refs_kmer_count_vec;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto const& hits : reads)
+	{
+		map_count(hits, refs_kmer_count_vec);
+		// no reference may reach 'min_hits' e.g. with a single hit per read
+		map_sum += refs_kmer_count_vec.size() + (refs_kmer_count_vec.empty() ? 0 : refs_kmer_count_vec[0].first);
+	}
+	std::chrono::duration<double> map_time = std::chrono::high_resolution_clock::now() - start;
+
+	uint64_t counter_sum = 0;
+	RefHitCounter counter;
+	start = std::chrono::high_resolution_clock::now();
+	for (auto const& hits : reads)
+	{
+		counter.clear();
+		for (auto seq : hits)
+			counter.add(seq);
+		counter.count(min_hits);
+		counter_sum += counter.counts.size() + (counter.counts.empty() ? 0 : counter.counts[0].first);
+	}
+	std::chrono::duration<double> counter_time = std::chrono::high_resolution_clock::now() - start;
+
+	std::cout << "reads: " << num_reads << " hits per read: " << num_hits << " references: " << num_refs
+		<< " std::map: " << map_time.count() << " sec  RefHitCounter: " << counter_time.count() << " sec" << std::endl;
+
+	// the whole list of every read, not only the sums
+	uint32_t num_diff = map_sum == counter_sum ? 0 : 1;
+	for (auto const& hits : reads)
+	{
+		map_count(hits, refs_kmer_count_vec);
+		counter.clear();
+		for (auto seq : hits)
+			counter.add(seq);
+		counter.count(min_hits);
+		if (counter.counts != refs_kmer_count_vec) ++num_diff;
+	}
+	std::cout << (num_diff == 0 ? "OK" : "ERROR: the reference hit counts differ from std::map") << std::endl;
+	return num_diff == 0;
+} // ~test_5
+
+/*
+ * Smith-Waterman kernels benchmark
+ * Aligns random reads on references they were sampled from (with substitutions and indels)
+ * using the SSE2, AVX2 and AVX-512 kernels supported by the CPU. Long reads (score over 255) use the 16 bit kernels.
+ * The timing uses the default scoring. Then, for gap penalties the options accept (0 <= gap_ext <= gap_open),
+ * checks the alignments of all the kernels are identical, and their scores are those of an exact affine
+ * Smith-Waterman (first 2000 alignments). Fails on any difference.
+ *
+ * test.exe 6 <read length e.g. 150> [number of alignments (20000)]
+ */
+bool test_6(int read_len, int num_aligns)
+{
+	const char* names[] = { "SSE2", "AVX2", "AVX-512" };
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> nt(0, 3);
+	std::uniform_int_distribution<int> pct(0, 99);
+
+	// scoring as by default: match 2, mismatch -3, N -3, gap open 5, gap extension 2
+	std::vector<int8_t> matrix;
+	for (int l = 0; l < 5; ++l)
+		for (int m = 0; m < 5; ++m)
+			matrix.push_back(l < 4 && l == m ? 2 : -3);
+
+	std::vector<std::vector<int8_t>> refs(num_aligns), reads(num_aligns);
+	for (int i = 0; i < num_aligns; ++i)
+	{
+		for (int j = 0; j < read_len + 60; ++j)
+			refs[i].push_back(nt(gen));
+		// every 10th read is random, the others have ~6% substitutions and indels
+		for (int j = 30; (int)reads[i].size() < read_len; ++j)
+		{
+			auto p = pct(gen);
+			if (i % 10 == 0) reads[i].push_back(nt(gen));
+			else if (p < 2) reads[i].push_back(nt(gen)); // substitution
+			else if (p < 4) { reads[i].push_back(nt(gen)); --j; } // insertion
+			else if (p < 6) continue; // deletion
+			else reads[i].push_back(refs[i][j % refs[i].size()]);
+		}
+	}
+
+	for (int simd = SSW_SSE2; simd <= ssw_simd_supported(); ++simd)
+	{
+		ssw_simd_select(simd);
+		// scores and end positions only (flag 0) i.e. the kernels
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < num_aligns; ++i)
+		{
+			s_profile* profile = ssw_init(&reads[i][0], read_len, &matrix[0], 5, 2);
+			s_align* result = ssw_align(profile, &refs[i][0], (int32_t)refs[i].size(), 5, 2, 0, 0, 0, 0);
+			align_destroy(&result);
+			init_destroy(&profile);
+		}
+		std::chrono::duration<double> score_time = std::chrono::high_resolution_clock::now() - start;
+
+		// full alignments with the CIGAR as done by 'compute_lis_alignment'
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < num_aligns; ++i)
+		{
+			s_profile* profile = ssw_init(&reads[i][0], read_len, &matrix[0], 5, 2);
+			s_align* result = ssw_align(profile, &refs[i][0], (int32_t)refs[i].size(), 5, 2, 2, 0, 0, 0);
+			align_destroy(&result);
+			init_destroy(&profile);
+		}
+		std::chrono::duration<double> align_time = std::chrono::high_resolution_clock::now() - start;
+		std::cout << names[simd] << ": score only " << score_time.count() << " sec  full alignment " << align_time.count() << " sec" << std::endl;
+	}
+
+	// exact affine local alignment score. A gap of length L costs gap_open + (L - 1) * gap_ext as in ssw_align
+	auto exact_score = [&matrix](const std::vector<int8_t>& read, const std::vector<int8_t>& ref, int gap_open, int gap_ext) {
+		const int NEG = -1000000;
+		std::size_t n = read.size();
+		std::vector<int> h(n + 1, 0), f(n + 1, NEG); // previous column, gap along the reference
+		int best = 0;
+		for (auto nt_ref : ref)
+		{
+			int diag = 0, up = 0, e = NEG; // H[i-1][j-1], H[i-1][j], gap along the read
+			for (std::size_t i = 1; i <= n; ++i)
+			{
+				f[i] = std::max(h[i] - gap_open, f[i] - gap_ext);
+				e = std::max(up - gap_open, e - gap_ext);
+				int cur = std::max({ 0, diag + matrix[read[i - 1] * 5 + nt_ref], e, f[i] });
+				diag = h[i];
+				h[i] = up = cur;
+				best = std::max(best, cur);
+			}
+		}
+		return best;
+	};
+
+	int num_checked = std::min(num_aligns, 2000);
+	int num_diff = 0;
+	for (auto gaps : { std::make_pair(5, 2), std::make_pair(2, 2), std::make_pair(3, 1), std::make_pair(1, 1), std::make_pair(8, 0), std::make_pair(0, 0) })
+	{
+		std::vector<std::vector<int32_t>> results[3];
+		for (int simd = SSW_SSE2; simd <= ssw_simd_supported(); ++simd)
+		{
+			ssw_simd_select(simd);
+			for (int i = 0; i < num_aligns; ++i)
+			{
+				s_profile* profile = ssw_init(&reads[i][0], read_len, &matrix[0], 5, 2);
+				s_align* result = ssw_align(profile, &refs[i][0], (int32_t)refs[i].size(), gaps.first, gaps.second, 2, 0, 0, 0);
+				std::vector<int32_t> res = { result->score1, result->ref_begin1, result->ref_end1, result->read_begin1, result->read_end1 };
+				res.insert(res.end(), result->cigar, result->cigar + result->cigarLen);
+				results[simd].push_back(res);
+				align_destroy(&result);
+				init_destroy(&profile);
+			}
+			int num_diff_simd = 0;
+			for (int i = 0; i < num_aligns; ++i)
+				if (results[simd][i] != results[SSW_SSE2][i]) ++num_diff_simd;
+			if (num_diff_simd > 0)
+				std::cout << "ERROR: gap open " << gaps.first << " gap extension " << gaps.second << ": " << num_diff_simd
+					<< " alignments of " << names[simd] << " differ from SSE2" << std::endl;
+			num_diff += num_diff_simd;
+		}
+		int num_diff_dp = 0;
+		for (int i = 0; i < num_checked; ++i)
+			if (results[SSW_SSE2][i][0] != exact_score(reads[i], refs[i], gaps.first, gaps.second)) ++num_diff_dp;
+		if (num_diff_dp > 0)
+			std::cout << "ERROR: gap open " << gaps.first << " gap extension " << gaps.second << ": " << num_diff_dp
+				<< " of " << num_checked << " scores differ from the exact Smith-Waterman" << std::endl;
+		num_diff += num_diff_dp;
+	}
+	ssw_simd_select(-1);
+	std::cout << (num_diff == 0 ? "OK" : "ERROR") << std::endl;
+	return num_diff == 0;
+} // ~test_6
+
+/*
+ * Inter-sequence batch scoring (one reference per lane) vs one score only alignment per reference.
+ * A read against 'num_refs' candidate slices of the read length + edges, as in 'compute_lis_alignment'.
+ * Half of the candidates are similar to the read, the others are random.
+ * Fails if any batch score differs from the score of 'ssw_align'.
+ *
+ * test.exe 7 <read length e.g. 150> [number of references (20000)]
+ */
+bool test_7(int read_len, int num_refs)
+{
+	int num_diff = 0;
+	const char* names[] = { "SSE2", "AVX2", "AVX-512" };
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> nt(0, 3);
+	std::uniform_int_distribution<int> pct(0, 99);
+
+	std::vector<int8_t> matrix;
+	for (int l = 0; l < 5; ++l)
+		for (int m = 0; m < 5; ++m)
+			matrix.push_back(l < 4 && l == m ? 2 : -3);
+
+	std::vector<int8_t> read;
+	for (int j = 0; j < read_len; ++j)
+		read.push_back(nt(gen));
+
+	std::vector<std::vector<int8_t>> refs(num_refs);
+	std::vector<const int8_t*> ref_ptrs;
+	std::vector<int32_t> ref_lens;
+	for (int i = 0; i < num_refs; ++i)
+	{
+		for (int j = 0; j < read_len + 8; ++j)
+		{
+			auto p = pct(gen);
+			if (i % 2 || j < 4 || j >= read_len + 4 || p < 5) refs[i].push_back(nt(gen));
+			else refs[i].push_back(read[j - 4]);
+		}
+		ref_ptrs.push_back(&refs[i][0]);
+		ref_lens.push_back((int32_t)refs[i].size());
+	}
+
+	for (int simd = SSW_SSE2; simd <= ssw_simd_supported(); ++simd)
+	{
+		ssw_simd_select(simd);
+		s_profile* profile = ssw_init(&read[0], read_len, &matrix[0], 5, 2);
+
+		std::vector<uint16_t> scores(num_refs);
+		auto start = std::chrono::high_resolution_clock::now();
+		ssw_score_batch(profile, &ref_ptrs[0], &ref_lens[0], num_refs, 5, 2, &scores[0]);
+		std::chrono::duration<double> batch_time = std::chrono::high_resolution_clock::now() - start;
+
+		std::vector<uint16_t> single_scores(num_refs);
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < num_refs; ++i)
+		{
+			s_align* result = ssw_align(profile, ref_ptrs[i], ref_lens[i], 5, 2, 0, 0, 0, 0);
+			single_scores[i] = result->score1;
+			align_destroy(&result);
+		}
+		std::chrono::duration<double> single_time = std::chrono::high_resolution_clock::now() - start;
+		init_destroy(&profile);
+
+		std::cout << names[simd] << ": batch " << batch_time.count() << " sec  one by one " << single_time.count() << " sec" << std::endl;
+		int num_diff_simd = 0;
+		for (int i = 0; i < num_refs; ++i)
+			if (scores[i] != single_scores[i]) ++num_diff_simd;
+		if (num_diff_simd > 0)
+			std::cout << "ERROR: " << num_diff_simd << " of " << num_refs << " " << names[simd] << " batch scores differ from ssw_align" << std::endl;
+		num_diff += num_diff_simd;
+	}
+	ssw_simd_select(-1);
+	std::cout << (num_diff == 0 ? "OK" : "ERROR") << std::endl;
+	return num_diff == 0;
+} // ~test_7
+
+/*
+ * The queue 'ReadsQueue' before the idle threads were parked: the same batch ring, but a thread finding
+ * the queue full or empty yields and retries until it can proceed. Kept here for 'test_8'
+ */
+class SpinningReadsQueue
+{
+public:
+	SpinningReadsQueue(std::size_t capacity = 16, unsigned pushers = 1)
+		: mask(0), push_pos(0), pop_pos(0), num_pushers(pushers)
+	{
+		std::size_t size = 2;
+		for (; size < capacity; size <<= 1);
+		mask = size - 1;
+		cells.reset(new Cell[size]);
+		for (std::size_t i = 0; i < size; ++i)
+			cells[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	void push(Readbatch& batch)
+	{
+		Cell* cell;
+		auto pos = push_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			cell = &cells[pos & mask];
+			auto seq = cell->seq.load(std::memory_order_acquire);
+			auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+			if (dif == 0) {
+				if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else {
+				if (dif < 0) std::this_thread::yield(); // full - let the processors run
+				pos = push_pos.load(std::memory_order_relaxed);
+			}
+		}
+		std::swap(cell->batch, batch);
+		cell->seq.store(pos + 1, std::memory_order_release);
+	}
+
+	bool pop(Readbatch& batch)
+	{
+		Cell* cell;
+		auto pos = pop_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			// load before looking at the cell: no pushers means all the pushes are visible
+			auto is_last = num_pushers.load(std::memory_order_acquire) == 0;
+			cell = &cells[pos & mask];
+			auto seq = cell->seq.load(std::memory_order_acquire);
+			auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+			if (dif == 0) {
+				if (pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else {
+				if (dif < 0) {
+					if (is_last) return false; // empty and no more pushes
+					std::this_thread::yield(); // empty - let the readers run
+				}
+				pos = pop_pos.load(std::memory_order_relaxed);
+			}
+		}
+		std::swap(cell->batch, batch);
+		cell->seq.store(pos + mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	void done_push() {
+		num_pushers.fetch_sub(1, std::memory_order_release);
+	}
+
+private:
+	struct Cell {
+		std::atomic<std::size_t> seq;
+		Readbatch batch;
+	};
+
+	std::size_t mask; // capacity - 1
+	std::unique_ptr<Cell[]> cells;
+	alignas(64) std::atomic<std::size_t> push_pos;
+	alignas(64) std::atomic<std::size_t> pop_pos;
+	alignas(64) std::atomic<unsigned> num_pushers;
+};
+
+/*
+ * Queue throughput: a reader pushes 'num_reads' synthetic 150 nt FASTQ records in batches of Readfeed::BATCH_SIZE,
+ * 'num_poppers' processors pop them. ReadsQueue, which parks the idle threads, vs the former ring whose idle
+ * threads spin (yield) with the same capacity. Prints the producer and consumer rates, and the CPU time of 
+ * the process i.e. the time the waiting threads spend spinning.
+ * Fails if a queue does not deliver every read exactly once.
+ *
+ * test.exe 8 <number of reads e.g. 2000000> [number of popping threads (2)]
+ */
+bool test_8(std::size_t num_reads, int num_poppers)
+{
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> nt(0, 3);
+	std::vector<std::string> recs(1000);
+	for (std::size_t i = 0; i < recs.size(); ++i) {
+		std::string seq;
+		for (int j = 0; j < 150; ++j) seq.push_back("ACGT"[nt(gen)]);
+		recs[i] = "@read_" + std::to_string(i) + "\n" + seq + "\n" + std::string(150, 'I');
+	}
+
+	bool is_ok = true;
+	auto run = [&](const char* name, auto& queue) {
+		std::vector<std::vector<std::size_t>> popped(num_poppers); // numbers of the reads popped by each thread
+		double t_push = 0, t_pop = 0;
+		auto cpu = std::clock();
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> tpool;
+		tpool.emplace_back([&] {
+			Readbatch batch;
+			std::size_t num_recs = 0;
+			for (std::size_t i = 0; i < num_reads; ++i) {
+				if (num_recs == batch.size()) batch.emplace_back();
+				batch[num_recs].read_num = i;
+				batch[num_recs++].buf.assign(recs[i % recs.size()]);
+				if (num_recs == Readfeed::BATCH_SIZE) {
+					queue.push(batch);
+					num_recs = 0;
+				}
+			}
+			if (num_recs > 0) {
+				batch.resize(num_recs);
+				queue.push(batch);
+			}
+			queue.done_push();
+			t_push = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		});
+		for (int i = 0; i < num_poppers; ++i) {
+			tpool.emplace_back([&, i] {
+				Readbatch batch;
+				popped[i].reserve(num_reads);
+				for (; queue.pop(batch);)
+					for (auto& rec : batch) popped[i].push_back(rec.read_num);
+			});
+		}
+		for (auto& thr : tpool) thr.join();
+		t_pop = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		double t_cpu = double(std::clock() - cpu) / CLOCKS_PER_SEC;
+		std::cout << std::setprecision(3) << std::fixed << name
+			<< ": push " << num_reads / t_push / 1e6 << " M reads/sec  pop " << num_reads / t_pop / 1e6
+			<< " M reads/sec  CPU " << t_cpu << " sec" << std::endl;
+
+		// every read exactly once
+		std::vector<uint8_t> counts(num_reads, 0);
+		std::size_t num_bad = 0;
+		for (auto& nums : popped)
+			for (auto num : nums)
+				if (num >= num_reads || ++counts[num] > 1) ++num_bad;
+		num_bad += std::count(counts.begin(), counts.end(), 0);
+		if (num_bad > 0) {
+			std::cout << "ERROR: " << name << ": " << num_bad << " reads lost, duplicated or unknown" << std::endl;
+			is_ok = false;
+		}
+	};
+
+	{
+		SpinningReadsQueue queue(Readfeed::QUEUE_SIZE);
+		run("spinning queue", queue);
+	}
+	{
+		ReadsQueue queue("test_8", Readfeed::QUEUE_SIZE);
+		run("parked queue  ", queue);
+	}
+	std::cout << (is_ok ? "OK" : "ERROR") << std::endl;
+	return is_ok;
+} // ~test_8
+
+/*
+ * Results store throughput: RocksDB vs memory mapped store (OPT_KVDB_STORE)
+ * 'num_threads' threads put the results of 'num_reads' reads (each thread its own reads file, like the split reads),
+ * then read them back in blocks of KeyValueDatabase::MULTI_GET_SIZE. The result sizes vary around 'Read::toBinString' sizes.
+ * After the timing, fails if any value read back differs from the one put, or a key never put has a value.
+ *
+ * test.exe 9 <number of reads e.g. 1000000> [number of threads (4)]
+ */
+bool test_9(std::size_t num_reads, int num_threads)
+{
+	bool is_ok = true;
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> len(80, 400);
+	std::vector<std::string> vals(1000);
+	for (std::size_t i = 0; i < vals.size(); ++i) {
+		vals[i].resize(len(gen));
+		for (auto& ch : vals[i]) ch = static_cast<char>(gen());
+	}
+	std::size_t num_per_thread = num_reads / num_threads;
+
+	for (auto type : { KVDB_TYPE::ROCKSDB, KVDB_TYPE::MMAP }) {
+		auto dbdir = std::filesystem::temp_directory_path() / ("smr_test_9_" + std::to_string(static_cast<int>(type)));
+		std::filesystem::remove_all(dbdir);
+		std::filesystem::create_directories(dbdir);
+		double t_put = 0, t_get = 0;
+		std::atomic<std::size_t> num_bad(0);
+		// the values of the thread 't' keys 'i' to 'i + MULTI_GET_SIZE' (or less)
+		auto get_block = [](KeyValueDatabase& kvdb, int t, std::size_t i, std::size_t num_keys,
+			std::vector<std::string>& keys, std::vector<std::string>& bstrs, const char* pfx = "") {
+			keys.clear();
+			for (std::size_t j = i; j < num_keys && keys.size() < KeyValueDatabase::MULTI_GET_SIZE; ++j)
+				keys.push_back(pfx + std::to_string(t) + "_" + std::to_string(j));
+			kvdb.multi_get(keys, bstrs);
+		};
+		{
+			KeyValueDatabase kvdb(dbdir.string(), type);
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<std::thread> tpool;
+			for (int t = 0; t < num_threads; ++t) {
+				tpool.emplace_back([&, t] {
+					KvdbBatch kvbatch(kvdb);
+					for (std::size_t i = 0; i < num_per_thread; ++i)
+						kvbatch.put(std::to_string(t) + "_" + std::to_string(i), vals[i % vals.size()]);
+				});
+			}
+			for (auto& thr : tpool) thr.join();
+			t_put = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			start = std::chrono::high_resolution_clock::now();
+			tpool.clear();
+			for (int t = 0; t < num_threads; ++t) {
+				tpool.emplace_back([&, t] {
+					std::vector<std::string> keys, bstrs;
+					for (std::size_t i = 0; i < num_per_thread; i += keys.size())
+						get_block(kvdb, t, i, num_per_thread, keys, bstrs);
+				});
+			}
+			for (auto& thr : tpool) thr.join();
+			t_get = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// the values read back, and no value for the keys never put
+			tpool.clear();
+			for (int t = 0; t < num_threads; ++t) {
+				tpool.emplace_back([&, t] {
+					std::vector<std::string> keys, bstrs;
+					for (std::size_t i = 0; i < num_per_thread; i += keys.size()) {
+						get_block(kvdb, t, i, num_per_thread, keys, bstrs);
+						for (std::size_t j = 0; j < keys.size(); ++j)
+							if (bstrs.size() != keys.size() || bstrs[j] != vals[(i + j) % vals.size()]) num_bad.fetch_add(1);
+						get_block(kvdb, t, i, num_per_thread, keys, bstrs, "none_");
+						for (auto& bstr : bstrs)
+							if (!bstr.empty()) num_bad.fetch_add(1);
+					}
+				});
+			}
+			for (auto& thr : tpool) thr.join();
+		}
+		std::size_t num_all = num_per_thread * num_threads;
+		auto name = type == KVDB_TYPE::ROCKSDB ? "rocksdb" : "mmap   ";
+		std::cout << std::setprecision(3) << std::fixed << name
+			<< ": put " << num_all / t_put / 1e6 << " M reads/sec  get " << num_all / t_get / 1e6 << " M reads/sec" << std::endl;
+		if (num_bad > 0) {
+			std::cout << "ERROR: " << name << ": " << num_bad << " wrong results" << std::endl;
+			is_ok = false;
+		}
+		std::filesystem::remove_all(dbdir);
+	}
+	std::cout << (is_ok ? "OK" : "ERROR") << std::endl;
+	return is_ok;
+} // ~test_9
+
+/*
+ * Report commits with multiple threads and reports
+ * The threads append the reads of their splits to the fastx, other and denovo reports, every 2nd read as aligned
+ * and every 3rd as de novo, so with enough reads (~100K of 150 nt per thread) each report gets more than 
+ * 'Output::COMMIT_SIZE' from each thread. Runs twice, delaying the even threads in the first run and the odd threads
+ * in the second, and checks the runs end i.e. no thread waits for a turn that never comes, write the same report
+ * files, and each report file is larger than a commit per thread.
+ * Removes the aligned and other reports of the previous runs from the output directory.
+ *
+ * test.exe 10 -ref silva-bac-16s-id90.fasta -reads SRR1635864_1.fastq -workdir ... -fastx -other -denovo -threads 4
+ */
+bool test_10(int argc, char** argv)
+{
+	Runopts opts(argc, argv);
+	KeyValueDatabase kvdb(opts.kvdbdir.string());
+	Readfeed readfeed(FEED_TYPE::SPLIT_READS, opts.readfiles, opts.num_proc_thread, opts.readb_dir, opts.is_paired);
+	Readstats readstats(readfeed.num_reads_tot, readfeed.length_all, readfeed.min_read_len, readfeed.max_read_len, kvdb, opts);
+	Refstats refstats(opts, readstats);
+	References refs;
+	uint32_t num_threads = readfeed.num_splits;
+
+	// the report files of a run, by name
+	auto list_reports = [&opts]() {
+		std::vector<std::filesystem::path> files;
+		for (auto& pfx : { opts.aligned_pfx, opts.other_pfx }) {
+			for (auto& entry : std::filesystem::directory_iterator(pfx.parent_path())) {
+				auto fname = entry.path().filename().string();
+				if (entry.is_regular_file() && fname.find(pfx.filename().string()) == 0 
+					&& std::find(files.begin(), files.end(), entry.path()) == files.end())
+					files.push_back(entry.path());
+			}
+		}
+		std::sort(files.begin(), files.end());
+		return files;
+	};
+	auto read_file = [](const std::filesystem::path& path) {
+		std::ifstream ifs(path, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	};
+
+	std::vector<std::vector<std::string>> runs;
+	for (uint32_t run = 0; run < 2; ++run) {
+		for (auto& path : list_reports())
+			std::filesystem::remove(path);
+		readfeed.init_reading();
+		{
+			Output output(readfeed, opts, readstats);
+			output.begin(num_threads, opts, true);
+			std::vector<std::thread> tpool;
+			for (uint32_t id = 0; id < num_threads; ++id) {
+				tpool.emplace_back([&, id] {
+					Readrec rec;
+					std::vector<Read> block, reads;
+					int idx = id * readfeed.num_sense;
+					for (; readfeed.next(idx, rec, block, KeyValueDatabase::MULTI_GET_SIZE);) {
+						if (id % 2 == run) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+						for (std::size_t ib = 0; ib + readfeed.num_sense <= block.size(); ib += readfeed.num_sense) {
+							reads.clear();
+							for (uint32_t i = 0; i < readfeed.num_sense; ++i) {
+								reads.push_back(std::move(block[ib + i]));
+								reads.back().is_hit = reads.back().read_num % 2 == 0;
+								reads.back().n_denovo = reads.back().read_num % 3 == 0 ? 1 : 0;
+							}
+							output.append(id, reads, refs, refstats, opts, true);
+						}
+					}
+					output.end(id);
+				});
+			}
+			for (auto& thr : tpool) thr.join();
+			output.finish(readfeed, opts);
+		}
+		runs.emplace_back();
+		for (auto& path : list_reports()) {
+			runs.back().push_back(read_file(path));
+			std::cout << "run " << run << ": " << path.filename().string() << " " << runs.back().back().size() << " bytes" << std::endl;
+		}
+		readfeed.rewind_in();
+		readfeed.init_vzlib_in();
+	}
+
+	bool is_ok = runs[0].size() == 3 && runs[0] == runs[1];
+	for (auto& report : runs[0])
+		is_ok = is_ok && report.size() > num_threads * Output::COMMIT_SIZE;
+	std::cout << (is_ok ? "OK" : "ERROR: the runs differ, or the reports are too small for the commits to interleave") << std::endl;
+	return is_ok;
+} // ~test_10
+
 int main(int argc, char** argv)
 {
+	int ret = EXIT_SUCCESS;
 	std::cout << STAMP << "Running with " << argc << " options" << std::endl;
 	//Runopts opts(argc, argv, false);
 	if (argc > 2)
@@ -268,6 +1005,27 @@ int main(int argc, char** argv)
 		case 3:
 			test_3(argc, argv);
 			break;
+		case 4:
+			if (!test_4(argc, argv)) ret = EXIT_FAILURE;
+			break;
+		case 5:
+			if (!test_5(std::stoi(argv[2]), argc > 3 ? std::stoi(argv[3]) : 2000, argc > 4 ? std::stoi(argv[4]) : 1000)) ret = EXIT_FAILURE;
+			break;
+		case 6:
+			if (!test_6(std::stoi(argv[2]), argc > 3 ? std::stoi(argv[3]) : 20000)) ret = EXIT_FAILURE;
+			break;
+		case 7:
+			if (!test_7(std::stoi(argv[2]), argc > 3 ? std::stoi(argv[3]) : 20000)) ret = EXIT_FAILURE;
+			break;
+		case 8:
+			if (!test_8(std::stoul(argv[2]), argc > 3 ? std::stoi(argv[3]) : 2)) ret = EXIT_FAILURE;
+			break;
+		case 9:
+			if (!test_9(std::stoul(argv[2]), argc > 3 ? std::stoi(argv[3]) : 4)) ret = EXIT_FAILURE;
+			break;
+		case 10:
+			if (!test_10(argc, argv)) ret = EXIT_FAILURE;
+			break;
 		default:
 			std::cout << "Unknown arg: " << scase << std::endl;
 		}
@@ -277,5 +1035,5 @@ int main(int argc, char** argv)
 		std::cerr << "Expecting at least one argument: test case e.g. 0 | 1 | 2 etc." << std::endl;
 	}
 
-	return 0;
+	return ret;
 } // ~main
\ No newline at end of file